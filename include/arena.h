@@ -0,0 +1,116 @@
+/**
+ * 	Bump-pointer (arena) allocation for the AST, scopes, symbols, quads and
+ * 	target code. Nothing allocated from an arena is freed individually;
+ * 	instead, a whole arena is released (rewound) at once.
+ *
+ * 	There are two kinds of arenas: the file arena (one per translation
+ * 	unit, in its context, see context.h) holds everything that lives for
+ * 	the entire translation unit (file-scope declarations and types, the
+ * 	global scope, and the static/extern symbols and string literals that
+ * 	are emitted at the end of the file), and a function arena holds
+ * 	everything that belongs to a single function definition (its body,
+ * 	local scopes and symbols, quads, and asm). A function arena is released
+ * 	once the target code of its function has been output, and is then
+ * 	reused for a later function, so peak memory is bounded by the largest
+ * 	functions (one per function whose code is being generated at the same
+ * 	time, see backend.h) rather than by the size of the translation unit.
+ *
+ * 	cur_arena points to the arena that allocations should currently come
+ * 	from; it is per-thread, and is switched at the start and end of each
+ * 	function body (see fn_arena_begin() and fn_arena_end()). Anything that
+ * 	must outlive the current function has to be allocated from (or copied
+ * 	into) the file arena explicitly, which is only allocated from by the
+ * 	thread that parses the file.
+ */
+
+#ifndef ARENAH
+#define ARENAH
+
+#include <stddef.h>
+
+// a contiguous block of arena memory; chunks are kept in a linked list and
+// are reused (not freed) when the arena is reset
+struct arena_chunk {
+	struct arena_chunk *next;
+	char *end;
+	char mem[];
+};
+
+struct arena {
+	// chunk currently being allocated from, and its bump pointer
+	struct arena_chunk *chunk;
+	char *ptr;
+
+	// all chunks owned by this arena, in allocation order
+	struct arena_chunk *chunks;
+
+	// bytes currently in use, and the maximum ever in use (for statistics)
+	size_t used, peak;
+
+	// next unused function arena
+	struct arena *next;
+};
+
+extern _Thread_local struct arena *cur_arena;
+
+// largest amount of memory used by a function arena (for statistics)
+extern size_t fn_arena_peak;
+
+/**
+ * allocate zeroed memory from an arena; memory is aligned to 16 bytes
+ *
+ * @param arena		arena to allocate from
+ * @param size		number of bytes
+ * @return		pointer to zeroed memory
+ */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/**
+ * duplicate a string into an arena
+ *
+ * @param arena		arena to allocate from
+ * @param str		null-terminated string to copy
+ * @return		copy of str
+ */
+char *arena_strdup(struct arena *arena, const char *str);
+
+/**
+ * release all allocations in an arena at once; the memory is kept for reuse
+ *
+ * @param arena		arena to reset
+ */
+void arena_reset(struct arena *arena);
+
+/**
+ * free all of the memory of an arena
+ *
+ * @param arena		arena to free
+ */
+void arena_free(struct arena *arena);
+
+/**
+ * switch allocations to a new (or reused) function arena at the start of a
+ * function body
+ *
+ * @return		the function arena
+ */
+struct arena *fn_arena_begin(void);
+
+/**
+ * switch allocations back to the file arena (of the current context) at the
+ * end of a function body; the function arena stays valid until it is released
+ */
+void fn_arena_end(void);
+
+/**
+ * reset a function arena once its function's target code has been output,
+ * and keep it for reuse by fn_arena_begin(); may be called from any thread
+ *
+ * @param arena		function arena
+ */
+void fn_arena_release(struct arena *arena);
+
+// allocate a zeroed object of the given type from the current arena
+#define ARENA_NEW(type)	((type *) arena_alloc(cur_arena, sizeof(type)))
+
+#endif	// ARENAH
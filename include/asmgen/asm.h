@@ -38,6 +38,12 @@ enum asm_opcode {
 	AOC_SETG,
 	AOC_SETGE,
 	AOC_CLTQ,
+	AOC_CLTD,
+	AOC_CQTO,
+	AOC_MOVS,	// sign-extending mov; suffixes taken from operand sizes
+	AOC_MOVZ,	// zero-extending mov; suffixes taken from operand sizes
+	AOC_INC,
+	AOC_DEC,
 };
 
 // x86_64 instruction sizes
@@ -69,7 +75,7 @@ enum asm_addr_mode {
 	AAM_IMMEDIATE,	// $3
 	AAM_MEMORY,	// a
 	AAM_INDIRECT,	// (%rbp)
-	AAM_REG_OFF,	// -4(%rbp)
+	AAM_REG_OFF,	// -4(%rbp), 8(%rax,%rcx,4), a+4(%rip)
 	AAM_LABEL,	// call, jmp
 };
 
@@ -115,6 +121,9 @@ struct asm_dir {
 	enum asm_pseudo_opcode poc;
 	char *param1, *param2, *param3;
 
+	// contents of a .string directive (for object output, see elfobj.h)
+	struct string *string;
+
 	// basically a kludge -- need a second iterator pointer for
 	// string constants in .rodata
 	union asm_component *rodata_next;
@@ -125,6 +134,10 @@ struct asm_label {
 	_ASM_COMPONENT
 
 	char *name;
+
+	// position of the label in object output (see elfobj.h)
+	int section;
+	unsigned offset;
 };
 
 // x86 register or sub-register
@@ -133,6 +146,15 @@ struct asm_reg {
 	enum asm_size size;
 };
 
+// general x86 memory operand: disp(base,index,scale), or sym+disp(%rip)
+// if sym is set (in which case there is no base or index register)
+struct asm_mem {
+	struct addr *sym;
+	enum asm_reg_name base, index;
+	int has_base, has_index;
+	int scale, disp;
+};
+
 // x86 asm instruction src/dest operand
 struct asm_addr {
 	enum asm_addr_mode mode;
@@ -141,6 +163,7 @@ struct asm_addr {
 		struct addr *addr;
 		struct asm_reg reg;
 		char *label;
+		struct asm_mem mem;
 	} value;
 };
 
@@ -160,11 +183,11 @@ union asm_component {
 	(var)->generic.comment = cmt;
 
 #define ALLOC_AC(var, typ) \
-	(var) = calloc(1, sizeof(union asm_component)); \
+	(var) = ARENA_NEW(union asm_component); \
 	(var)->generic.type = typ;
 
 // linked list of instructions
-extern union asm_component *asm_out;
+extern _Thread_local union asm_component *asm_out;
 
 // declare variables
 void declare_symbol(union astnode *decl);
@@ -172,18 +195,40 @@ void declare_symbol(union astnode *decl);
 // dump string constant
 void dump_string(union astnode *string);
 
-// select x86-64 asm inst given quad
-struct asm_inst *select_asm_inst(struct quad *quad);
+// generate asm components, add to ll; label names are not copied
+union asm_component *asm_inst_new(enum asm_opcode oc, struct asm_addr *src,
+	struct asm_addr *dest, enum asm_size size);
+union asm_component *asm_dir_new(enum asm_pseudo_opcode poc);
+union asm_component *asm_label_new(char *name);
+
+// construct asm operands
+struct asm_addr *reg2addr(enum asm_reg_name name, enum asm_size size);
+struct asm_addr *addr2asmaddr(struct addr *addr);
+
+// x86_64 param register order
+extern enum asm_reg_name param_reg[];
+
+// generate the assembly for a function from its basic_block list; returns the
+// function's asm components (in program order, see print_asm())
+union asm_component *generate_asm(union astnode *fndecl,
+	struct basic_block *bb_ll);
+
+// print out assembly (into the output buffer), or add it to the object file
+// when emitting an object file (-c)
+void print_asm(union asm_component *code);
 
-// select registers
+// size of the output buffer of each context (see context.h)
+#define OUT_BUF_SIZE	(1 << 20)
 
-// calling functions
+// append raw bytes to the output buffer
+void out_write(const void *buf, size_t len);
 
-// begin generating assembly from a basic_block list
-void generate_asm(union astnode *fndecl, struct basic_block *bb_ll);
+// write out the output buffer to the output file of the current context; must
+// be called at the end of the output
+void asm_flush(void);
 
-// print out assembly output
-void print_asm();
+// symbol name of a global variable or string literal
+char *asm_sym_name(union astnode *decl);
 
 //print CC
 void print_CC(struct basic_block *bb);
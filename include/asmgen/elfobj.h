@@ -0,0 +1,125 @@
+/**
+ * ELF64 relocatable object output (-c)
+ *
+ * Rather than printing assembly, the asm components of each function (and of
+ * the global variables and string literals at the end of the file) are
+ * encoded (see encode.h) and collected into the sections of an x86_64 ELF
+ * relocatable object file, which is written out at the end of the file:
+ * .text, .data, .bss, .rodata, and .rodata.str1.1 (mergeable strings).
+ *
+ * Branches within a function are resolved directly, using 8-bit displacements
+ * wherever they fit (relaxation, as the assembler does). Calls become
+ * R_X86_64_PLT32 relocations and RIP-relative references to global variables
+ * and string literals R_X86_64_PC32 relocations. Functions and .globl
+ * variables are global symbols, .comm variables are common symbols (or .bss
+ * symbols, with .local), and string literal labels are local symbols.
+ * Referenced symbols that are never defined are undefined global symbols, so
+ * objects link with gcc-compiled ones.
+ *
+ * The object is built in memory (struct obj_file, in the current context); it
+ * is either written out as a file or loaded for execution (see jit.h).
+ */
+
+#ifndef ELFOBJH
+#define ELFOBJH
+
+#include <asmgen/asm.h>
+#include <stdint.h>
+
+// sections of the object file, in section header table order
+enum obj_section {
+	OS_NULL,
+	OS_TEXT,
+	OS_DATA,
+	OS_BSS,
+	OS_RODATA,
+	OS_RODATA_STR,
+	OS_NOTE,
+	OS_RELA_TEXT,
+	OS_SYMTAB,
+	OS_STRTAB,
+	OS_SHSTRTAB,
+	OS_COUNT,
+};
+
+// growable byte buffer; section contents live for the whole file, so these
+// are heap-allocated rather than in an arena
+struct obj_buf {
+	unsigned char *data;
+	size_t len, cap;
+};
+
+struct obj_sym {
+	char *name;
+	enum obj_section section;	// OS_NULL if not (yet) defined
+	uint64_t value, size;
+	int global, local, common, func;
+
+	// index in .symtab (assigned when the object file is written)
+	unsigned index;
+};
+
+// relocation in .text (R_X86_64_PC32 or R_X86_64_PLT32)
+struct obj_reloc {
+	uint64_t offset;
+	unsigned sym, type;
+	int64_t addend;
+};
+
+// an object file being built; each translation unit has its own (in its
+// context, see context.h)
+struct obj_file {
+	// section contents (.bss only has a size and alignment)
+	struct obj_buf sections[OS_COUNT];
+	uint64_t bss_size, bss_align;
+
+	// symbols, and a hashtable of their indices + 1 by interned name (open
+	// addressing, linear probing); the capacity of the table is a power of
+	// two, and it is kept at most half full
+	struct obj_sym *syms;
+	unsigned nsyms, syms_cap, *sym_tab, sym_tab_cap;
+
+	// relocations of .text
+	struct obj_reloc *relocs;
+	unsigned nrelocs, relocs_cap;
+};
+
+/**
+ * add the code or data of a list of asm components (in program order) to the
+ * object file; branches are matched to labels by pointer, and the names of
+ * symbols (functions, variables and string literals) must be interned
+ *
+ * @param code		linked list of asm components
+ */
+void obj_emit(union asm_component *code);
+
+/**
+ * look up a symbol of the object
+ *
+ * @param name		interned symbol name
+ * @return		symbol, or NULL if it was never defined or referenced
+ */
+struct obj_sym *obj_sym_lookup(char *name);
+
+/**
+ * allocate .comm variables in .bss
+ *
+ * @param all		if zero, only the .local ones (global ones are left
+ * 			as common symbols, for the linker to allocate)
+ */
+void obj_alloc_commons(int all);
+
+/**
+ * write the object file to the output buffer (see asm_flush()); must be
+ * called after the last call to obj_emit()
+ */
+void obj_write(void);
+
+/**
+ * free the memory of an object file
+ *
+ * @param obj		object file
+ */
+void obj_free(struct obj_file *obj);
+
+#endif	// ELFOBJH
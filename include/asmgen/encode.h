@@ -0,0 +1,69 @@
+/**
+ * x86_64 machine code encoder for asm_inst
+ *
+ * Encodes the instructions generated by the back end (the enum asm_opcode set,
+ * with the operand forms that the instruction selector produces) the way the
+ * GNU assembler does, i.e., choosing the shortest form of each instruction:
+ * sign-extended 8-bit immediates and displacements, the accumulator forms of
+ * the ALU instructions, and 8-bit branch displacements where they fit.
+ *
+ * Operands that refer to something outside of the instruction (branch
+ * targets, called functions, and RIP-relative symbols) are left as zeros and
+ * described by a fixup, which is resolved by the caller (see elfobj.h).
+ */
+
+#ifndef ENCODEH
+#define ENCODEH
+
+#include <asmgen/asm.h>
+#include <stdint.h>
+
+// longest x86_64 instruction
+#define ASM_INST_MAX_LEN	15
+
+// what an instruction refers to that is not known when it is encoded
+enum asm_fixup_kind {
+	AFK_NONE,
+	AFK_BRANCH,	// jmp/jcc to a label in the same function (rel8/rel32)
+	AFK_PLT32,	// call to a (possibly external) function
+	AFK_PC32,	// RIP-relative reference to a symbol
+};
+
+struct asm_fixup {
+	enum asm_fixup_kind kind;
+
+	// referenced label or symbol name
+	char *label;
+
+	// offset and size (1 or 4 bytes) of the field in the instruction
+	unsigned offset, size;
+
+	// value to add to the symbol's address, relative to the field (i.e.,
+	// ELF relocation addend)
+	int64_t addend;
+};
+
+/**
+ * encode an instruction
+ *
+ * @param inst		instruction
+ * @param short_branch	whether a branch should use the 8-bit displacement
+ * 			form (ignored for other instructions)
+ * @param buf		buffer of at least ASM_INST_MAX_LEN bytes for the
+ * 			encoding
+ * @param fixup		set to the instruction's fixup (kind AFK_NONE if
+ * 			there is none)
+ * @return		length of the encoding in bytes
+ */
+unsigned asm_inst_encode(struct asm_inst *inst, int short_branch,
+	unsigned char *buf, struct asm_fixup *fixup);
+
+/**
+ * length of the encoding of an instruction, assuming branches are short
+ *
+ * @param inst		instruction
+ * @return		length in bytes
+ */
+unsigned asm_inst_length(struct asm_inst *inst);
+
+#endif	// ENCODEH
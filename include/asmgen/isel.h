@@ -0,0 +1,36 @@
+/**
+ * Instruction selection: covering quads with x86_64 instruction patterns
+ *
+ * Rather than translating each quad one-to-one, a temporary that is defined
+ * and used exactly once within a basic block is "folded" into its use, so that
+ * e.g. the LEA/CAST/MUL/ADD/LOAD sequence generated for an array access
+ * becomes a single disp(base,index,scale) memory operand, and a LOAD feeding an
+ * arithmetic quad becomes a memory operand of the ALU instruction. Where
+ * several tilings of the same expression tree are possible (e.g., lea vs.
+ * mov+add, scaled index vs. imul), the cheapest is chosen using a simple
+ * instruction-count cost model.
+ */
+
+#ifndef ISELH
+#define ISELH
+
+#include <quads/quads.h>
+
+/**
+ * determine which temporaries can be folded into their uses; must be called
+ * on the function's basic blocks before memory offsets are assigned to
+ * temporaries and before select_asm_inst() is called
+ *
+ * @param bb_ll		linearized list of basic blocks for a function
+ */
+void isel_analyze(struct basic_block *bb_ll);
+
+/**
+ * select x86_64 instructions for a quad and emit them to asm_out; emits
+ * nothing for quads whose result is folded into a later quad
+ *
+ * @param quad		quad to generate instructions for
+ */
+void select_asm_inst(struct quad *quad);
+
+#endif	// ISELH
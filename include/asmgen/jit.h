@@ -0,0 +1,78 @@
+/**
+ * In-process JIT (-r)
+ *
+ * Instead of being written to an object file, the machine code and data
+ * collected by obj_emit() (see elfobj.h) are copied into memory mapped with
+ * mmap(), relocated there, and made executable with mprotect(), so that the
+ * compiled functions can be called directly by the compiler process (or by a
+ * program that embeds the compiler).
+ *
+ * Symbols that are not defined by the compiled code (e.g., printf) are
+ * resolved with dlsym() in the running process. Calls to them go through
+ * small jump stubs placed after the code, since shared libraries may be mapped
+ * further than the +/-2GB that a call instruction can reach. The compiled code
+ * of a translation unit is loaded once, after the whole unit has been
+ * compiled.
+ *
+ * A program that embeds the compiler (i.e., links with everything but
+ * main.c) compiles source text with jit_compile(), which returns a handle to
+ * the loaded code: its symbols are found with jit_lookup(), and it is unloaded
+ * with jit_free(). Each handle has its own memory and translation unit, so a
+ * host may compile any number of snippets, on any number of threads (but a
+ * handle is used by one thread at a time). Errors are returned rather than
+ * fatal (see jit_error()); warnings are printed to the debug file (see
+ * common.h), which defaults to stderr.
+ */
+
+#ifndef JITH
+#define JITH
+
+#include <stddef.h>
+
+// loaded code of a translation unit
+struct jit;
+
+/**
+ * compile a translation unit (preprocessed source text) and load it
+ *
+ * @param src		source text (not necessarily null-terminated)
+ * @param len		length of the source text
+ * @return		handle of the loaded code, or NULL if it couldn't be
+ * 			compiled or loaded (see jit_error())
+ */
+struct jit *jit_compile(const char *src, size_t len);
+
+/**
+ * load the code and data of the current context (which the handle takes
+ * over) into executable memory, and resolve their relocations; must be called
+ * after end_unit() (see compile.h)
+ *
+ * @return		handle of the loaded code, or NULL if it couldn't be
+ * 			loaded (see jit_error())
+ */
+struct jit *jit_load(void);
+
+/**
+ * look up a function or variable of loaded code
+ *
+ * @param jit		handle of the loaded code
+ * @param name		symbol name (static variables use their uid)
+ * @return		address of the symbol, or NULL if it isn't defined
+ */
+void *jit_lookup(struct jit *jit, const char *name);
+
+/**
+ * unload code, and free its translation unit; its functions and variables
+ * must no longer be used
+ *
+ * @param jit		handle of the loaded code
+ */
+void jit_free(struct jit *jit);
+
+/**
+ * returns the message of the last error of jit_compile() or jit_load() on the
+ * current thread
+ */
+const char *jit_error(void);
+
+#endif	// JITH
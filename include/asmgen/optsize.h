@@ -0,0 +1,42 @@
+/**
+ * Code-size optimization (-Os) and instruction size estimation
+ *
+ * When optimizing for size, a few passes are run over the final instruction
+ * stream of a function: shorter equivalent encodings are substituted (xor
+ * zeroing where the flags are dead, inc/dec, 32-bit moves of small constants),
+ * a small stack frame is allocated with push instead of sub, and identical
+ * instruction sequences ending in a return are merged (cross-jumping), so
+ * that functions share a single copy of each distinct epilogue.
+ */
+
+#ifndef OPTSIZEH
+#define OPTSIZEH
+
+#include <asmgen/asm.h>
+
+/**
+ * estimate the encoded size (in bytes) of an x86_64 instruction
+ *
+ * @param inst		instruction
+ * @return		estimated size in bytes
+ */
+int asm_inst_size(struct asm_inst *inst);
+
+/**
+ * estimate the encoded size of a list of asm components (only instructions
+ * take up space)
+ *
+ * @param code		linked list of asm components
+ * @return		estimated size in bytes
+ */
+int asm_code_size(union asm_component *code);
+
+/**
+ * run the code-size optimizations on the code of a function; asm_out must
+ * hold the function's code (in reverse order, as it is being generated)
+ *
+ * @param fnname	name of the function (for generated labels)
+ */
+void optimize_size_asm(char *fnname);
+
+#endif	// OPTSIZEH
@@ -0,0 +1,31 @@
+/**
+ * Instruction scheduling: reordering the selected instructions of a basic block
+ *
+ * A simple list scheduler over the asm_inst stream of each basic block. A
+ * dependence graph is built from register, condition-code (flags), and memory
+ * dependencies, and instructions are issued in order of their longest
+ * latency-weighted path to the end of the block (critical path), so that
+ * independent loads are started early and overlap with arithmetic instead of
+ * stalling the instructions that consume them. Calls, returns and jumps are
+ * scheduling barriers.
+ */
+
+#ifndef SCHEDH
+#define SCHEDH
+
+#include <asmgen/asm.h>
+
+/**
+ * schedule the instructions that have been emitted to asm_out since mark was
+ * the head of asm_out (i.e., the instructions of one basic block, excluding
+ * its terminating jumps)
+ *
+ * @param mark		head of asm_out before the instructions to schedule
+ * 			were emitted
+ * @param flags_live	whether the condition codes set by the last
+ * 			instruction are used afterwards (i.e., by a
+ * 			conditional branch)
+ */
+void schedule_asm(union asm_component *mark, int flags_live);
+
+#endif	// SCHEDH
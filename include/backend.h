@@ -0,0 +1,78 @@
+/**
+ * 	Back end driver: quad generation, instruction selection and output of
+ * 	each function definition.
+ *
+ * 	Once the parser has finished a function definition, the function is
+ * 	handed to the back end along with its arena (see arena.h). With worker
+ * 	threads (-j), the quads and assembly of several functions are generated
+ * 	at the same time while the parser continues with the rest of the file;
+ * 	each worker takes the oldest function that no one has started on yet.
+ * 	The generated code is still output in source order, by whichever
+ * 	thread finishes the next function in order, so the output does not
+ * 	depend on the number of threads. Without worker threads, each function
+ * 	is generated and output right away on the parser thread.
+ *
+ * 	The state of quad generation and instruction selection is per-thread,
+ * 	and the parser thread doesn't modify anything that the workers read
+ * 	(string literals are pooled by the parser, and types shared between
+ * 	functions are created before parsing starts, see types_init()). Each
+ * 	function carries the context of its translation unit (see context.h),
+ * 	which the worker makes current while generating it.
+ * 	The number of functions in flight is bounded, so memory use is bounded
+ * 	by that many function arenas.
+ *
+ * 	With split parsing (-P, see split.h), the bodies of the functions of a
+ * 	file are submitted once the rest of it has been parsed, and each one is
+ * 	parsed by the worker that generates its code. The string literals and
+ * 	variables of each body are added to the translation unit in order,
+ * 	after the bodies before it, so a worker that is done parsing a body
+ * 	may have to wait for the others to catch up.
+ */
+
+#ifndef BACKENDH
+#define BACKENDH
+
+#include <parser/astnode.h>
+#include <arena.h>
+
+struct fn_body;
+
+/**
+ * start the back end
+ *
+ * @param nthreads	number of worker threads; if zero, functions are
+ * 			generated on the calling (parser) thread
+ */
+void backend_start(unsigned nthreads);
+
+/**
+ * generate and output the code for a function definition; the function's body
+ * and scope are cleared and its arena is released once its code has been
+ * output
+ *
+ * @param fndecl	declaration of the function (with its body)
+ * @param arena		arena that the function's body was allocated from
+ */
+void backend_submit(union astnode *fndecl, struct arena *arena);
+
+/**
+ * parse a function body that the lexer skipped, and generate and output its
+ * code (see backend_submit())
+ *
+ * @param body		function body (see split_defer())
+ */
+void backend_submit_body(struct fn_body *body);
+
+/**
+ * wait until all submitted function bodies have been parsed, and added to
+ * their translation unit
+ */
+void backend_wait_parsed(void);
+
+/**
+ * wait until the code of all submitted functions has been output, and stop
+ * the worker threads
+ */
+void backend_finish(void);
+
+#endif	// BACKENDH
@@ -12,9 +12,6 @@
 
 #include <stdio.h>
 
-// basic debugging info -- like the level in Hak's output
-#define DEBUG 1
-
 // extra debugging for debugging errors -- e.g., types for struct addr,
 // quads used in generation of sizeof operand (usually not emitted)
 #define DEBUG2 0
@@ -74,7 +71,7 @@ struct astnode_generic {
 #define NT(node) (node)->generic.type
 
 // assumes ll is not null
-extern union astnode *ll_append_iter;
+extern _Thread_local union astnode *ll_append_iter;
 #define _LL_APPEND(ll, node, next) {\
 	ll_append_iter = ll;\
 	while (ll_append_iter->next) {\
@@ -90,10 +87,27 @@ extern union astnode *ll_append_iter;
 // get next element in a linked list
 #define _LL_NEXT(ll, next) ((ll)->next)
 
+// linked list with a tail pointer, for constant-time appends
+struct astnode_ll {
+	union astnode *head, *tail;
+};
+
+// append a single node (its next pointer is not followed) to a struct
+// astnode_ll
+#define _LL_TAIL_APPEND(ll, node, next) {\
+	if ((ll).tail) {\
+		(ll).tail->next = (node);\
+	} else {\
+		(ll).head = (node);\
+	}\
+	(ll).tail = (node);\
+}
+
 // for convenience
 #define LL_APPEND(ll, node)	_LL_APPEND(ll, node, generic.next)
 #define LL_NEXT(ll) 		_LL_NEXT(ll, generic.next)
 #define LL_FOR(ll, iter)	_LL_FOR(ll, iter, generic.next)
+#define LL_TAIL_APPEND(ll, node) _LL_TAIL_APPEND(ll, node, generic.next)
 
 // global symbol to represent ellipsis declarator as an ordinary union astnode *
 // so that we don't have to handle it separately
@@ -109,10 +123,44 @@ extern int indi;
 // (not that it will not be implemented); not fatal
 #define NYI(what) yyerror(#what " not yet implemented");
 
-// max of two numbers
+// max/min of two numbers
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// round n up to a multiple of a, which must be a power of two
+#define ALIGN_UP(n, a) (((n) + (a) - 1) & ~((a) - 1))
+
+// debug file pointer (the output file is per translation unit, see context.h)
+extern FILE *dfp;
+
+// optimize for code size (-Os) rather than speed
+extern int optimize_size;
+
+// emit an ELF relocatable object file (-c) rather than assembly
+extern int emit_object;
+
+// load the object code into memory and run its main() (-r) rather than
+// writing it out (implies emit_object)
+extern int run_jit;
+
+// lex memory-mapped input on a separate thread, ahead of the parser (-p)
+extern int lex_thread;
+
+// parse the function bodies of memory-mapped input apart from the rest of the
+// file, on the back end workers (-P, see split.h)
+extern int split_parse;
+
+// debug dumps, selected at runtime with -d (e.g., -dAQ); all off by default
+enum debug_flag {
+	DEBUG_AST	= 1 << 0,	// -dA: declarations and function bodies
+	DEBUG_QUADS	= 1 << 1,	// -dQ: basic blocks of quads
+	DEBUG_FRAME	= 1 << 2,	// -dF: stack frame layout, global vars
+	DEBUG_STATS	= 1 << 3,	// -dS: arena/symtab/code size statistics
+};
+extern unsigned debug_flags;
 
-// debug and output file pointers
-extern FILE *dfp, *ofp;
+// whether a debug dump is enabled; the dumps are off in the common case, so
+// the test is a single (predicted not-taken) branch on a global
+#define DEBUGGING(flag)	__builtin_expect(!!(debug_flags & (flag)), 0)
 
 #endif	// COMMONH
\ No newline at end of file
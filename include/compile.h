@@ -0,0 +1,59 @@
+/**
+ * 	Compilation of a translation unit: the steps that the command line
+ * 	driver (main.c) and the in-memory compiler (see jit.h) share, and the
+ * 	error reporting of the parser (yyerror(), see parser.h).
+ *
+ * 	A translation unit is compiled by creating its context with
+ * 	begin_unit(), parsing one or more inputs into it (each function is
+ * 	handed to the back end as soon as it has been parsed, see backend.h),
+ * 	and ending it with end_unit(), which outputs its global variables.
+ *
+ * 	Warnings are printed to the debug file (see common.h). An error is fatal
+ * 	and exits, unless the context has somewhere to return to (error_jmp,
+ * 	see context.h), in which case the message is left in the context.
+ */
+
+#ifndef COMPILEH
+#define COMPILEH
+
+#include <stdio.h>
+#include <stddef.h>
+
+struct context;
+
+/**
+ * create the context of a translation unit, make it current, and open its
+ * global scope
+ *
+ * @param ofp		output file, or NULL if the code is only loaded into
+ * 			memory (see jit.h)
+ * @return		the new context
+ */
+struct context *begin_unit(FILE *ofp);
+
+/**
+ * parse an input file into the current context; regular files are
+ * memory-mapped and lexed by the fast path lexer (which skips the function
+ * bodies with -P, or runs on its own thread with -p), others by flex
+ *
+ * @param ifp		input file
+ */
+void parse_file(FILE *ifp);
+
+/**
+ * parse (preprocessed) source text in memory into the current context, with
+ * the fast path lexer
+ *
+ * @param src		source text (not necessarily null-terminated)
+ * @param len		length of the source text
+ */
+void parse_string(const char *src, size_t len);
+
+/**
+ * end the translation unit once all of its inputs have been parsed (and the
+ * back end has finished their functions, see backend_finish()): output its
+ * global variables after the functions
+ */
+void end_unit(void);
+
+#endif	// COMPILEH
@@ -0,0 +1,181 @@
+/**
+ * 	Compiler context: all of the state of the compilation of one
+ * 	translation unit, i.e., of its lexer and parser, the file arena and the
+ * 	tables allocated from it, the global variables and string literals that
+ * 	are emitted at the end of the file, and the output. Keeping it in one
+ * 	object (rather than in globals) lets several input files be compiled at
+ * 	the same time on different threads (-j), each into its own output file.
+ *
+ * 	cur_ctx points to the context of the translation unit that the current
+ * 	thread is working on; it is set by the thread that compiles a file (see
+ * 	context_enter()), and by the back end workers for each function they
+ * 	generate (see backend.h). State that only lives for the duration of a
+ * 	function (quads, instruction selection) is thread-local instead, and the
+ * 	options (see common.h) are shared, since they are set before any
+ * 	compilation starts.
+ */
+
+#ifndef CONTEXTH
+#define CONTEXTH
+
+#include <stdio.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <arena.h>
+#include <intern.h>
+#include <lexer/stringutils.h>
+#include <lexer/fastlex.h>
+#include <lexer/tokring.h>
+#include <parser/symtab.h>
+#include <parser/types.h>
+#include <parser/split.h>
+#include <asmgen/elfobj.h>
+
+struct context {
+	// context of the translation unit that this context belongs to: the
+	// context itself, except for the contexts that split-off function
+	// bodies are parsed in (see split.h), which use the intern table of
+	// their file
+	struct context *unit;
+
+	/**
+	 * LEXER
+	 */
+
+	// reentrant flex scanner
+	void *scanner;
+
+	// source position of the lexer, from the preprocessor line markers
+	// (see parse_lineno()); the filename is interned
+	char *filename;
+	int lineno;
+
+	// string or character literal being built (see stringutils.h)
+	struct literal literal;
+
+	// memory-mapped input (see fastlex.h)
+	struct fastlex lex;
+
+	// lexer thread and the ring of tokens that it has lexed, if the lexer
+	// runs ahead of the parser (see tokring.h)
+	struct token_ring *ring;
+
+	/**
+	 * FILE-SCOPE MEMORY
+	 */
+
+	struct arena file_arena;
+
+	// hashtable of interned strings, and the arena that they are stored in
+	// (see intern.c); with a lexer thread or split parsing, several threads
+	// intern strings, so they have their own arena, and a lock that is
+	// used while intern_shared is set
+	struct intern **intern_tab;
+	unsigned intern_cap, intern_count;
+	struct arena intern_arena;
+	pthread_mutex_t intern_lock;
+	int intern_shared;
+
+	// canonical types that live for the whole file (see types.c)
+	struct type_tab file_types;
+
+	/**
+	 * PARSER
+	 */
+
+	// source position, line of the input and text of the last token that
+	// the parser has read (see lex_token()), which are those of the lexer
+	// unless it runs ahead
+	char *tok_filename;
+	int tok_lineno, tok_line;
+	const char *tok_text;
+	int tok_len;
+
+	// stack of open scopes (see scope.c)
+	struct scope **scope_stack;
+	int scope_pos, scope_stack_capacity;
+
+	// see associate_fn_with_scope
+	struct scope *prev_fn_scope;
+
+	// special flag used for transferring prototype scopes to function
+	// scopes if definition (function body) follows function declaration
+	int prototype_hold, is_fndef;
+
+	// stack of struct/union definitions being parsed (see structunion.c)
+	union astnode **su_decl_stack;
+	int su_decl_stack_pos, su_decl_stack_capacity;
+
+	struct symtab_stats symtab_stats;
+
+	// function bodies that the lexer has skipped, to be parsed once the
+	// rest of the file has been, and the body being parsed in this context
+	// if it is one of them (see split.h)
+	struct fn_body *bodies, *bodies_tail;
+	struct fn_body *split_body;
+
+	// linked list of all the global (static/extern) variables, emitted at
+	// the end of the file (see decl.c)
+	union astnode *global_vars;
+
+	// distinct string literals, in order of appearance, and the pool that
+	// finds identical ones (see string_pool_get())
+	union astnode *string_ll, *string_ll_tail;
+	unsigned string_count;
+	union astnode **string_pool;
+	unsigned string_pool_cap;
+
+	/**
+	 * OUTPUT
+	 */
+
+	// output file, and the buffer that assembly (or the object file) is
+	// formatted into (see asm_flush())
+	FILE *ofp;
+	char *out_buf;
+	size_t out_len;
+
+	// object file being built (-c and -r)
+	struct obj_file obj;
+
+	// whether the object is loaded into memory rather than written out (-r,
+	// and units compiled by jit_compile(), see jit.h)
+	int jit;
+
+	/**
+	 * ERRORS
+	 */
+
+	// where a fatal error returns to, and its message, if the compiler is
+	// embedded (see jit_compile()); without it, a fatal error exits
+	jmp_buf *error_jmp;
+	char error[256];
+};
+
+extern _Thread_local struct context *cur_ctx;
+
+/**
+ * create the context of a translation unit
+ *
+ * @param ofp		output file, or NULL for a context that only parses
+ * 			(see split.h)
+ * @return		new context (not yet current)
+ */
+struct context *context_new(FILE *ofp);
+
+/**
+ * make a context current on this thread, and allocate from its file arena
+ *
+ * @param ctx		context
+ */
+void context_enter(struct context *ctx);
+
+/**
+ * free a context and all of the memory of its translation unit; the output
+ * file is not closed
+ *
+ * @param ctx		context
+ */
+void context_free(struct context *ctx);
+
+#endif	// CONTEXTH
@@ -0,0 +1,58 @@
+/**
+ * 	String interning for identifiers, filenames and labels. Each distinct
+ * 	string is stored exactly once, so interned strings can be compared by
+ * 	pointer rather than with strcmp(), and each one carries its hash
+ * 	(stored just before the characters) so that it never has to be hashed
+ * 	again, e.g., by the symbol tables (see symtab.h).
+ *
+ * 	Interned strings live in an arena of their own (see arena.h), so they
+ * 	may be used from any function of the file and are only freed with its
+ * 	context (see context.h); each translation unit has its own table, so
+ * 	strings interned for different files are different pointers. While
+ * 	several threads intern strings for the same file (the lexer thread,
+ * 	see tokring.h, or split-off function bodies, see split.h), the table is
+ * 	locked.
+ */
+
+#ifndef INTERNH
+#define INTERNH
+
+#include <stddef.h>
+
+// an interned string; the string itself is the str member, which is what
+// intern() returns
+struct intern {
+	unsigned hash, len;
+
+	// number of global (static/extern) variables with this name so far,
+	// which numbers the unique names of static symbols (see decl.c)
+	unsigned globals;
+
+	char str[];
+};
+
+/**
+ * returns the unique interned copy of a string
+ *
+ * @param str		null-terminated string
+ * @return		interned string with the same contents
+ */
+char *intern(const char *str);
+
+/**
+ * returns the unique interned copy of the first len characters of a string
+ * (e.g., of an identifier in the input, see fastlex.c)
+ *
+ * @param str		characters (not necessarily null-terminated)
+ * @param len		number of characters
+ * @return		interned (null-terminated) string with the same contents
+ */
+char *intern_len(const char *str, unsigned len);
+
+// the intern record of an interned string
+#define INTERN_REC(s)	((struct intern *) ((s) - offsetof(struct intern, str)))
+
+// precomputed hash of an interned string
+#define INTERN_HASH(s)	(INTERN_REC(s)->hash)
+
+#endif	// INTERNH
@@ -1,19 +1,17 @@
 #ifndef ERRORUTILSH
 #define ERRORUTILSH
 
-extern int lineno;
-extern char filename[255];
-
 // Simple function to parse preprocessor directive generated by
 // `gcc -E`. Note that this implementation (and the associated regex)
 // don't account for escaped quotes in the filename.
-// (Who puts quotes in filenames?)
-void parse_lineno();
+// (Who puts quotes in filenames?) The position is kept in the current
+// context (see context.h).
+void parse_lineno(const char *text);
 
 // Printing lexical errors with their context (i.e., with filename, lineno).
 // This is probably called once per start condition
 // (start condition ~ environment).
-void print_lexical_error();
+void print_lexical_error(const char *text);
 
 // Prints the name of the token type.
 char *toktostr(int enumval);
@@ -0,0 +1,125 @@
+/**
+ * 	Fast path lexer for memory-mapped input.
+ *
+ * 	Regular input files are mmap'd rather than read through the flex
+ * 	scanner's FILE buffer. Whitespace, line markers, identifiers, keywords,
+ * 	integers and operators (nearly all of the text of a preprocessed file,
+ * 	which is mostly headers) are lexed directly from the mapping: runs of
+ * 	characters of the same class are found with SSE2 (or AVX2, if the CPU
+ * 	has it) compares, keywords are found with a perfect hash, and
+ * 	identifiers are interned without being copied first. Anything else
+ * 	(string and character literals, floating-point numbers, invalid
+ * 	characters) is copied out and lexed by the flex rules (see lexer.l), so
+ * 	that escapes and errors are handled in one place.
+ *
+ * 	Input that can't be mapped (e.g., stdin from a pipe) is lexed by flex
+ * 	alone.
+ *
+ * 	The lexer of a mapped file may also run on a thread of its own, ahead
+ * 	of the parser (-p, see tokring.h), or skip function bodies so that
+ * 	they can be parsed on their own (-P, see split.h).
+ */
+
+#ifndef FASTLEXH
+#define FASTLEXH
+
+#include <stdio.h>
+#include <stddef.h>
+
+union YYSTYPE;
+
+// split parsing (see split.h): function bodies are skipped (SPLIT_FILE), or a
+// function body is lexed, starting with a SPLITSTART token (SPLIT_BODY)
+enum lex_split {
+	SPLIT_NONE,
+	SPLIT_FILE,
+	SPLIT_BODY,
+};
+
+// state of the fast path lexer (see struct context)
+struct fastlex {
+	// mapping of the input (with zero padding after it), and the position
+	// of the lexer in it; pos is NULL when flex reads the input
+	char *map;
+	size_t map_len;
+	const char *pos, *end;
+
+	// line of the input (as opposed to the line of the source file), and
+	// the last token
+	int line;
+	const char *tok;
+	int tok_len;
+
+	// copy of the text that flex is lexing
+	char *scratch;
+	size_t scratch_cap;
+
+	// whether to use AVX2 rather than SSE2
+	int avx2;
+
+	// split parsing mode, and the brace depth and the previous token, from
+	// which function bodies are recognized
+	enum lex_split split;
+	int depth, prev;
+};
+
+/**
+ * memory-map an input file for the fast path lexer of the current context
+ *
+ * @param ifp		input file
+ * @return		0 on success, nonzero if the file can't be mapped (and
+ * 			must be read by flex, see yyrestart())
+ */
+int lex_map(FILE *ifp);
+
+/**
+ * copy source text in memory into a mapping for the fast path lexer of the
+ * current context, as if it were a mapped file
+ *
+ * @param src		source text (not necessarily null-terminated)
+ * @param len		length of the source text
+ * @return		0 on success, nonzero if the memory couldn't be mapped
+ */
+int lex_map_string(const char *src, size_t len);
+
+/**
+ * unmap the input file (if mapped) once it has been parsed
+ */
+void lex_unmap(void);
+
+/**
+ * lexes the next token of the input file, calling flex's yylex() for input
+ * that isn't mapped; the text and line of the token are left in the fastlex
+ * state
+ *
+ * @param lval		semantic value of the token
+ * @return		token type, or 0 at the end of the input
+ */
+int lex_next(union YYSTYPE *lval);
+
+/**
+ * returns the next token for the parser (this is its yylex()), either from
+ * the lexer thread or from lex_next(), and records its source position in
+ * the context
+ *
+ * @param lval		semantic value of the token
+ * @return		token type, or 0 at the end of the input
+ */
+int lex_token(union YYSTYPE *lval);
+
+/**
+ * returns the line of the input of the last token that the parser has read
+ */
+int lex_lineno(void);
+
+/**
+ * returns the text of the last token that the parser has read, for error
+ * messages
+ *
+ * @param len		set to the length of the text (which is not
+ * 			null-terminated)
+ * @return		text of the last token
+ */
+const char *lex_text(int *len);
+
+#endif	// FASTLEXH
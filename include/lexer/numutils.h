@@ -10,23 +10,26 @@
  * see struct astnode_typespec_scalar (declspec.h) for more information on the
  * parameters
  * 
+ * @param text		digits (with the radix prefix, and any suffix)
  * @param radix		integer radix (2, 8, 16, 10)
  * @param type		basetype
  * @param lls		long/long long/short modifiers
  * @param sign		signed/unsigned modifiers
  * @return		constructed astnode representing the number
  */
-union astnode *make_int(int radix, enum scalar_basetype type,
-	enum scalar_lls lls, enum scalar_sign sign);
+union astnode *make_int(const char *text, int radix,
+	enum scalar_basetype type, enum scalar_lls lls, enum scalar_sign sign);
 
 /**
  * constructs a floating point constant literal
  * 
+ * @param text		literal (with any suffix)
  * @param type		basetype
  * @param lls		set to LLS_LONG for long double type
  * @return		constructed astnode representing the number
  */
-union astnode *make_fp(enum scalar_basetype type, enum scalar_lls lls);
+union astnode *make_fp(const char *text, enum scalar_basetype type,
+	enum scalar_lls lls);
 
 /**
  * constructs an integer constant 1
@@ -49,21 +49,31 @@ struct charlit {
 	union char_t value;
 };
 
+// a string or character literal being built by the lexer; for strings, cap
+// includes the null character at the end, len does not
+struct literal {
+	char *buf;
+	unsigned len, cap;
+	enum literal_type type;
+	enum char_width width;
+	union char_t value;
+};
+
 // begin building a string or (potentially wide) character constant in memory
-// isstr=1 if string literal, isstr=0 for character constant
-void begin_literal();
+// (in the current context); text is the opening quote and its prefix
+void begin_literal(const char *text);
 
 // finish building the string, returns the built string
 struct string end_string();
 struct charlit end_charlit();
 
 // appends a simple string to the current string being built
-void append_text();
+void append_text(const char *text);
 
 // parses an escape sequence and appends it to the current string being built
-void parse_append_escape();
-void parse_append_octal();
-void parse_append_hexadecimal();
+void parse_append_escape(const char *text);
+void parse_append_octal(const char *text);
+void parse_append_hexadecimal(const char *text);
 
 // helper to print a single byte, showing escape sequences;
 // prints to the buffer, which should be at least 5 bytes long
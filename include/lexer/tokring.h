@@ -0,0 +1,47 @@
+/**
+ * 	Token ring: lexing on a thread of its own (-p).
+ *
+ * 	The lexer of a memory-mapped file (see fastlex.h) can run ahead of the
+ * 	parser on another thread, which puts each token, with its semantic
+ * 	value and source position, into a ring buffer that the parser takes
+ * 	them from (see lex_token()). There is one producer and one consumer, so
+ * 	the ring needs no lock: each side only writes its own index, with a
+ * 	release store that the other side reads with an acquire load, and a
+ * 	side that finds the ring full (or empty) spins for a while, then
+ * 	yields.
+ *
+ * 	Whatever the lexer creates for a token has to outlive its slot in the
+ * 	ring: identifiers and filenames are interned (under a lock, see
+ * 	intern.h), the buffers of string literals are on the heap, and numbers
+ * 	are copied out of the lexer's arenas by the parser.
+ */
+
+#ifndef TOKRINGH
+#define TOKRINGH
+
+union YYSTYPE;
+
+struct token_ring;
+
+/**
+ * start the lexer thread of the current context, whose input must be mapped
+ * (see lex_map()); lex_token() reads from the ring until tokring_stop()
+ */
+void tokring_start(void);
+
+/**
+ * stop the lexer thread of the current context (it may not have reached the
+ * end of the input if the parser stopped early), and free the ring
+ */
+void tokring_stop(void);
+
+/**
+ * take the next token from the ring, waiting for the lexer if it is empty,
+ * and record its source position in the context
+ *
+ * @param lval		semantic value of the token
+ * @return		token type, or 0 at the end of the input
+ */
+int tokring_next(union YYSTYPE *lval);
+
+#endif	// TOKRINGH
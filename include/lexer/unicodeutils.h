@@ -7,6 +7,6 @@
 // updates buf to point to new string, and returns the size (in bytes)
 // of the buffer; generated string is not null-terminated and should be
 // freed after use
-size_t utowc(char *utf8_text, size_t char_width, void **buf);
+size_t utowc(const char *utf8_text, size_t char_width, void **buf);
 
 #endif // UNICODEUTILSH
\ No newline at end of file
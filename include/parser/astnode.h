@@ -9,6 +9,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <arena.h>
+#include <intern.h>
 #include <lexer/numutils.h>
 #include <lexer/stringutils.h>
 #include <parser/decl.h>
@@ -21,6 +23,12 @@ struct astnode_binop {
 
 	int op;
 	union astnode *left, *right;
+
+	// Sethi-Ullman label, filled in lazily during quad generation (see
+	// su_label() in exprquads.c): number of registers needed to evaluate
+	// this subtree (0 if not yet labeled), and whether the subtree has
+	// side effects or sequence points
+	int regs, impure;
 };
 
 struct astnode_unop {
@@ -66,12 +74,25 @@ struct astnode_string {
 
 	struct string string;
 	char *label;
+
+	// linked list of string literals (see string_ll in context.h)
+	union astnode *symbol_next;
+};
+
+// arguments of a function invocation; this is an array rather than a linked
+// list through the arguments' next fields, because an argument may be a symbol
+// (i.e., its decl node), which is already linked into other lists and may be
+// passed more than once
+struct arglist {
+	union astnode **args;
+	unsigned argc, cap;
 };
 
 struct astnode_fncall {		// function invocation
 	_ASTNODE
 
-	union astnode *fnname, *arglist;
+	union astnode *fnname;
+	struct arglist arglist;
 };
 
 struct astnode_comlit {		// compound literal
@@ -128,28 +149,34 @@ union astnode {
 // helper to print an astnode
 void print_astnode(union astnode *);
 
-// use calloc because it also zeros (malloc is not guaranteed to zero)
-#define ALLOC(var)\
-	(var)=(union astnode *)calloc(1, sizeof(union astnode));
+// allocation size of each astnode type (indexed by enum astnode_type)
+extern const size_t astnode_sizes[];
+
+// append an argument to an arglist (the array is grown in the current arena)
+void arglist_append(struct arglist *arglist, union astnode *arg);
 
+// allocate a node from the current arena (see arena.h); arena memory is
+// zeroed, and only sizeof the type's own struct is allocated (not the whole
+// union), so the node must not be accessed as another type
 #define ALLOC_TYPE(var, type_name)\
-	ALLOC(var);\
+	(var)=(union astnode *)arena_alloc(cur_arena, astnode_sizes[type_name]);\
 	(var)->generic.type = type_name;
 
+// idt must be an interned string (e.g., from the lexer)
 #define ALLOC_SET_IDENT(var, idt)\
-	ALLOC(var);\
-	(var)->ident=(struct astnode_ident){NT_IDENT, NULL, strdup(idt)}
+	ALLOC_TYPE(var, NT_IDENT);\
+	(var)->ident=(struct astnode_ident){NT_IDENT, NULL, idt}
 
 #define ALLOC_SET_BINOP(var, op, left, right)\
-	ALLOC(var);\
+	ALLOC_TYPE(var, NT_BINOP);\
 	(var)->binop=(struct astnode_binop){NT_BINOP, NULL, op, left, right}
 
 #define ALLOC_SET_UNOP(var, op, arg)\
-	ALLOC(var);\
+	ALLOC_TYPE(var, NT_UNOP);\
 	(var)->unop=(struct astnode_unop){NT_UNOP, NULL, op, arg};
 
 #define ALLOC_SET_TERNOP(var, first, second, third)\
-	ALLOC(var);\
+	ALLOC_TYPE(var, NT_TERNOP);\
 	(var)->ternop=(struct astnode_ternop){NT_TERNOP, NULL, first, second,third};
 
 // rewrite assignment-equals operators
@@ -160,22 +187,18 @@ void print_astnode(union astnode *);
 
 // helpers to alloc att
 #define ALLOC_DECLSPEC(var)\
-	ALLOC(var);\
-	(var)->declspec.type = NT_DECLSPEC;
+	ALLOC_TYPE(var, NT_DECLSPEC);
 
 #define ALLOC_SET_SCSPEC(var, storageclass)\
-	ALLOC(var);\
-	(var)->sc.type = NT_SC;\
+	ALLOC_TYPE(var, NT_SC);\
 	(var)->sc.scspec = storageclass;
 
 #define ALLOC_SET_TQSPEC(var, typequal)\
-	ALLOC(var);\
-	(var)->tq.type = NT_TQ;\
+	ALLOC_TYPE(var, NT_TQ);\
 	(var)->tq.qual |= typequal;
 
 #define ALLOC_SET_SCALAR(var, scalartype, longlongshort, signunsign)\
-	ALLOC(var);\
-	(var)->ts_scalar.type = NT_TS_SCALAR;\
+	ALLOC_TYPE(var, NT_TS_SCALAR);\
 	(var)->ts_scalar.basetype = scalartype;\
 	(var)->ts_scalar.modifiers.lls = longlongshort;\
 	(var)->ts_scalar.modifiers.sign = signunsign;
@@ -18,14 +18,20 @@
 #include <common.h>
 #include <lexer/errorutils.h>
 
-// linked list of all the global variables
-extern union astnode *global_vars;
+// size and alignment of a type in bytes, cached on the type's nodes once they
+// are computed (see sizeof.h); size 0 means not computed yet; aligned so that
+// it can be loaded and stored atomically
+struct type_layout {
+	_Alignas(8) unsigned size;
+	unsigned align;
+};
 
 // need a second linked-list pointer *of since the generic *next may be used
 // for linking declarators together (e.g., in parameter type list)
 #define _ASTNODE_DECLARATOR_COMPONENT\
 	_ASTNODE\
 	union astnode *of, *spec;\
+	struct type_layout layout;\
 
 // special linked list macros since this uses a different field name
 // (regular LL_* macros use generic.next)
@@ -100,6 +106,10 @@ struct astnode_decl {
 	// for local variables: need offset for target code generation
 	int offset;
 
+	// index of this local variable's operand in the operand table of its
+	// function (see var_addr()); stale once that function is done
+	unsigned addr_id;
+
 	// for static variables with the same name
 	char *static_uid;
 
@@ -156,6 +166,16 @@ union astnode *decl_function_new(union astnode *paramdecls);
  */
 void decl_install(union astnode *decl, union astnode *declspec);
 
+/**
+ * add an installed static/extern (or file-scope) variable to the global
+ * variables of the translation unit, giving it a unique name if it is static;
+ * this is done by decl_install(), except for the variables of a split-off
+ * function body (see split_finish())
+ *
+ * @param decl		declaration
+ */
+void decl_add_global(union astnode *decl);
+
 /**
  * check that the declarator of a function (declaration or definition) is valid,
  * and perform appropriate transformations. Will not have any effect if decl
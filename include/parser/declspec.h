@@ -26,6 +26,8 @@ struct astnode_typespec_scalar {
 			lls;
 		enum scalar_sign {SIGN_UNSPEC, SIGN_SIGNED, SIGN_UNSIGNED} sign;
 	} modifiers;
+
+	struct type_layout layout;
 };
 
 // type qualifiers
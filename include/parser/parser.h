@@ -8,10 +8,8 @@
 #ifndef PARSERH
 #define PARSERH
 
-extern int yylex();
 int yyerror(const char *err);
 int yyerror_fatal(const char *err);
-extern int yylineno, yydebug;
-extern char *yytext;
+extern int yydebug;
 
 #endif
\ No newline at end of file
@@ -105,4 +105,23 @@ struct scope *get_fn_scope();
  */
 void associate_fn_with_scope(union astnode *fn_decl);
 
+/**
+ * takes the held prototype scope of a function definition whose body is
+ * parsed later (see split.h) off the stack, without destroying it
+ *
+ * @return		the prototype scope, or NULL if none is held
+ */
+struct scope *scope_detach_proto(void);
+
+/**
+ * sets up the scope stack of the context that a split-off function body is
+ * parsed in, as if the function's declarator had just been parsed: the file
+ * scope, and the function's prototype scope (held, so that the body's
+ * compound statement makes it the function scope)
+ *
+ * @param file_scope	file scope of the translation unit
+ * @param proto		prototype scope (see scope_detach_proto()), or NULL
+ */
+void scope_attach_proto(struct scope *file_scope, struct scope *proto);
+
 #endif	// SCOPEH
\ No newline at end of file
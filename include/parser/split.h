@@ -0,0 +1,100 @@
+/**
+ * 	Split parsing (-P): the function bodies of a file are parsed apart from
+ * 	the rest of it, in parallel on the back end workers (see backend.h).
+ *
+ * 	A preprocessed file is mostly global declarations (from headers) and
+ * 	function bodies, which don't depend on each other. The file is parsed
+ * 	serially first, but without its function bodies: the lexer skips each
+ * 	one (a brace at the top level right after a parenthesis, i.e., after a
+ * 	function declarator) with a scan for its closing brace that only
+ * 	tracks literals and line markers, and returns it as a single FNBODY
+ * 	token. Once the rest of the file has been parsed, the bodies are
+ * 	handed to the back end in order, and each one is lexed and parsed from
+ * 	its text on whichever thread generates the code of its function, in a
+ * 	context of its own (with its own lexer and scope stack), which
+ * 	interns strings into the table of its file.
+ *
+ * 	The file scope is only read while the bodies are parsed. A body sees
+ * 	it as it was when its function was defined, i.e., symbols declared
+ * 	further down the file are ignored (see symtab_lookup_before()), so
+ * 	that calls to functions that are declared later are still implicit
+ * 	declarations. What a body adds to the translation unit, i.e., its
+ * 	string literals and static/extern variables, is added once it has been
+ * 	parsed, in source order (see split_finish()), so that their labels and
+ * 	names don't depend on which bodies were parsed first.
+ *
+ * 	Only memory-mapped input files are split (see fastlex.h).
+ */
+
+#ifndef SPLITH
+#define SPLITH
+
+#include <parser/astnode.h>
+#include <common.h>
+#include <arena.h>
+
+struct scope;
+
+// a function body that the lexer has skipped
+struct fn_body {
+	// text of the body, from its opening brace to just after its closing
+	// brace, and the position of the opening brace (see struct context)
+	const char *start, *end;
+	char *filename;
+	int lineno, line;
+
+	// function being defined, its prototype scope (see
+	// scope_detach_proto()), and the number of symbols inserted into each
+	// namespace of the file scope before the body (see scope_lookup())
+	union astnode *fndecl;
+	struct scope *proto;
+	unsigned visible[3];
+
+	// string literals and static/extern variables of the body, to be
+	// added to the translation unit (see split_finish())
+	struct astnode_ll strings, globals;
+
+	// arena that the body was parsed into
+	struct arena *arena;
+
+	// next body of the file
+	struct fn_body *next;
+};
+
+/**
+ * skip the function bodies of the current (memory-mapped) input file
+ */
+void split_begin(void);
+
+/**
+ * record a function definition whose body was skipped, to be parsed once the
+ * rest of the file has been
+ *
+ * @param fndecl	declaration of the function (installed)
+ * @param body		body skipped by the lexer
+ */
+void split_defer(union astnode *fndecl, struct fn_body *body);
+
+/**
+ * hand the skipped function bodies of the current input file to the back end,
+ * in order, and wait until they have all been parsed
+ */
+void split_end(void);
+
+/**
+ * parse a skipped function body into a new function arena (which is left
+ * current); called by the back end on the thread that generates its code
+ *
+ * @param body		function body
+ */
+void split_parse_body(struct fn_body *body);
+
+/**
+ * add the string literals and static/extern variables of a parsed function
+ * body to the translation unit; must be called in source order
+ *
+ * @param body		function body (see split_parse_body())
+ */
+void split_finish(struct fn_body *body);
+
+#endif	// SPLITH
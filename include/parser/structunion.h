@@ -21,12 +21,15 @@ struct astnode_typespec_structunion {
 	enum structunion_type su_type;
 
 	// linked-list and hashtable of members as symbols
-	union astnode *members;
+	struct astnode_ll members;
 	struct symtab members_ht;
 
 	// to prevent multiple (nested) redefinition: see structunion.h
 	int is_complete, is_being_defined;
 
+	// only cached once the struct/union is complete
+	struct type_layout layout;
+
 	// for debugging purposes: prints out where struct is defined
 	char *def_filename;
 	int def_lineno;
@@ -1,45 +1,73 @@
 /**
  * 	Data types and utilities for managing a symbol table. The symbol table
  * 	is a hashtable (mapping char * -> union astnode *) with automatic
- * 	rehashing.
+ * 	rehashing. Keys must be interned strings (see intern.h): they are
+ * 	compared by pointer and hashed with their precomputed hash.
  *
  * 	This is used in the regular symbol tables in scope.h, as well as the
  * 	"mini" symbol tables in structunion.h.
  *
- * 	TODO: these symbol tables never get freed (memory allocation is scary)
+ * 	Tables and symbols are allocated from the current arena (see arena.h),
+ * 	so the symbol tables of a function are freed along with the function.
  */
 
 #ifndef SYMTABH
 #define SYMTABH
 
+#include <stdio.h>
 #include <parser/parser.h>
 
 // an entry in the symbol table; basically a key-value pair; this is a plain
-// C struct and not an astnode because it doesn't have to be
+// C struct and not an astnode because it doesn't have to be; entries are
+// stored inline in the table, with the key's hash and its insertion number
+// (ident is NULL for an empty slot)
 struct symbol {
 	char *ident;
 	union astnode *value;
+	unsigned hash, seq;
 };
 
-// symbol table struct (a hashtable)
+// symbol table struct (a hashtable with open addressing and linear probing);
+// capacity is a power of two, and the table is kept at most half full; the
+// table is only allocated on the first insert (most scopes don't declare
+// anything in most namespaces), from the arena that was current when the
+// symtab was initialized (i.e., the arena of its scope or struct); seq is the
+// number of symbols ever inserted
 struct symtab {
-	struct symbol **bs;
-	int size, capacity;
+	struct symbol *bs;
+	unsigned size, capacity, seq;
+	struct arena *arena;
+};
+
+// counters over all symbol tables of a translation unit (in its context, see
+// context.h), to check how well the tables behave
+struct symtab_stats {
+	// number of lookups (including those done by inserts and deletes),
+	// total and longest probe sequences (in slots examined)
+	unsigned long lookups, probes, max_probe;
+
+	// number of tables allocated (empty symtabs don't have one), and
+	// number of times a table was grown
+	unsigned long tables, inserts, deletes, rehashes;
+
+	// largest table (in entries), and the highest load factor reached
+	unsigned max_size;
+	double max_load;
 };
 
 /**
- * functions for symtab management
+ * functions for symtab management; symtab_init() doesn't allocate anything
  *
  * @param st 	symbol table
  */
-void *symtab_init(struct symtab *st);
+void symtab_init(struct symtab *st);
 void symtab_destroy(struct symtab *st);
 
 /**
  * insert symbol into symtab
  *
  * @param st 	symbol table
- * @param ident symbol key
+ * @param ident symbol key (interned)
  * @param node 	astnode_symbol instance
  */
 void symtab_insert(struct symtab *st, char *ident, union astnode *node);
@@ -48,11 +76,39 @@ void symtab_insert(struct symtab *st, char *ident, union astnode *node);
  * lookup a key in the symbol table
  *
  * @param st	symbol table
- * @param ident	key to look up
+ * @param ident	key to look up (interned)
  * @return	pointer to symbol if found, otherwise NULL
  */
 union astnode *symtab_lookup(struct symtab *st, char *ident);
 
+/**
+ * lookup a key among the symbols that were inserted before a point in time
+ * (see struct fn_body)
+ *
+ * @param st	symbol table
+ * @param ident	key to look up (interned)
+ * @param seq	value of st->seq at that time
+ * @return	pointer to symbol if found and inserted before, otherwise NULL
+ */
+union astnode *symtab_lookup_before(struct symtab *st, char *ident,
+	unsigned seq);
+
+/**
+ * remove a key from the symbol table
+ *
+ * @param st	symbol table
+ * @param ident	key to remove (interned)
+ * @return	the removed symbol, or NULL if the key was not in the table
+ */
+union astnode *symtab_delete(struct symtab *st, char *ident);
+
+/**
+ * print the symbol table counters (see struct symtab_stats)
+ *
+ * @param fp	output stream
+ */
+void symtab_print_stats(FILE *fp);
+
 /**
  * for parser.y non-functions: throws fatal error if symbol not found
  */
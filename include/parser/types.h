@@ -0,0 +1,78 @@
+/**
+ * 	Canonical (hash-consed) types. A type is a chain of declarator
+ * 	components (pointer, array, function) ending in a declspec or a bare
+ * 	typespec (see decl.h); type_canon() maps such a chain to the unique
+ * 	node for that type, so that two canonical types are equal iff they are
+ * 	the same pointer.
+ *
+ * 	Scalars, qualified declspecs, pointers and arrays are shared. A declspec
+ * 	without qualifiers is the same type as its typespec, and so it is
+ * 	canonicalized to the typespec (storage class is not part of a type).
+ * 	Struct/union typespecs and function declarators are already unique per
+ * 	declaration (the latter carry their parameter declarations), so they
+ * 	are their own canonical type.
+ *
+ * 	Canonical scalar types are created in the file arena and are shared
+ * 	across functions; the others are created in the current arena (since
+ * 	they may refer to types that only live as long as it), and those
+ * 	created in a function arena are forgotten at the start of the next
+ * 	function (see types_fn_reset()). Functions may be generated on several
+ * 	threads at once, so each thread has its own table of function types,
+ * 	and all of the scalar types are created up front (see types_init()) so
+ * 	that the shared table is only read while functions are being generated.
+ *
+ * 	The size and alignment of a type are computed once and cached on its
+ * 	nodes (see sizeof.h).
+ */
+
+#ifndef TYPESH
+#define TYPESH
+
+#include <parser/astnode.h>
+
+// hashtable of canonical types (open addressing, linear probing); capacity is
+// a power of two, and the table is kept at most half full
+struct type_tab {
+	union astnode **bs;
+	unsigned size, capacity;
+	struct arena *arena;
+};
+
+/**
+ * returns the canonical type of a type chain
+ *
+ * @param type		declarator component chain or typespec
+ * @return		canonical type
+ */
+union astnode *type_canon(union astnode *type);
+
+/**
+ * canonical scalar, pointer and array types
+ *
+ * @param basetype	scalar base type
+ * @param lls		long/long long/short modifier
+ * @param sign		signedness modifier
+ * @param of		type pointed to/array element type (need not be
+ * 			canonical)
+ * @param length	number of array elements
+ * @return		canonical type
+ */
+union astnode *type_scalar(enum scalar_basetype basetype, enum scalar_lls lls,
+	enum scalar_sign sign);
+union astnode *type_pointer_to(union astnode *of);
+union astnode *type_array_of(union astnode *of, uint64_t length);
+
+/**
+ * forget the canonical types that were created in the previous function's
+ * arena; must be called (by the thread generating the function, with the
+ * function's arena current) before canonicalizing types for a new function
+ */
+void types_fn_reset(void);
+
+/**
+ * create all of the canonical scalar types of the current context; must be
+ * called before functions are generated on other threads
+ */
+void types_init(void);
+
+#endif	// TYPESH
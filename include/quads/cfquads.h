@@ -122,14 +122,13 @@ void gen_ret_quads(union astnode *stmt);
 
 
 /**
- * links the current basic block to its successor(s), and reverses the quads
- * in the current bb
+ * links the current basic block to its successor(s)
  *
  * semantics:
  * - since it only makes sense to link the current bb to the next when all the
  * 	quads of the current basic block are finished, this acts as a de facto
- * 	indication that the current basic block is complete; thus it performs
- * 	the quad reversal as well
+ * 	indication that the current basic block is complete; no more quads may
+ * 	be emitted to it afterwards
  *
  * @param cc		condition code to branch on, or CC_UNSPEC for
  * 			unconditional branch
@@ -9,9 +9,18 @@
 #include <quads/quads.h>
 
 /**
- * linked list of astnode string for target code generation
+ * returns the pooled copy of a string literal (in the file arena, since strings
+ * are emitted at the end of the file); a new literal is given the next .RO
+ * label and appended to the linked list of string literals of the current
+ * context (string_ll, see context.h)
+ *
+ * this is called by the parser, so that literals are numbered in source order
+ * even when functions are generated on several threads
+ *
+ * @param str		string literal
+ * @return		NT_STRING node in string_ll with the same contents
  */
-extern union astnode *string_ll;
+union astnode *string_pool_get(struct string *str);
 
 /**
  * helper function to generate a typespec emulating size_t (which acts like an
@@ -20,7 +29,7 @@ extern union astnode *string_ll;
  * For use when generating a compile-time constant representing some pointer
  * constant (i.e., for use with sizeof and pointer arithmetic)
  *
- * @return		unsigned long long astnode typespec representation
+ * @return		canonical unsigned long long typespec (see types.h)
  */
 union astnode *create_size_t(void);
 
@@ -28,7 +37,7 @@ union astnode *create_size_t(void);
  * helper function to generate a typespec emulating int (e.g., for value of
  * a relational operator)
  *
- * @return		(regular signed) int astnode typespec representation
+ * @return		canonical (regular signed) int typespec
  */
 union astnode *create_int(void);
 
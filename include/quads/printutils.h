@@ -7,6 +7,14 @@
 
 #include <quads/quads.h>
 
+/**
+ * Returns the mnemonic of a quad opcode
+ *
+ * @param oc			quad opcode
+ * @return			opcode name
+ */
+char *opcode2str(enum opcode oc);
+
 /**
  * Prints a single quad
  *
@@ -15,7 +15,7 @@
 // block generation;
 // bb_ll is a linked list of the basic blocks in the desired order, which
 // is controlled by adding basic blocks with bb_ll_push()
-extern struct basic_block *cur_bb, *bb_ll;
+extern _Thread_local struct basic_block *cur_bb, *bb_ll;
 
 /**
  * List of opcodes for the quad IR
@@ -30,7 +30,7 @@ enum opcode {
 	// we still need this (e.g., directly chained assignment)
 	OC_MOV,		// target = MOV src
 
-	// fncall; arglist is a linked list of addr values
+	// fncall; arglist is an index into call_args (see CALL_ARG())
 	OC_CALL,	// target = CALL fn, arglist
 
 	// arithmetic
@@ -73,18 +73,14 @@ enum cc {
 
 /**
  * A single instruction in the quad (3-address) IR.
+ *
+ * Quads are stored contiguously in their basic block, and refer to their
+ * operands by index into the current function's operand table (see ADDR());
+ * index 0 means that there is no such operand.
  */
 struct quad {
-	// linked list of quads
-	// not sure if we'll need prev yet
-	struct quad *next, *prev;
-
-	// pointer to containing basic block
-	// not sure if we'll need it yet
-	struct basic_block *bb;
-
 	enum opcode opcode;
-	struct addr *dest, *src1, *src2;
+	unsigned dest, src1, src2;
 };
 
 /**
@@ -97,8 +93,8 @@ struct quad {
  * a constant (scalar) has maximum size 64 bits.
  */
 struct addr {
-	// linked list (e.g., for fncall arglist)
-	struct addr *next;
+	// index in the operand table
+	unsigned id;
 
 	// reference to astnode, temporary (pseudo-register), constant value,
 	// string literal
@@ -109,6 +105,12 @@ struct addr {
 	// size (e.g., 8 bytes on an x86_64 arch.)
 	unsigned size;
 
+	// memory offset for pseudo-registers (AT_TMP addr values) 
+	// (this is due to us using a really simple (bad) register
+	// "allocation" model -- every temporary value is memory-backed);
+	// this has no meaning for non-tmp vals
+	int offset;
+
 	// data associated with each type
 	union addr_val {
 		union astnode *astnode;
@@ -116,16 +118,47 @@ struct addr {
 		unsigned tmpid;
 	} val;
 
-	// memory offset for pseudo-registers (AT_TMP addr values) 
-	// (this is due to us using a really simple (bad) register
-	// "allocation" model -- every temporary value is memory-backed);
-	// this has no meaning for non-tmp vals
-	int offset;
-
-	// astnode representation of addr type
+	// astnode representation of addr type; always a canonical type (see
+	// types.h), so types of addrs can be compared by pointer
 	union astnode *decl;
+
+	// instruction selection info for temporaries (see isel.c): the quad
+	// that defines it, the number of definitions and uses (a temporary
+	// only has a few), and whether it is folded into its only use (and
+	// thus never materialized in memory)
+	struct quad *def;
+	unsigned short defs, uses;
+	int fold;
 };
 
+/**
+ * Operand table of the function being generated: every struct addr is
+ * registered here when it is created, and quads refer to it by its index.
+ * There is only one addr for each variable and for each distinct constant
+ * (see var_addr() and const_addr()); every temporary has its own addr.
+ *
+ * addrs[0] is always NULL, so an absent operand reads as NULL.
+ */
+extern _Thread_local struct addr **addrs;
+extern _Thread_local unsigned addr_count;
+
+/**
+ * Argument lists of the fncalls in the function being generated: the src2
+ * index of an OC_CALL quad points to the number of arguments, which is
+ * followed by the operand indices of the arguments
+ */
+extern _Thread_local unsigned *call_args;
+
+// quad operands
+#define ADDR(id)	(addrs[id])
+#define QDEST(q)	ADDR((q)->dest)
+#define QSRC1(q)	ADDR((q)->src1)
+#define QSRC2(q)	ADDR((q)->src2)
+
+// fncall arguments (for OC_CALL quads only)
+#define CALL_ARGC(q)	(call_args[(q)->src2])
+#define CALL_ARG(q, i)	ADDR(call_args[(q)->src2 + 1 + (i)])
+
 /**
  * addressing mode for lvalues: AM_DIRECT for regular variables (memory values),
  * AM_INDIRECT for pointers (indirect memory values)
@@ -133,19 +166,22 @@ struct addr {
 enum addr_mode { AM_DIRECT, AM_INDIRECT };
 
 /**
- * Holds a linked list of quads (which may be in reverse order when building
- * the basic_block; see generate_quads()), and information about predecessor/
+ * Holds an array of quads (in order), and information about predecessor/
  * successor basic blocks
  *
  * Is uniquely identified by its function name and basic block number within
  * the function.
  */
 struct basic_block {
-	struct quad *ll;
+	// quads in the basic block; the array grows as quads are emitted
+	struct quad *quads;
+	unsigned nquads, quads_cap;
 
-	// basic block identifier
-	char *fn_name;
+	// basic block identifier, and its label (.BB.[fn name].[bb_no]); all
+	// references to the block share the label string, so labels can be
+	// compared by pointer
 	int bb_no;
+	char *label;
 
 	// next_def is default (fall-through) BB
 	// next_cond is non-default (conditional) BB
@@ -156,7 +192,7 @@ struct basic_block {
 	// generation (for bb_ll); don't confuse this with next_def, next_cond
 	struct basic_block *next;
 
-	// indicate whether bb is finalized (i.e., quads reversed)
+	// indicate whether bb is finalized (i.e., its successors are set)
 	// this gets set to 1 in link_bb(); allows us to detect when quads
 	// are being generated in a defunct basic_block
 	int finalized;
@@ -173,15 +209,6 @@ struct basic_block {
  */
 struct basic_block *basic_block_new(int add_to_ll);
 
-/**
- * returns the name of a basic block as a newly-allocated string, in the format
- * .BB.[fn name].[basic block id]
- * 
- * @param bb		basic block
- * @return		basic block name
- */
-char *bb_name(struct basic_block *bb);
-
 /**
  * adds the basic block to the linearized set of basic blocks. Calling this
  * manually allows you to set the position of a basic block in the linearization
@@ -219,11 +246,24 @@ struct basic_block *dummy_basic_block_new(void);
  * @param dest		quad destination; must be an lvalue
  * @param src1		quad first operand
  * @param src2		quad second operand
- * @return		generated quad
+ * @return		generated quad; only valid until the next quad is
+ * 			emitted to the same basic block
  */
 struct quad *quad_new(enum opcode opcode, struct addr *dest, struct addr *src1,
 	struct addr *src2);
 
+/**
+ * emits a new fncall quad to the current basic block
+ *
+ * @param dest		return value destination (may be null)
+ * @param fn		function to call
+ * @param args		arguments, in order
+ * @param argc		number of arguments
+ * @return		generated quad (see quad_new())
+ */
+struct quad *quad_call_new(struct addr *dest, struct addr *fn,
+	struct addr **args, unsigned argc);
+
 /**
  * constructs and returns a new struct addr (operand/dest to quad)
  *
@@ -244,6 +284,23 @@ struct addr *addr_new(enum addr_type type, union astnode *decl);
  */
 struct addr *tmp_addr_new(union astnode *decl);
 
+/**
+ * returns the (interned) struct addr for a variable
+ *
+ * @param decl		declaration of the variable
+ * @return		struct addr for the variable
+ */
+struct addr *var_addr(union astnode *decl);
+
+/**
+ * returns the (interned) struct addr for a scalar constant
+ *
+ * @param decl		astnode representation of the type of the constant
+ * @param value		value of the constant
+ * @return		struct addr for the constant
+ */
+struct addr *const_addr(union astnode *decl, uint64_t value);
+
 /**
  * recursively generate quads for a list of statements
  *
@@ -254,13 +311,8 @@ void gen_stmt_quads(union astnode *stmt);
 /**
  * Generate basic blocks and quads for a function (top-level)
  *
- * Like complex declarations, basic blocks are built "in reverse" (by nature
- * of a singly-linked list) and then reversed when complete. While having a
- * second pointer would make it easy to build in the correct order, we do away
- * with all the troubles of maintaining extra pointers. (Alternatively, we
- * could append to the end of the list, but this would be less efficient
- * w/ O(N) rather than O(1) inserts). The bb will be reversed when it is
- * complete, i.e., when link_bbs is called on the basic block
+ * Like complex declarations, the list of basic blocks is built "in reverse"
+ * (by nature of a singly-linked list) and then reversed when complete.
  *
  * @param fn_decl		declarator for a function definition
  */
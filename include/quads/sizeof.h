@@ -28,4 +28,23 @@ unsigned astnode_sizeof_symbol(union astnode *node);
  */
 unsigned astnode_sizeof_type(union astnode *type);
 
+/**
+ * Returns the alignment of a type. Supposed to be equivalent to
+ * `_Alignof(typename)`.
+ *
+ * @param type		type to take the alignment of (see astnode_sizeof_type())
+ * @return		alignment of the type, in bytes
+ */
+unsigned astnode_alignof_type(union astnode *type);
+
+/**
+ * Returns the size and alignment of a type. Computed at most once per type
+ * node and then cached on it (struct/union types only once they are
+ * complete); the other functions are shorthands for this.
+ *
+ * @param type		type to lay out (see astnode_sizeof_type())
+ * @return		size and alignment of the type, in bytes
+ */
+struct type_layout astnode_layout_type(union astnode *type);
+
 #endif
@@ -0,0 +1,72 @@
+// exercises the instruction encodings and relocations of the object file
+// writer (-c); its output should match the assembler's (see README.md)
+
+// .comm, and .local + .comm
+int enc_common[64];
+static long enc_local[300];
+static char enc_bytes[16];
+
+int enc_test(void)
+{
+	char c;
+	unsigned char uc;
+	short s;
+	unsigned short us;
+	int i, j, sum, big[100];
+	long l;
+
+	// sign and zero extension (movs/movz)
+	c = 0 - 5;
+	uc = 250;
+	s = 0 - 300;
+	us = 60000;
+	i = c;
+	j = uc;
+	sum = i + j + s + us;
+
+	// 8-bit and 32-bit immediates
+	sum = sum + 3;
+	sum = sum - 100000;
+	l = sum * 7;
+	l = l + 1000000;
+
+	// indexed operands (SIB), with 8-bit and 32-bit displacements (big is
+	// more than 128 bytes away from the frame pointer), in short loops
+	for (i = 0; i < 100; ++i) {
+		big[i] = i * 3;
+	}
+	for (i = 0; i < 64; ++i) {
+		enc_common[i] = big[i % 100] + i;
+	}
+	for (i = 0; i < 16; ++i) {
+		enc_bytes[i] = i * 16;
+	}
+
+	// setcc
+	j = (sum < i) + (sum == 0) + (i != 16) + (uc > c) + (s >= us);
+
+	// near jumps over a loop body longer than 127 bytes
+	for (i = 0; i < 300; ++i) {
+		enc_local[i] = i;
+		enc_local[i] = enc_local[i] * 2 + big[i % 100];
+		enc_local[i] = enc_local[i] - enc_common[i % 64];
+		enc_local[i] = enc_local[i] + enc_bytes[i % 16];
+		if (enc_local[i] > 1000) {
+			enc_local[i] = enc_local[i] - 1000;
+		} else if (enc_local[i] < 10) {
+			enc_local[i] = enc_local[i] + 1000;
+		}
+		enc_local[i] = enc_local[i] + big[(i + 7) % 100] * 5;
+		enc_local[i] = enc_local[i] + enc_common[(i + 3) % 64];
+	}
+	l = 0;
+	for (i = 0; i < 300; ++i) {
+		l = l + enc_local[i];
+	}
+
+	// calls through the PLT, and pooled string literals
+	printf("encodings: %d %d %ld\n", sum, j, l);
+	printf("encodings: %d\n", big[99]);
+	printf("encodings: %d\n", enc_bytes[15]);
+	return sum;
+}
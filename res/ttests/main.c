@@ -47,5 +47,11 @@ int main(void)
 	long fib(int);
 	printf("%dth fibonacci number: %ld\n", 75, fib(75));
 
+	// instruction encodings and relocations (see encodings.c)
+	enc_test();
+
+	// function bodies parsed apart from the rest of the file (see split.c)
+	split_test();
+
 	return 0;
 }
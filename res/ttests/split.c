@@ -0,0 +1,71 @@
+// exercises split parsing (-P): the function bodies are parsed after the rest
+// of the file, but the output should be that of the serial compile (see
+// README.md)
+
+// only used inside function bodies
+struct split_pair {
+	int first;
+	int second;
+	int third;
+};
+
+int split_calls;
+
+// each body has a static local of the same name, and string literals that
+// other bodies share
+int split_a(int n)
+{
+	static int count;
+	struct split_pair *pair;
+
+	count = count + n;
+	pair = 0;
+	printf("split: %s %d\n", "a", count);
+	return count + (pair == 0);
+}
+
+int split_b(int n)
+{
+	static int count;
+
+	count = count + 2 * n;
+	printf("split: %s %d\n", "b", count);
+	printf("split: size %d\n", sizeof(struct split_pair));
+	return count;
+}
+
+int split_c(int n)
+{
+	static int count;
+	static char tag[8];
+
+	count = count + 3 * n;
+	tag[0] = 99;
+	printf("split: %s %d %d\n", "c", count, tag[0]);
+
+	// split_later() is declared further down the file, so this is an
+	// implicit declaration in both modes
+	return count + split_later(n);
+}
+
+int split_later(int n)
+{
+	static int count;
+
+	count = count + 1;
+	split_calls = split_calls + count;
+	printf("split: %s %d\n", "later", count);
+	return n * 100;
+}
+
+int split_test(void)
+{
+	int i, sum;
+
+	sum = 0;
+	for (i = 1; i <= 3; ++i) {
+		sum = sum + split_a(i) + split_b(i) + split_c(i);
+	}
+	printf("split: %s %d %d\n", "sum", sum, split_calls);
+	return sum;
+}
@@ -0,0 +1,149 @@
+#include <arena.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <parser/parser.h>
+#include <common.h>
+#include <context.h>
+
+// default chunk size; larger requests get a chunk of their own
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+#define ARENA_ALIGN		16
+
+_Thread_local struct arena *cur_arena;
+size_t fn_arena_peak;
+
+// released function arenas
+static struct arena *free_fn_arenas;
+static pthread_mutex_t fn_arenas_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// allocate a new (zeroed) chunk of at least size bytes and link it in after
+// the current chunk, so that all chunks after the current one are unused
+static void arena_grow(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+
+	size = MAX(size, ARENA_CHUNK_SIZE);
+	if (!(chunk = calloc(1, sizeof(struct arena_chunk) + size))) {
+		yyerror_fatal("out of memory");
+	}
+	chunk->end = chunk->mem + size;
+
+	if (arena->chunk) {
+		chunk->next = arena->chunk->next;
+		arena->chunk->next = chunk;
+	} else {
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	arena->chunk = chunk;
+	arena->ptr = chunk->mem;
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	char *mem;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+	// move on to the next (already-allocated) chunk if it is big enough,
+	// otherwise get a new one
+	if (!arena->chunk || arena->ptr + size > arena->chunk->end) {
+		if (!arena->chunk && arena->chunks
+			&& arena->chunks->mem + size <= arena->chunks->end) {
+			arena->chunk = arena->chunks;
+			arena->ptr = arena->chunk->mem;
+		} else if (arena->chunk && arena->chunk->next
+			&& arena->chunk->next->mem + size
+				<= arena->chunk->next->end) {
+			arena->chunk = arena->chunk->next;
+			arena->ptr = arena->chunk->mem;
+		} else {
+			arena_grow(arena, size);
+		}
+	}
+
+	mem = arena->ptr;
+	arena->ptr += size;
+
+	arena->used += size;
+	arena->peak = MAX(arena->peak, arena->used);
+
+	return mem;
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	return memcpy(arena_alloc(arena, len), str, len);
+}
+
+void arena_reset(struct arena *arena)
+{
+	struct arena_chunk *chunk;
+
+	if (!arena->chunk) {
+		return;
+	}
+
+	// re-zero the memory that was handed out, so that arena_alloc() can
+	// keep returning zeroed memory without clearing each allocation; the
+	// chunks up to the current one have been used, the rest are untouched
+	for (chunk = arena->chunks; chunk != arena->chunk; chunk = chunk->next) {
+		memset(chunk->mem, 0, chunk->end - chunk->mem);
+	}
+	memset(chunk->mem, 0, arena->ptr - chunk->mem);
+
+	arena->chunk = NULL;
+	arena->ptr = NULL;
+	arena->used = 0;
+}
+
+void arena_free(struct arena *arena)
+{
+	struct arena_chunk *chunk, *next;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+
+	arena->chunks = arena->chunk = NULL;
+	arena->ptr = NULL;
+	arena->used = 0;
+}
+
+struct arena *fn_arena_begin(void)
+{
+	struct arena *arena;
+
+	pthread_mutex_lock(&fn_arenas_lock);
+	if ((arena = free_fn_arenas)) {
+		free_fn_arenas = arena->next;
+	}
+	pthread_mutex_unlock(&fn_arenas_lock);
+
+	if (!arena && !(arena = calloc(1, sizeof(struct arena)))) {
+		yyerror_fatal("out of memory");
+	}
+	return cur_arena = arena;
+}
+
+void fn_arena_end(void)
+{
+	cur_arena = &cur_ctx->file_arena;
+}
+
+void fn_arena_release(struct arena *arena)
+{
+	arena_reset(arena);
+
+	pthread_mutex_lock(&fn_arenas_lock);
+	fn_arena_peak = MAX(fn_arena_peak, arena->peak);
+	arena->next = free_fn_arenas;
+	free_fn_arenas = arena;
+	pthread_mutex_unlock(&fn_arenas_lock);
+}
@@ -2,15 +2,23 @@
 #include <quads/sizeof.h>
 #include <quads/exprquads.h>
 #include <asmgen/asm.h>
+#include <asmgen/isel.h>
+#include <asmgen/sched.h>
+#include <asmgen/optsize.h>
+#include <asmgen/elfobj.h>
+#include <context.h>
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
-// linearized linked list of directives
-union asm_component *asm_out;
+// linearized linked list of directives (of the function being generated by
+// this thread)
+_Thread_local union asm_component *asm_out;
 
 // x86_64 param register order; we assume no more than 6 parameters in a fncall
-static enum asm_reg_name param_reg[] = {AR_DI, AR_SI, AR_D, AR_C, AR_8, AR_9};
+enum asm_reg_name param_reg[] = {AR_DI, AR_SI, AR_D, AR_C, AR_8, AR_9};
 
 // generate asm instruction, add to ll
 union asm_component *asm_inst_new(enum asm_opcode oc, struct asm_addr *src,
@@ -53,7 +61,7 @@ union asm_component *asm_label_new(char *name)
 
 	ALLOC_AC(component, ACT_LABEL);
 
-	component->label.name = strdup(name);
+	component->label.name = name;
 
 	// insert instruction into ll
 	component->generic.next = asm_out;
@@ -63,7 +71,7 @@ union asm_component *asm_label_new(char *name)
 
 struct asm_addr *reg2addr(enum asm_reg_name name, enum asm_size size)
 {
-	struct asm_addr *addr = calloc(1, sizeof(struct asm_addr));
+	struct asm_addr *addr = ARENA_NEW(struct asm_addr);
 
 	addr->mode = AAM_REGISTER;
 	addr->size = size;
@@ -75,7 +83,7 @@ struct asm_addr *reg2addr(enum asm_reg_name name, enum asm_size size)
 
 struct asm_addr *addr2asmaddr(struct addr *addr)
 {
-	struct asm_addr *asm_addr = calloc(1, sizeof(struct asm_addr));
+	struct asm_addr *asm_addr = ARENA_NEW(struct asm_addr);
 	switch(addr->type)
 	{
 		case AT_AST:	asm_addr->mode = AAM_MEMORY;	break;
@@ -101,268 +109,6 @@ struct asm_addr *addr2asmaddr(struct addr *addr)
 	return asm_addr;
 }
 
-//select the opcodes and find the size 
-struct asm_inst *select_asm_inst(struct quad *quad)
-{
-	union asm_component *cmp;
-	struct asm_inst *inst;
-	struct asm_addr *tmp1, *tmp2, *tmp3;
-	struct asm_addr *src1, *src2, *dest;
-	enum asm_size size_tmp;
-
-	switch(quad->opcode)
-	{
-		case OC_MOV:
-			// have to break this up in case of memory-memory mov
-			// in quad opcode
-			src1 = addr2asmaddr(quad->src1);
-			dest = addr2asmaddr(quad->dest);
-
-			// implicit cast
-			if (src1->size != dest->size) {
-				goto implcast;
-			}
-
-			tmp1 = reg2addr(AR_A, src1->size);
-
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, src1->size);
-			asm_inst_new(AOC_MOV, tmp1, dest, dest->size);
-
-			ADD_COMMENT(cmp, "MOV");
-			break;
-
-		//arithmetic
-    		case OC_ADD:
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			dest = addr2asmaddr(quad->dest);
-			size_tmp = MAX(src1->size, src2->size);
-			tmp1 = reg2addr(AR_A, size_tmp);
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, size_tmp);
-			asm_inst_new(AOC_ADD, src2, tmp1, size_tmp);
-			asm_inst_new(AOC_MOV, tmp1, dest, size_tmp);
-
-			ADD_COMMENT(cmp, "ADD");
-			break;
-
-		case OC_SUB:
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			dest = addr2asmaddr(quad->dest);
-			size_tmp = MAX(src1->size, src2->size);
-			tmp1 = reg2addr(AR_A, size_tmp);
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, size_tmp);
-			asm_inst_new(AOC_SUB, src2, tmp1, size_tmp);
-			asm_inst_new(AOC_MOV, tmp1, dest, size_tmp);
-
-			ADD_COMMENT(cmp, "SUB");
-			break;
-
-		case OC_MUL:
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			dest = addr2asmaddr(quad->dest);
-			size_tmp = MAX(src1->size, src2->size);
-			tmp1 = reg2addr(AR_A, size_tmp);
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, size_tmp);
-			asm_inst_new(AOC_MUL, src2, tmp1, size_tmp);
-			asm_inst_new(AOC_MOV, tmp1, dest, size_tmp);
-
-			ADD_COMMENT(cmp, "MUL");
-			break;
-
-		case OC_DIV:;
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			dest = addr2asmaddr(quad->dest);
-			size_tmp = MAX(src1->size, src2->size);
-			tmp1 = reg2addr(AR_A, size_tmp);
-			tmp2 = reg2addr(AR_D, size_tmp);
-			//push %rax
-			cmp = asm_inst_new(AOC_PUSH, tmp1, NULL, AS_Q);
-			//mov src1 to %rax
-			asm_inst_new(AOC_MOV, src1, tmp1, AS_Q);
-			//push %rdx
-			asm_inst_new(AOC_PUSH, tmp2, NULL, AS_Q);
-			//clear %rdx to all 0
-			asm_inst_new(AOC_XOR, tmp2, tmp2, tmp2->size);
-			//divide by divisor src2
-			asm_inst_new(AOC_DIV, src2, NULL, size_tmp);
-			//mov result from %eax
-			asm_inst_new(AOC_MOV, tmp1, dest, size_tmp);
-
-			ADD_COMMENT(cmp, "DIV");
-			break;
-			
-
-		case OC_MOD:;
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			dest = addr2asmaddr(quad->dest);
-			size_tmp = MAX(src1->size, src2->size);
-			tmp1 = reg2addr(AR_A, size_tmp);
-			tmp2 = reg2addr(AR_D, size_tmp);
-			//push %rax
-			cmp = asm_inst_new(AOC_PUSH, tmp1, NULL, AS_Q);
-			//mov src1 to %rax
-			asm_inst_new(AOC_MOV, src1, tmp1, AS_Q);
-			//push %rdx
-			asm_inst_new(AOC_PUSH, tmp2, NULL, AS_Q);
-			//clear %rdx to all 0
-			asm_inst_new(AOC_XOR, tmp2, tmp2, tmp2->size);
-			//divide by divisor src2
-			asm_inst_new(AOC_DIV, src2, NULL, size_tmp);
-			//mov result from %eax
-			asm_inst_new(AOC_MOV, tmp2, dest, size_tmp);
-
-			ADD_COMMENT(cmp, "MOD");
-			break;
-
-		
-
-		case OC_LEA:;
-			src1 = addr2asmaddr(quad->src1);
-			dest = addr2asmaddr(quad->dest);
-			tmp1 = reg2addr(AR_A, AS_Q);
-			cmp = asm_inst_new(AOC_LEA, src1, tmp1, AS_Q);
-			asm_inst_new(AOC_MOV, tmp1, dest, AS_Q);
-
-			ADD_COMMENT(cmp, "LEA");
-			break;
-		
-		case OC_LOAD:;
-			src1 = addr2asmaddr(quad->src1);			
-			dest = addr2asmaddr(quad->dest);
-
-			tmp1 = reg2addr(AR_A, src1->size);
-			tmp2 = reg2addr(AR_C, dest->size);
-			tmp3 = reg2addr(AR_A, src1->size);
-			tmp3->mode = AAM_INDIRECT;
-
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, src1->size);
-			asm_inst_new(AOC_MOV, dest, tmp2, dest->size);
-			asm_inst_new(AOC_MOV, tmp3, tmp2, dest->size);
-			asm_inst_new(AOC_MOV, tmp2, dest, dest->size);
-
-			ADD_COMMENT(cmp, "LOAD");
-			break;
-
-		case OC_STORE:;
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			tmp1 = reg2addr(AR_A, src1->size);
-			tmp2 = reg2addr(AR_C, src2->size);
-			tmp3 = reg2addr(AR_C, src2->size);
-			tmp3->mode = AAM_INDIRECT;
-
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, src1->size);
-			asm_inst_new(AOC_MOV, src2, tmp2, src2->size);
-			asm_inst_new(AOC_MOV, tmp1, tmp3, src1->size);
-
-			ADD_COMMENT(cmp, "STORE");
-			break;
-
-		case OC_CALL:;
-			// handle fncall arguments
-			// param_reg
-			struct addr *iter;
-			int param_count = 0;
-			_LL_FOR(quad->src2, iter, next) {
-				if (param_count == 6) {
-					yyerror("not supporting more than 6"
-						" arguments in fncall");
-					break;
-				}
-
-				src2 = addr2asmaddr(iter);
-				asm_inst_new(AOC_MOV, src2,
-					reg2addr(param_reg[param_count++],
-					src2->size), src2->size);
-			}
-
-			// clear eax register (for non-vector argument list)
-			asm_inst_new(AOC_XOR, reg2addr(AR_A, AS_L),
-				reg2addr(AR_A, AS_L), AS_L);
-
-			// emit call opcode
-			struct asm_addr *addr_label = calloc(1,
-				sizeof(struct asm_addr));
-			addr_label->mode = AAM_LABEL;
-			addr_label->size = AS_Q;
-			addr_label->value.label
-				= quad->src1->val.astnode->decl.ident;
-			asm_inst_new(AOC_CALL, addr_label, NULL, AS_NONE);
-			if (quad->dest){
-				dest = addr2asmaddr(quad->dest);
-				tmp1 = reg2addr(AR_A, dest->size);
-				asm_inst_new(AOC_MOV, tmp1, dest, dest->size);
-			}
-			break;
-
-		case OC_CMP:;
-			src1 = addr2asmaddr(quad->src1);
-			src2 = addr2asmaddr(quad->src2);
-			tmp1 = reg2addr(AR_A, src1->size);
-			asm_inst_new(AOC_MOV, src1, tmp1, src1->size);
-			asm_inst_new(AOC_CMP, src2, tmp1, src2->size);
-			break;
-			
-		case OC_SETCC:;
-			dest = addr2asmaddr(quad->dest);
-			enum asm_opcode oc;
-			switch((enum cc) *quad->src1->val.constval){
-				case CC_E:		oc = AOC_SETE; break;
-				case CC_NE: 		oc = AOC_SETNE; break;
-				case CC_L: 		oc = AOC_SETL; break;
-				case CC_LE:		oc = AOC_SETLE; break;
-				case CC_G: 		oc = AOC_SETG; break;
-				case CC_GE:		oc = AOC_SETGE; break;
-			}
-			asm_inst_new(oc, dest, NULL, AS_NONE);
-
-			break;
-
-		case OC_RET:;
-			src1 = addr2asmaddr(quad->src1);
-			struct asm_addr *reg_ret = reg2addr(AR_A, src1->size);
-			cmp = asm_inst_new(AOC_MOV, src1, reg_ret, src1->size);
-			asm_inst_new(AOC_LEAVE, NULL, NULL, AS_NONE);
-			asm_inst_new(AOC_RET, NULL, NULL, AS_NONE);
-			
-			ADD_COMMENT(cmp, "RETURN");
-			break;
-
-		case OC_CAST:
-			src1 = addr2asmaddr(quad->src1);
-			dest = addr2asmaddr(quad->dest);
-
-		implcast:
-			tmp1 = reg2addr(AR_A, src1->size);
-			tmp2 = reg2addr(AR_A, dest->size);
-
-			cmp = asm_inst_new(AOC_MOV, src1, tmp1, src1->size);
-
-			// reinterpret cast; input and output are the same
-			// size; noop
-
-			// cast 4 byte -> 8 byte
-			if (tmp1->size == AS_L && tmp2->size == AS_Q) {
-				asm_inst_new(AOC_CLTQ, NULL, NULL, AS_NONE);
-			}
-			
-			// cast 8 byte -> 4 byte
-			// noop
-			
-			asm_inst_new(AOC_MOV, tmp2, dest, dest->size);
-
-			ADD_COMMENT(cmp, "CAST");
-			break;
-
-		default:
-			yyerror("select_asm_inst: unhandled opcode");
-	}
-}
-
 /**
  * reverse order of asm_out
  * 
@@ -390,6 +136,63 @@ static void reverse_asm_components(void)
 	asm_out = b;
 }
 
+// generate the prologue and body of a function (in asm_out); frame_size is
+// the size of the function's stack frame
+static void gen_fn_code(union astnode *fndecl, struct basic_block *bb_ll,
+	int frame_size, int param_count)
+{
+	union astnode *var_iter;
+	union asm_component *bb_label;
+	struct basic_block *bb_iter;
+	struct asm_addr *asm_addr;
+	struct addr *addr;
+	unsigned i;
+
+	// FUNCTION PROLOGUE
+	asm_dir_new(APOC_TEXT);
+	asm_label_new(fndecl->decl.ident);
+	
+	asm_inst_new(AOC_PUSH, reg2addr(AR_BP, AS_Q), NULL, AS_Q);
+	asm_inst_new(AOC_MOV, reg2addr(AR_SP, AS_Q), reg2addr(AR_BP, AS_Q),
+		AS_Q);
+
+	// allocate space on the stack for all the local variables
+	// (this includes space for all of the temporary values)
+	addr = const_addr(create_size_t(), frame_size);
+	asm_inst_new(AOC_SUB, addr2asmaddr(addr), reg2addr(AR_SP, AS_Q),
+		AS_Q);
+
+	// copy all parameters into memory locations
+	if (param_count > 6) {
+		yyerror("not supporting more than 6 function parameters");
+	}
+	_LL_FOR(fndecl->decl.fn_scope->symbols_ll, var_iter, decl.symbol_next) {
+		if (!param_count) {
+			break;
+		}
+
+		if (var_iter->decl.is_proto) {
+			addr = var_addr(var_iter);
+			asm_addr = addr2asmaddr(addr);
+			asm_inst_new(AOC_MOV, reg2addr(param_reg[--param_count],
+				asm_addr->size), asm_addr, asm_addr->size);
+		}
+	}
+
+	// FUNCTION BODY
+	_LL_FOR(bb_ll, bb_iter, next) {
+		bb_label = asm_label_new(bb_iter->label);
+
+		for (i = 0; i < bb_iter->nquads; ++i) {
+			select_asm_inst(&bb_iter->quads[i]);
+		}
+
+		// reorder the block's instructions (but not the branches)
+		schedule_asm(bb_label, bb_iter->next_cond != NULL);
+		print_CC(bb_iter);
+	}
+}
+
 /**
  * general function layout
  * 
@@ -408,105 +211,94 @@ static void reverse_asm_components(void)
  * 	.globl fnname
  * 	.type fnname, @function
  */
-void generate_asm(union astnode *fndecl, struct basic_block *bb_ll)
+union asm_component *generate_asm(union astnode *fndecl,
+	struct basic_block *bb_ll)
 {
 	union astnode *var_iter;
 	union asm_component *component;
 	struct basic_block *bb_iter;
 	struct quad *quad_iter;
-	char *fnname = strdup(fndecl->decl.ident),
-		*tmp_fnname = malloc(strlen(fndecl->decl.ident) + 3);
-	int offset = 0, param_count = 0;
-	struct asm_addr *asm_addr;
-	struct addr *addr;
+	char *fnname = fndecl->decl.ident,
+		*tmp_fnname = arena_alloc(cur_arena, strlen(fnname) + 3);
+	int offset = 0, param_count = 0, default_size;
+	struct type_layout layout;
+	unsigned i;
 
 	// clear the current assembly
 	asm_out = NULL;
 
 	// GET FUNCTION LOCAL VARIABLES & PARAMETERS; assign offsets to
-	// all variables
+	// all variables (each aligned to its type's alignment)
 	_LL_FOR(fndecl->decl.fn_scope->symbols_ll, var_iter, decl.symbol_next) {
-		offset -= astnode_sizeof_symbol(var_iter);
+		layout = astnode_layout_type(var_iter->decl.components);
+		offset = -ALIGN_UP(-offset + (int) layout.size,
+			(int) layout.align);
 		var_iter->decl.offset = offset;
 
-		// debug output
-		if (var_iter->decl.is_proto) {
-			fprintf(dfp, "proto");
-			++param_count;
-		} else {
-			fprintf(dfp, "local");
+		param_count += var_iter->decl.is_proto;
+
+		if (DEBUGGING(DEBUG_FRAME)) {
+			fprintf(dfp, "%s var: %s (size: %d; offset: %d)\n",
+				var_iter->decl.is_proto ? "proto" : "local",
+				var_iter->decl.ident, layout.size,
+				var_iter->decl.offset);
 		}
-		fprintf(dfp, " var: %s (size: %d; offset: %d)\n",
-			var_iter->decl.ident,
-			astnode_sizeof_symbol(var_iter),
-			var_iter->decl.offset);
 	}
 
 	// ALSO TREAT ALL PSEUDO-REGISTERS LIKE LOCAL VARS (give them a memory
 	// address/offset on the stack)
 	
 	// helper for the following
+	// temporaries folded into their use by the instruction selector
+	// don't need a memory location
+	isel_analyze(bb_ll);
+
 	#define SET_ADDR_OF(addr)\
-		if (quad_iter->addr && !quad_iter->addr->offset\
-			&& quad_iter->addr->type == AT_TMP) {\
-			offset -= quad_iter->addr->size;\
-			quad_iter->addr->offset = offset;\
+		if (addr && !addr->offset && addr->type == AT_TMP\
+			&& !addr->fold) {\
+			offset = -ALIGN_UP(-offset + (int) addr->size,\
+				(int) astnode_alignof_type(addr->decl));\
+			addr->offset = offset;\
 			\
-			fprintf(dfp, "tmp %d (size: %d; offset: %d)\n",\
-				quad_iter->addr->val.tmpid,\
-				quad_iter->addr->size,\
-				quad_iter->addr->offset);\
+			if (DEBUGGING(DEBUG_FRAME)) {\
+				fprintf(dfp, "tmp %d (size: %d; offset: %d)\n",\
+					addr->val.tmpid, addr->size,\
+					addr->offset);\
+			}\
 		}
 
 	_LL_FOR(bb_ll, bb_iter, next) {
-		_LL_FOR(bb_iter->ll, quad_iter, next) {
-			SET_ADDR_OF(dest);
-			SET_ADDR_OF(src1);
-			SET_ADDR_OF(src2);
+		for (i = 0; i < bb_iter->nquads; ++i) {
+			quad_iter = &bb_iter->quads[i];
+			SET_ADDR_OF(QDEST(quad_iter));
+			SET_ADDR_OF(QSRC1(quad_iter));
+
+			// (src2 of a fncall is its argument list)
+			if (quad_iter->opcode != OC_CALL) {
+				SET_ADDR_OF(QSRC2(quad_iter));
+			}
 		}
 	}
 
-	// FUNCTION PROLOGUE
-	asm_dir_new(APOC_TEXT);
-	asm_label_new(fndecl->decl.ident);
-	
-	asm_inst_new(AOC_PUSH, reg2addr(AR_BP, AS_Q), NULL, AS_Q);
-	asm_inst_new(AOC_MOV, reg2addr(AR_SP, AS_Q), reg2addr(AR_BP, AS_Q),
-		AS_Q);
-
-	// allocate space on the stack for all the local variables
-	// (this includes space for all of the temporary values)
-	addr = addr_new(AT_CONST, create_size_t());
-	*((uint64_t*)addr->val.constval) = -offset;
-	asm_inst_new(AOC_SUB, addr2asmaddr(addr), reg2addr(AR_SP, AS_Q),
-		AS_Q);
-
-	// copy all parameters into memory locations
-	if (param_count > 6) {
-		yyerror("not supporting more than 6 function parameters");
-	}
-	_LL_FOR(fndecl->decl.fn_scope->symbols_ll, var_iter, decl.symbol_next) {
-		if (!param_count) {
-			break;
-		}
-
-		if (var_iter->decl.is_proto) {
-			addr = addr_new(AT_AST, var_iter->decl.components);
-			addr->val.astnode = var_iter;
-			asm_addr = addr2asmaddr(addr);
-			asm_inst_new(AOC_MOV, reg2addr(param_reg[--param_count],
-				asm_addr->size), asm_addr, asm_addr->size);
-		}
+	// in size-optimizing mode, also generate the code as in the default
+	// mode (and throw it away) to report the difference in code size
+	if (optimize_size && DEBUGGING(DEBUG_STATS)) {
+		optimize_size = 0;
+		gen_fn_code(fndecl, bb_ll, -offset, param_count);
+		default_size = asm_code_size(asm_out);
+		optimize_size = 1;
+		asm_out = NULL;
 	}
 
-	// FUNCTION BODY
-	_LL_FOR(bb_ll, bb_iter, next) {
-		asm_label_new(bb_name(bb_iter));
+	gen_fn_code(fndecl, bb_ll, -offset, param_count);
 
-		_LL_FOR(bb_iter->ll, quad_iter, next) {
-			select_asm_inst(quad_iter);
-		}
-		print_CC(bb_iter);
+	if (optimize_size) {
+		optimize_size_asm(fnname);
+	}
+	if (optimize_size && DEBUGGING(DEBUG_STATS)) {
+		fprintf(dfp, "size of %s: %d bytes (default mode: %d bytes;"
+			" %+d)\n", fnname, asm_code_size(asm_out),
+			default_size, asm_code_size(asm_out) - default_size);
 	}
 
 	// GENERATE EPILOGUE
@@ -525,9 +317,7 @@ void generate_asm(union astnode *fndecl, struct basic_block *bb_ll)
 
 	// reverse asm components
 	reverse_asm_components();
-
-	// print out the asm for this function
-	print_asm();
+	return asm_out;
 }
 
 
@@ -537,10 +327,10 @@ void print_CC(struct basic_block *bb){
 	enum asm_opcode oc;
 
 	if (bb->next_cond){
-		addr_label1 = calloc(1, sizeof(struct asm_addr));
+		addr_label1 = ARENA_NEW(struct asm_addr);
 		addr_label1->mode = AAM_LABEL;
 		addr_label1->size = AS_Q;	
-		addr_label1->value.label = bb_name(bb->next_cond);
+		addr_label1->value.label = bb->next_cond->label;
 		switch(bb->branch_cc){
 			case CC_E:	oc = AOC_JE; break;
 			case CC_NE:	oc = AOC_JNE; break;
@@ -553,37 +343,166 @@ void print_CC(struct basic_block *bb){
 	}
 
 	if (bb->next_def && bb->next_def->bb_no != bb->next->bb_no) {
-		addr_label2 = calloc(1, sizeof(struct asm_addr));
+		addr_label2 = ARENA_NEW(struct asm_addr);
 		addr_label2->mode = AAM_LABEL;
 		addr_label2->size = AS_Q;
-		addr_label2->value.label = bb_name(bb->next_def);
+		addr_label2->value.label = bb->next_def->label;
 		asm_inst_new(AOC_JMP, addr_label2, NULL, AS_NONE);
 	}
 }
 
 
-// print comment of asm_component, if applicable
-void print_comment(char *comment) {
+/**
+ * OUTPUT BUFFER
+ *
+ * The assembly is formatted by hand (without stdio) into a large buffer that
+ * is written to the output file with write() whenever it fills up, and at the
+ * end of the file (see asm_flush()).
+ */
+
+// the buffer of the current context (see context.h)
+#define out_buf		(cur_ctx->out_buf)
+#define out_len		(cur_ctx->out_len)
+
+void asm_flush(void)
+{
+	size_t pos = 0;
+	ssize_t written;
+
+	while (pos < out_len) {
+		if ((written = write(fileno(cur_ctx->ofp), out_buf + pos,
+			out_len - pos)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			yyerror_fatal("could not write assembly output");
+		}
+		pos += written;
+	}
+	out_len = 0;
+}
+
+// make room for n more bytes in the buffer (n <= OUT_BUF_SIZE)
+static char *out_reserve(size_t n)
+{
+	if (out_len + n > OUT_BUF_SIZE) {
+		asm_flush();
+	}
+	return out_buf + out_len;
+}
+
+static void out_char(char c)
+{
+	*out_reserve(1) = c;
+	++out_len;
+}
+
+void out_write(const void *buf, size_t len)
+{
+	const char *str = buf;
+
+	// data that doesn't fit into the buffer (e.g., long string literals
+	// or object file sections) is copied in pieces
+	while (len > OUT_BUF_SIZE) {
+		out_write(str, OUT_BUF_SIZE);
+		str += OUT_BUF_SIZE;
+		len -= OUT_BUF_SIZE;
+	}
+
+	memcpy(out_reserve(len), str, len);
+	out_len += len;
+}
 
+static void out_str(const char *str)
+{
+	out_write(str, strlen(str));
+}
+
+static void out_uint(uint64_t val)
+{
+	char buf[20], *c = buf + sizeof(buf);
+
+	do {
+		*--c = '0' + val % 10;
+	} while (val /= 10);
+
+	out_write(c, buf + sizeof(buf) - c);
+}
+
+static void out_int(int64_t val)
+{
+	if (val < 0) {
+		out_char('-');
+		out_uint(-(uint64_t) val);
+	} else {
+		out_uint(val);
+	}
+}
+
+// print comment of asm_component, if applicable
+static void print_comment(char *comment)
+{
 	if (!comment) {
 		return;
 	}
 
-	fprintf(ofp, "\t\t#%s", comment);
+	out_write("\t\t#", 3);
+	out_str(comment);
 }
 
-// TODO: remove this predeclaration
-void print_asm_dir(struct asm_dir *dir);
+// register names by register and size (AS_B through AS_Q)
+static const char *const reg_names[][4] = {
+	[AR_A]	= { "%al", "%ax", "%eax", "%rax" },
+	[AR_B]	= { "%bl", "%bx", "%ebx", "%rbx" },
+	[AR_C]	= { "%cl", "%cx", "%ecx", "%rcx" },
+	[AR_D]	= { "%dl", "%dx", "%edx", "%rdx" },
+	[AR_DI]	= { "%dil", "%di", "%edi", "%rdi" },
+	[AR_SI]	= { "%sil", "%si", "%esi", "%rsi" },
+	[AR_BP]	= { "%bpl", "%bp", "%ebp", "%rbp" },
+	[AR_SP]	= { "%spl", "%sp", "%esp", "%rsp" },
+	[AR_8]	= { "%r8b", "%r8w", "%r8d", "%r8" },
+	[AR_9]	= { "%r9b", "%r9w", "%r9d", "%r9" },
+	[AR_10]	= { "%r10b", "%r10w", "%r10d", "%r10" },
+	[AR_11]	= { "%r11b", "%r11w", "%r11d", "%r11" },
+	[AR_12]	= { "%r12b", "%r12w", "%r12d", "%r12" },
+	[AR_13]	= { "%r13b", "%r13w", "%r13d", "%r13" },
+	[AR_14]	= { "%r14b", "%r14w", "%r14d", "%r14" },
+	[AR_15]	= { "%r15b", "%r15w", "%r15d", "%r15" },
+};
+
+// print a register name, e.g., %rax, %eax, %ax, %al, %r8d
+static void print_asm_reg(enum asm_reg_name name, enum asm_size size)
+{
+	if (size == AS_NONE) {
+		yyerror_fatal("must specify register size");
+		return;
+	}
+
+	out_str(reg_names[name][size - AS_B]);
+}
+
+char *asm_sym_name(union astnode *decl)
+{
+	return !decl->decl.is_string
+		&& decl->decl.declspec->declspec.sc->sc.scspec == SC_STATIC
+		? decl->decl.static_uid
+		: decl->decl.ident;
+}
 
-void print_asm_addr(struct asm_addr *addr)
+// print an %rbp-relative memory operand, e.g., -4(%rbp)
+static void print_frame_offset(int offset)
+{
+	out_int(offset);
+	out_write("(%rbp)", 6);
+}
+
+static void print_asm_addr(struct asm_addr *addr)
 {
 	struct asm_reg *reg;
-	char *r1, *r2, *r3;
+	struct asm_mem *mem;
 	unsigned char *const_val;
-	union asm_component *dir;
 	struct addr *quad_addr;
 	union astnode *decl, *sc;
-	int offset;
 
 	switch (addr->mode) {
 	case AAM_INDIRECT:
@@ -591,62 +510,13 @@ void print_asm_addr(struct asm_addr *addr)
 		reg = &addr->value.reg;
 
 		if (addr->mode == AAM_INDIRECT) {
-			fprintf(ofp, "(");
+			out_char('(');
 		}
 
-		r1 = r3 = "";
-
-		switch (reg->name) {
-		case AR_A:	r2 = "a"; break;
-		case AR_B:	r2 = "b"; break;
-		case AR_C:	r2 = "c"; break;
-		case AR_D:	r2 = "d"; break;
-		case AR_DI:	r2 = "di"; break;
-		case AR_SI:	r2 = "si"; break;
-		case AR_BP:	r2 = "bp"; break;
-		case AR_SP:	r2 = "sp"; break;
-		case AR_8:	r2 = "8"; break;
-		case AR_9:	r2 = "9"; break;
-		case AR_10:	r2 = "10"; break;
-		case AR_11:	r2 = "11"; break;
-		case AR_12:	r2 = "12"; break;
-		case AR_13:	r2 = "13"; break;
-		case AR_14:	r2 = "14"; break;
-		case AR_15:	r2 = "15"; break;
-		}
-
-		// old registers, e.g., rax, eax, ax, al
-		if (reg->name < AR_8) {
-			switch (reg->size) {
-			case AS_B:	r3 = "l"; break;
-			case AS_W:	break;
-			case AS_L:	r1 = "e"; break;
-			case AS_Q:	r1 = "r"; break;
-			case AS_NONE:
-				yyerror_fatal("must specify register size");
-			}
-			if (reg->name < AR_DI && reg->size != AS_B) {
-				r3 = "x";
-			}
-			
-		}
-		// new registers, e.g., r8, r8b, r8w, r8d
-		else {
-			r1 = "r";
-			switch (reg->size) {
-			case AS_B:	r3 = "b"; break;
-			case AS_W:	r3 = "w"; break;
-			case AS_L:	r3 = "d"; break;
-			case AS_Q:	break;
-			case AS_NONE:
-				yyerror_fatal("must specify register size");
-			}
-		}
-
-		fprintf(ofp, "%%%s%s%s", r1, r2, r3);
+		print_asm_reg(reg->name, reg->size);
 
 		if (addr->mode == AAM_INDIRECT) {
-			fprintf(ofp, ")");
+			out_char(')');
 		}
 
 		break;
@@ -655,7 +525,7 @@ void print_asm_addr(struct asm_addr *addr)
 		quad_addr = addr->value.addr;
 
 		if (quad_addr->type == AT_TMP) {
-			fprintf(ofp, "%d(%%rbp)", quad_addr->offset);
+			print_frame_offset(quad_addr->offset);
 			break;
 		}
 
@@ -670,33 +540,60 @@ void print_asm_addr(struct asm_addr *addr)
 		if (!decl->decl.is_string
 			&& sc->sc.scspec != SC_EXTERN
 			&& sc->sc.scspec != SC_STATIC) {
-			fprintf(ofp, "%d(%%rbp)", decl->decl.offset);
+			print_frame_offset(decl->decl.offset);
 		}
 
 		// if global (extern or static) variable:
 		// use rip-relative addressing
 		// MOVL	$2, i(%rip)
 		else {
-			fprintf(ofp, "%s(%%rip)",
-				!decl->decl.is_string
-					&& sc->sc.scspec == SC_STATIC
-				? decl->decl.static_uid
-				: decl->decl.ident);
+			out_str(asm_sym_name(decl));
+			out_write("(%rip)", 6);
 		}
 		break;
 
 	case AAM_LABEL:
-		//NYI("printing label mode asm addr")
-		fprintf(ofp, "%s", addr->value.label);
+		out_str(addr->value.label);
 		break;
 
 	case AAM_REG_OFF:
-		NYI("printing register-offset mode asm addr");
+		mem = &addr->value.mem;
+
+		// rip-relative symbol (with optional offset)
+		// MOVL	$2, a+8(%rip)
+		if (mem->sym) {
+			out_str(asm_sym_name(mem->sym->val.astnode));
+			if (mem->disp > 0) {
+				out_char('+');
+			}
+			if (mem->disp) {
+				out_int(mem->disp);
+			}
+			out_write("(%rip)", 6);
+			break;
+		}
+
+		// MOVL	$2, -48(%rbp,%rcx,4)
+		if (mem->disp) {
+			out_int(mem->disp);
+		}
+		out_char('(');
+		if (mem->has_base) {
+			print_asm_reg(mem->base, AS_Q);
+		}
+		if (mem->has_index) {
+			out_char(',');
+			print_asm_reg(mem->index, AS_Q);
+			out_char(',');
+			out_int(mem->scale);
+		}
+		out_char(')');
 		break;
 
 	case AAM_IMMEDIATE:
 		const_val = addr->value.addr->val.constval;
-		fprintf(ofp, "$%llu", *((uint64_t*)const_val));
+		out_char('$');
+		out_uint(*((uint64_t*)const_val));
 		break;
 
 	default:
@@ -704,67 +601,66 @@ void print_asm_addr(struct asm_addr *addr)
 	}
 }
 
-void print_asm_inst(struct asm_inst *inst)
+// AT&T instruction size suffix
+static char *size_suffix(enum asm_size size)
 {
-	char *inst_text, *size_text;
-
-	switch (inst->oc) {
-	case AOC_PUSH:	inst_text = "push"; break;
-	case AOC_POP:	inst_text = "pop"; break;
-	case AOC_MOV:	inst_text = "mov"; break;
-	case AOC_LEAVE:	inst_text = "leave"; break;
-	case AOC_ADD:	inst_text = "add"; break;
-	case AOC_SUB:	inst_text = "sub"; break;
-	case AOC_MUL:	inst_text = "imul"; break;
-	case AOC_DIV:	inst_text = "idiv"; break;
-	case AOC_CALL:	inst_text = "call"; break;
-	case AOC_RET:	inst_text = "ret"; break;
-	case AOC_CMP:	inst_text = "cmp"; break;
-	case AOC_JMP:	inst_text = "jmp"; break;
-	case AOC_JE:	inst_text = "je"; break;
-	case AOC_JNE:	inst_text = "jne"; break;
-	case AOC_JL:	inst_text = "jl"; break;
-	case AOC_JLE:	inst_text = "jle"; break;
-	case AOC_JG:	inst_text = "jg"; break;
-	case AOC_JGE:	inst_text = "jge"; break;
-	case AOC_XOR:	inst_text = "xor"; break;
-	case AOC_LEA:	inst_text = "lea"; break;
-	case AOC_SETE:	inst_text = "sete"; break;
-	case AOC_SETNE:	inst_text = "setne"; break;
-	case AOC_SETL:	inst_text = "setl"; break;
-	case AOC_SETLE:	inst_text = "setle"; break;
-	case AOC_SETG:	inst_text = "setg"; break;
-	case AOC_SETGE:	inst_text = "setge"; break;
-	case AOC_CLTQ:	inst_text = "cltq"; break;
-	}
-
-	switch (inst->size) {
-	case AS_NONE:	size_text = ""; break;
-	case AS_B:	size_text = "b"; break;
-	case AS_W:	size_text = "w"; break;
-	case AS_L:	size_text = "l"; break;
-	case AS_Q:	size_text = "q"; break;
+	switch (size) {
+	case AS_NONE:	return "";
+	case AS_B:	return "b";
+	case AS_W:	return "w";
+	case AS_L:	return "l";
+	case AS_Q:	return "q";
 	default:
 		yyerror_fatal("unknown asm instruction size");
+		return "";
 	}
+}
 
-	fprintf(ofp, "\t%s%s", inst_text, size_text);
+// instruction mnemonics (without size suffix)
+static const char *const inst_names[] = {
+	[AOC_PUSH] = "push",	[AOC_POP] = "pop",	[AOC_MOV] = "mov",
+	[AOC_LEAVE] = "leave",	[AOC_ADD] = "add",	[AOC_SUB] = "sub",
+	[AOC_MUL] = "imul",	[AOC_DIV] = "idiv",	[AOC_CALL] = "call",
+	[AOC_RET] = "ret",	[AOC_CMP] = "cmp",	[AOC_JMP] = "jmp",
+	[AOC_JE] = "je",	[AOC_JNE] = "jne",	[AOC_JL] = "jl",
+	[AOC_JLE] = "jle",	[AOC_JG] = "jg",	[AOC_JGE] = "jge",
+	[AOC_XOR] = "xor",	[AOC_LEA] = "lea",	[AOC_SETE] = "sete",
+	[AOC_SETNE] = "setne",	[AOC_SETL] = "setl",	[AOC_SETLE] = "setle",
+	[AOC_SETG] = "setg",	[AOC_SETGE] = "setge",	[AOC_CLTQ] = "cltq",
+	[AOC_CLTD] = "cltd",	[AOC_CQTO] = "cqto",	[AOC_INC] = "inc",
+	[AOC_DEC] = "dec",
+};
+
+static void print_asm_inst(struct asm_inst *inst)
+{
+	out_char('\t');
+
+	// sign/zero-extending mov: suffix is from the operand sizes, e.g.,
+	// movslq, movzbl
+	if (inst->oc == AOC_MOVS || inst->oc == AOC_MOVZ) {
+		out_write(inst->oc == AOC_MOVS ? "movs" : "movz", 4);
+		out_str(size_suffix(inst->src->size));
+		out_str(size_suffix(inst->dest->size));
+	} else {
+		out_str(inst_names[inst->oc]);
+		out_str(size_suffix(inst->size));
+	}
 
 	if (inst->src) {
-		fprintf(ofp, "\t");
+		out_char('\t');
 		print_asm_addr(inst->src);
 
 		if (inst->dest) {
-			fprintf(ofp, ", ");
+			out_write(", ", 2);
 			print_asm_addr(inst->dest);
 		}
 	}
 
 	print_comment(inst->comment);
-	fprintf(ofp, "\n");
+	out_char('\n');
 }
 
-void print_asm_dir(struct asm_dir *dir)
+static void print_asm_dir(struct asm_dir *dir)
 {
 	char *dir_text;
 
@@ -782,37 +678,47 @@ void print_asm_dir(struct asm_dir *dir)
 		yyerror_fatal("unknown asm directive");
 	}
 
-	fprintf(ofp, "\t.%s", dir_text);
+	out_write("\t.", 2);
+	out_str(dir_text);
 
 	// print arguments if they exist
 	if (dir->param1) {
-		fprintf(ofp, " %s", dir->param1);
+		out_char(' ');
+		out_str(dir->param1);
 
 		if (dir->param2) {
-			fprintf(ofp, ", %s", dir->param2);
+			out_write(", ", 2);
+			out_str(dir->param2);
 
 			if (dir->param3) {
-				fprintf(ofp, ", %s", dir->param3);
+				out_write(", ", 2);
+				out_str(dir->param3);
 			}
 		}
 	}
 
 	print_comment(dir->comment);
-	fprintf(ofp, "\n");
+	out_char('\n');
 }
 
-void print_asm_label(struct asm_label *label)
+static void print_asm_label(struct asm_label *label)
 {
-	fprintf(ofp, "%s:", label->name);
+	out_str(label->name);
+	out_char(':');
 	print_comment(label->comment);
-	fprintf(ofp, "\n");
+	out_char('\n');
 }
 
-void print_asm()
+void print_asm(union asm_component *code)
 {
 	union asm_component *iter;
 
-	LL_FOR(asm_out, iter) {
+	if (emit_object || cur_ctx->jit) {
+		obj_emit(code);
+		return;
+	}
+
+	LL_FOR(code, iter) {
 		switch (iter->generic.type) {
 		case ACT_INST:
 			print_asm_inst(&iter->inst);
@@ -826,6 +732,48 @@ void print_asm()
 		}
 	}
 }
+// whether a string literal can be placed in a mergeable string section, i.e.,
+// it is a narrow string whose only null character is the terminating one
+static int string_mergeable(struct string *str)
+{
+	return str->width == CW_NONE && !memchr(str->buf, 0, str->length);
+}
+
+// emit the string literals that are (not) mergeable; returns the number of
+// strings emitted
+static unsigned gen_string_asm(int mergeable)
+{
+	union astnode *iter;
+	union asm_component *dir;
+	unsigned count = 0, len;
+	char *str, *quoted;
+
+	_LL_FOR(cur_ctx->string_ll, iter, string.symbol_next) {
+		if (string_mergeable(&iter->string.string) != mergeable) {
+			continue;
+		}
+
+		dir = asm_dir_new(APOC_STRING);
+		dir->dir.string = &iter->string.string;
+		asm_label_new(iter->string.label);
+		++count;
+
+		// object output uses the string itself
+		if (emit_object || cur_ctx->jit) {
+			continue;
+		}
+
+		str = print_string(&iter->string.string);
+		len = strlen(str);
+		quoted = arena_alloc(cur_arena, len + 3);
+		quoted[0] = '"';
+		memcpy(quoted + 1, str, len);
+		quoted[len + 1] = '"';
+		free(str);
+		dir->dir.param1 = quoted;
+	}
+	return count;
+}
 
 void gen_globalvar_asm(union astnode *globals)
 {
@@ -855,24 +803,34 @@ void gen_globalvar_asm(union astnode *globals)
 			dir2 = asm_dir_new(APOC_GLOBL);
 			dir2->dir.param1 = iter->decl.ident;
 		}
-		dir->dir.param2 = strdup(size_buf);
+		dir->dir.param2 = arena_strdup(cur_arena, size_buf);
 
-		fprintf(dfp, "Got global variable: %s\n", iter->decl.static_uid
-			? iter->decl.static_uid : iter->decl.ident);
+		if (DEBUGGING(DEBUG_FRAME)) {
+			fprintf(dfp, "Got global variable: %s\n",
+				iter->decl.static_uid ? iter->decl.static_uid
+				: iter->decl.ident);
+		}
 	}
 
-	_LL_FOR(string_ll, iter, decl.symbol_next) {
-		dir = asm_dir_new(APOC_STRING);
-
-		char *str = malloc(4096);
-		sprintf(str, "\"%s\"", print_string(&iter->string.string));
-		dir->dir.param1 = str;
-
-		asm_label_new(iter->string.label);
+	// narrow strings without embedded null characters go into a mergeable
+	// string section, so that the linker can also merge identical strings
+	// across object files; the rest go into .rodata (asm_out is built in
+	// reverse, so each group is emitted before its section directive)
+	if (gen_string_asm(1)) {
+		dir = asm_dir_new(APOC_SECTION);
+		dir->dir.param1 = ".rodata.str1.1,\"aMS\",@progbits,1";
+	}
+	if (gen_string_asm(0)) {
+		dir = asm_dir_new(APOC_SECTION);
+		dir->dir.param1 = ".rodata";
 	}
 
-	dir = asm_dir_new(APOC_SECTION);
-	dir->dir.param1 = ".rodata";
+	print_asm(asm_out);
 
-	print_asm();
+	// this is the end of the output (in JIT mode, the object is loaded
+	// instead, see jit_load())
+	if (emit_object && !cur_ctx->jit) {
+		obj_write();
+	}
+	asm_flush();
 }
\ No newline at end of file
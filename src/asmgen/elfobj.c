@@ -0,0 +1,605 @@
+#include <asmgen/elfobj.h>
+#include <asmgen/encode.h>
+#include <intern.h>
+#include <context.h>
+#include <elf.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char *section_names[OS_COUNT] = {
+	[OS_TEXT] = ".text",
+	[OS_DATA] = ".data",
+	[OS_BSS] = ".bss",
+	[OS_RODATA] = ".rodata",
+	[OS_RODATA_STR] = ".rodata.str1.1",
+	[OS_NOTE] = ".note.GNU-stack",
+	[OS_RELA_TEXT] = ".rela.text",
+	[OS_SYMTAB] = ".symtab",
+	[OS_STRTAB] = ".strtab",
+	[OS_SHSTRTAB] = ".shstrtab",
+};
+
+void obj_free(struct obj_file *obj)
+{
+	unsigned i;
+
+	for (i = 0; i < OS_COUNT; ++i) {
+		free(obj->sections[i].data);
+	}
+	free(obj->syms);
+	free(obj->sym_tab);
+	free(obj->relocs);
+}
+
+// the object file of the current context (see context.h)
+#define sections	(cur_ctx->obj.sections)
+#define bss_size	(cur_ctx->obj.bss_size)
+#define bss_align	(cur_ctx->obj.bss_align)
+#define syms		(cur_ctx->obj.syms)
+#define nsyms		(cur_ctx->obj.nsyms)
+#define syms_cap	(cur_ctx->obj.syms_cap)
+#define sym_tab		(cur_ctx->obj.sym_tab)
+#define sym_tab_cap	(cur_ctx->obj.sym_tab_cap)
+#define relocs		(cur_ctx->obj.relocs)
+#define nrelocs		(cur_ctx->obj.nrelocs)
+#define relocs_cap	(cur_ctx->obj.relocs_cap)
+
+static void *grow(void *arr, unsigned *cap, unsigned count, size_t size)
+{
+	if (count < *cap) {
+		return arr;
+	}
+	*cap = *cap ? *cap * 2 : 64;
+	return realloc(arr, *cap * size);
+}
+
+static void buf_append(struct obj_buf *buf, const void *data, size_t len)
+{
+	if (buf->len + len > buf->cap) {
+		buf->cap = MAX(buf->cap * 2, buf->len + len);
+		buf->data = realloc(buf->data, buf->cap);
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static void sym_tab_rehash(void)
+{
+	unsigned *old = sym_tab, old_cap = sym_tab_cap, i, j;
+
+	sym_tab_cap = old_cap ? old_cap * 2 : 256;
+	sym_tab = calloc(sym_tab_cap, sizeof(unsigned));
+
+	for (i = 0; i < old_cap; ++i) {
+		if (!old[i]) {
+			continue;
+		}
+		for (j = INTERN_HASH(syms[old[i] - 1].name) & (sym_tab_cap - 1);
+			sym_tab[j]; j = (j + 1) & (sym_tab_cap - 1));
+		sym_tab[j] = old[i];
+	}
+	free(old);
+}
+
+// returns the index of the symbol with the given (interned) name, creating
+// it if it doesn't exist
+static unsigned obj_sym_get(char *name)
+{
+	unsigned i, mask;
+
+	if (2 * (nsyms + 1) > sym_tab_cap) {
+		sym_tab_rehash();
+	}
+
+	mask = sym_tab_cap - 1;
+	for (i = INTERN_HASH(name) & mask; sym_tab[i]; i = (i + 1) & mask) {
+		if (syms[sym_tab[i] - 1].name == name) {
+			return sym_tab[i] - 1;
+		}
+	}
+
+	syms = grow(syms, &syms_cap, nsyms, sizeof(struct obj_sym));
+	memset(&syms[nsyms], 0, sizeof(struct obj_sym));
+	syms[nsyms].name = name;
+	sym_tab[i] = nsyms + 1;
+	return nsyms++;
+}
+
+struct obj_sym *obj_sym_lookup(char *name)
+{
+	unsigned i, mask = sym_tab_cap - 1;
+
+	if (!sym_tab) {
+		return NULL;
+	}
+	for (i = INTERN_HASH(name) & mask; sym_tab[i]; i = (i + 1) & mask) {
+		if (syms[sym_tab[i] - 1].name == name) {
+			return &syms[sym_tab[i] - 1];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * LABELS
+ *
+ * The labels of a list of components, by name pointer (basic block labels
+ * aren't interned, but all references to them share the same string).
+ */
+
+static _Thread_local union asm_component **labels;
+static _Thread_local unsigned labels_cap;
+
+static unsigned label_hash(char *name)
+{
+	uintptr_t hash = (uintptr_t) name >> 3;
+
+	return hash ^ hash >> 15;
+}
+
+static void labels_init(union asm_component *code)
+{
+	union asm_component *iter;
+	unsigned count = 0, i;
+
+	LL_FOR(code, iter) {
+		count += iter->generic.type == ACT_LABEL;
+	}
+
+	for (labels_cap = 16; labels_cap < 2 * count; labels_cap *= 2);
+	labels = arena_alloc(cur_arena,
+		labels_cap * sizeof(union asm_component *));
+
+	LL_FOR(code, iter) {
+		if (iter->generic.type != ACT_LABEL) {
+			continue;
+		}
+		for (i = label_hash(iter->label.name) & (labels_cap - 1);
+			labels[i]; i = (i + 1) & (labels_cap - 1));
+		labels[i] = iter;
+	}
+}
+
+static struct asm_label *label_lookup(char *name)
+{
+	unsigned i;
+
+	for (i = label_hash(name) & (labels_cap - 1); labels[i];
+		i = (i + 1) & (labels_cap - 1)) {
+		if (labels[i]->label.name == name) {
+			return &labels[i]->label;
+		}
+	}
+	return NULL;
+}
+
+// define the symbol for a label of this list of components, if there is one
+static unsigned obj_sym_define(char *name)
+{
+	unsigned sym = obj_sym_get(name);
+	struct asm_label *label;
+
+	if (!syms[sym].section && (label = label_lookup(name))) {
+		syms[sym].section = label->section;
+		syms[sym].value = label->offset;
+	}
+	return sym;
+}
+
+/**
+ * EMISSION
+ */
+
+static enum obj_section section_of(struct asm_dir *dir)
+{
+	if (dir->poc == APOC_TEXT) {
+		return OS_TEXT;
+	}
+	if (dir->poc == APOC_BSS) {
+		return OS_BSS;
+	}
+	if (!strncmp(dir->param1, ".rodata.str", 11)) {
+		return OS_RODATA_STR;
+	}
+	if (!strncmp(dir->param1, ".rodata", 7)) {
+		return OS_RODATA;
+	}
+	if (!strncmp(dir->param1, ".data", 5)) {
+		return OS_DATA;
+	}
+	yyerror_fatal("elfobj: unknown section");
+	return OS_NULL;
+}
+
+static int is_branch(struct asm_inst *inst)
+{
+	switch (inst->oc) {
+	case AOC_JMP: case AOC_JE: case AOC_JNE:
+	case AOC_JL: case AOC_JLE: case AOC_JG: case AOC_JGE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// displacement of a branch at the given offset in .text (relative to the
+// end of the instruction)
+static int64_t branch_disp(struct asm_inst *inst, unsigned offset,
+	unsigned len)
+{
+	struct asm_label *label;
+
+	if (!(label = label_lookup(inst->src->value.label))) {
+		yyerror_fatal("elfobj: branch to unknown label");
+	}
+	return (int64_t) label->offset - (offset + len);
+}
+
+/**
+ * assign offsets to the labels and instructions of code; returns whether
+ * any branch had to be lengthened (in which case the offsets are stale)
+ *
+ * @param code		components
+ * @param lens		length of each instruction
+ * @param long_branch	whether each branch uses a 32-bit displacement
+ */
+static int obj_layout(union asm_component *code, unsigned char *lens,
+	unsigned char *long_branch)
+{
+	union asm_component *iter;
+	enum obj_section sec = OS_TEXT;
+	size_t offsets[OS_COUNT], offset;
+	unsigned i;
+	int64_t disp;
+	int changed = 0;
+
+	for (i = 0; i < OS_COUNT; ++i) {
+		offsets[i] = sections[i].len;
+	}
+
+	// assign offsets
+	i = 0;
+	LL_FOR(code, iter) {
+		switch (iter->generic.type) {
+		case ACT_LABEL:
+			iter->label.section = sec;
+			iter->label.offset = offsets[sec];
+			break;
+		case ACT_INST:
+			offsets[sec] += lens[i];
+			break;
+		case ACT_DIR:
+			if (iter->dir.poc == APOC_TEXT
+				|| iter->dir.poc == APOC_BSS
+				|| iter->dir.poc == APOC_SECTION) {
+				sec = section_of(&iter->dir);
+			} else if (iter->dir.poc == APOC_STRING) {
+				offsets[sec] += iter->dir.string->length + 1;
+			}
+			break;
+		}
+		++i;
+	}
+
+	// lengthen the branches whose targets are out of range of a short
+	// branch (instructions are only in .text); this only makes other
+	// displacements larger, so it converges
+	i = 0;
+	offset = sections[OS_TEXT].len;
+	LL_FOR(code, iter) {
+		if (iter->generic.type == ACT_INST) {
+			if (is_branch(&iter->inst) && !long_branch[i]) {
+				disp = branch_disp(&iter->inst, offset,
+					lens[i]);
+				if (disp < INT8_MIN || disp > INT8_MAX) {
+					long_branch[i] = 1;
+					lens[i] = iter->inst.oc == AOC_JMP
+						? 5 : 6;
+					changed = 1;
+				}
+			}
+			offset += lens[i];
+		}
+		++i;
+	}
+
+	return changed;
+}
+
+void obj_emit(union asm_component *code)
+{
+	union asm_component *iter;
+	unsigned char *lens, *long_branch, inst_buf[ASM_INST_MAX_LEN];
+	struct asm_fixup fixup;
+	struct asm_dir *dir;
+	enum obj_section sec = OS_TEXT;
+	unsigned count = 0, i, len, sym;
+	int64_t disp;
+	size_t offset;
+
+	LL_FOR(code, iter) {
+		++count;
+	}
+	lens = arena_alloc(cur_arena, count);
+	long_branch = arena_alloc(cur_arena, count);
+
+	// start with all branches short
+	i = 0;
+	LL_FOR(code, iter) {
+		if (iter->generic.type == ACT_INST) {
+			lens[i] = asm_inst_length(&iter->inst);
+		}
+		++i;
+	}
+
+	labels_init(code);
+	while (obj_layout(code, lens, long_branch));
+
+	i = 0;
+	LL_FOR(code, iter) {
+		switch (iter->generic.type) {
+		case ACT_LABEL:
+			// labels outside of .text are string literals;
+			// function labels are defined by their directives
+			if (sec != OS_TEXT) {
+				obj_sym_define(iter->label.name);
+			}
+			break;
+
+		case ACT_INST:
+			offset = sections[sec].len;
+			len = asm_inst_encode(&iter->inst, !long_branch[i],
+				inst_buf, &fixup);
+
+			if (fixup.kind == AFK_BRANCH) {
+				disp = branch_disp(&iter->inst, offset, len);
+				memcpy(inst_buf + fixup.offset, &disp,
+					fixup.size);
+			} else if (fixup.kind != AFK_NONE) {
+				relocs = grow(relocs, &relocs_cap, nrelocs,
+					sizeof(struct obj_reloc));
+				relocs[nrelocs++] = (struct obj_reloc) {
+					offset + fixup.offset,
+					obj_sym_get(fixup.label),
+					fixup.kind == AFK_PLT32
+						? R_X86_64_PLT32
+						: R_X86_64_PC32,
+					fixup.addend
+				};
+			}
+
+			buf_append(&sections[sec], inst_buf, len);
+			break;
+
+		case ACT_DIR:
+			dir = &iter->dir;
+			switch (dir->poc) {
+			case APOC_TEXT:
+			case APOC_BSS:
+			case APOC_SECTION:
+				sec = section_of(dir);
+				break;
+
+			case APOC_STRING:
+				buf_append(&sections[sec], dir->string->buf,
+					dir->string->length);
+				buf_append(&sections[sec], "", 1);
+				break;
+
+			case APOC_GLOBL:
+				syms[obj_sym_define(dir->param1)].global = 1;
+				break;
+
+			case APOC_LOCAL:
+				syms[obj_sym_define(dir->param1)].local = 1;
+				break;
+
+			case APOC_COMM:
+				sym = obj_sym_get(dir->param1);
+				syms[sym].common = 1;
+				syms[sym].size = strtoull(dir->param2, NULL, 10);
+				break;
+
+			case APOC_TYPE:
+				sym = obj_sym_define(dir->param1);
+				syms[sym].func = !strcmp(dir->param2,
+					"@function");
+				break;
+
+			// (the size is always .-sym)
+			case APOC_SIZE:
+				sym = obj_sym_define(dir->param1);
+				syms[sym].size = sections[syms[sym].section].len
+					- syms[sym].value;
+				break;
+			}
+			break;
+		}
+		++i;
+	}
+}
+
+/**
+ * OUTPUT
+ */
+
+// alignment of a .comm variable without an explicit alignment (as chosen by
+// the assembler): its size rounded up to a power of two, up to 16 bytes
+static uint64_t comm_align(uint64_t size)
+{
+	uint64_t align = 1;
+
+	while (align < size && align < 16) {
+		align *= 2;
+	}
+	return align;
+}
+
+void obj_alloc_commons(int all)
+{
+	struct obj_sym *sym;
+	unsigned i;
+
+	for (i = 0; i < nsyms; ++i) {
+		sym = &syms[i];
+		if (!sym->common || sym->section) {
+			continue;
+		}
+		if (all || sym->local) {
+			bss_align = MAX(bss_align, comm_align(sym->size));
+			bss_size = ALIGN_UP(bss_size, comm_align(sym->size));
+			sym->section = OS_BSS;
+			sym->value = bss_size;
+			bss_size += sym->size;
+		} else {
+			sym->global = 1;
+		}
+	}
+}
+
+static unsigned strtab_add(struct obj_buf *strtab, const char *str)
+{
+	unsigned offset = strtab->len;
+
+	buf_append(strtab, str, strlen(str) + 1);
+	return offset;
+}
+
+static void write_padding(size_t *pos, size_t align)
+{
+	static const char zeros[16];
+	size_t pad = ALIGN_UP(*pos, align) - *pos;
+
+	out_write(zeros, pad);
+	*pos += pad;
+}
+
+void obj_write(void)
+{
+	Elf64_Ehdr ehdr = { 0 };
+	Elf64_Shdr shdrs[OS_COUNT] = { 0 };
+	Elf64_Sym esym;
+	Elf64_Rela rela;
+	struct obj_sym *sym;
+	struct obj_buf *symtab = &sections[OS_SYMTAB],
+		*strtab = &sections[OS_STRTAB],
+		*shstrtab = &sections[OS_SHSTRTAB];
+	unsigned i, pass, nlocals = 1;
+	size_t pos;
+
+	// local .comm variables are allocated in .bss; global ones are common
+	// symbols
+	obj_alloc_commons(0);
+
+	// symbol table: null symbol, then local symbols, then global
+	// (and undefined) symbols
+	memset(&esym, 0, sizeof(esym));
+	buf_append(symtab, &esym, sizeof(esym));
+	buf_append(strtab, "", 1);
+	for (pass = 0; pass < 2; ++pass) {
+		for (i = 0; i < nsyms; ++i) {
+			sym = &syms[i];
+			if ((sym->global || !sym->section) != pass) {
+				continue;
+			}
+
+			esym.st_name = strtab_add(strtab, sym->name);
+			esym.st_info = ELF64_ST_INFO(pass ? STB_GLOBAL
+				: STB_LOCAL, sym->func ? STT_FUNC
+				: sym->common ? STT_OBJECT : STT_NOTYPE);
+			esym.st_other = STV_DEFAULT;
+			esym.st_shndx = sym->section ? sym->section
+				: sym->common ? SHN_COMMON : SHN_UNDEF;
+			esym.st_value = esym.st_shndx == SHN_COMMON
+				? comm_align(sym->size) : sym->value;
+			esym.st_size = sym->size;
+			sym->index = symtab->len / sizeof(Elf64_Sym);
+			buf_append(symtab, &esym, sizeof(esym));
+		}
+		if (!pass) {
+			nlocals = symtab->len / sizeof(Elf64_Sym);
+		}
+	}
+
+	for (i = 0; i < nrelocs; ++i) {
+		rela.r_offset = relocs[i].offset;
+		rela.r_info = ELF64_R_INFO(syms[relocs[i].sym].index,
+			relocs[i].type);
+		rela.r_addend = relocs[i].addend;
+		buf_append(&sections[OS_RELA_TEXT], &rela, sizeof(rela));
+	}
+
+	// section headers
+	buf_append(shstrtab, "", 1);
+	for (i = 1; i < OS_COUNT; ++i) {
+		shdrs[i].sh_name = strtab_add(shstrtab, section_names[i]);
+		shdrs[i].sh_type = SHT_PROGBITS;
+		shdrs[i].sh_addralign = 1;
+		shdrs[i].sh_size = sections[i].len;
+	}
+	shdrs[OS_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+	shdrs[OS_DATA].sh_flags = SHF_ALLOC | SHF_WRITE;
+	shdrs[OS_BSS].sh_type = SHT_NOBITS;
+	shdrs[OS_BSS].sh_flags = SHF_ALLOC | SHF_WRITE;
+	shdrs[OS_BSS].sh_size = bss_size;
+	shdrs[OS_BSS].sh_addralign = bss_align;
+	shdrs[OS_RODATA].sh_flags = SHF_ALLOC;
+	shdrs[OS_RODATA_STR].sh_flags = SHF_ALLOC | SHF_MERGE | SHF_STRINGS;
+	shdrs[OS_RODATA_STR].sh_entsize = 1;
+	shdrs[OS_RELA_TEXT].sh_type = SHT_RELA;
+	shdrs[OS_RELA_TEXT].sh_flags = SHF_INFO_LINK;
+	shdrs[OS_RELA_TEXT].sh_link = OS_SYMTAB;
+	shdrs[OS_RELA_TEXT].sh_info = OS_TEXT;
+	shdrs[OS_RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+	shdrs[OS_RELA_TEXT].sh_addralign = 8;
+	shdrs[OS_SYMTAB].sh_type = SHT_SYMTAB;
+	shdrs[OS_SYMTAB].sh_link = OS_STRTAB;
+	shdrs[OS_SYMTAB].sh_info = nlocals;
+	shdrs[OS_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+	shdrs[OS_SYMTAB].sh_addralign = 8;
+	shdrs[OS_STRTAB].sh_type = SHT_STRTAB;
+	shdrs[OS_SHSTRTAB].sh_type = SHT_STRTAB;
+
+	// file layout: ELF header, section contents, section header table
+	pos = sizeof(Elf64_Ehdr);
+	for (i = 1; i < OS_COUNT; ++i) {
+		if (shdrs[i].sh_type == SHT_NOBITS) {
+			shdrs[i].sh_offset = pos;
+			continue;
+		}
+		pos = ALIGN_UP(pos, shdrs[i].sh_addralign);
+		shdrs[i].sh_offset = pos;
+		pos += sections[i].len;
+	}
+	pos = ALIGN_UP(pos, 8);
+
+	memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+	ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+	ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+	ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+	ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	ehdr.e_type = ET_REL;
+	ehdr.e_machine = EM_X86_64;
+	ehdr.e_version = EV_CURRENT;
+	ehdr.e_shoff = pos;
+	ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+	ehdr.e_shentsize = sizeof(Elf64_Shdr);
+	ehdr.e_shnum = OS_COUNT;
+	ehdr.e_shstrndx = OS_SHSTRTAB;
+
+	pos = 0;
+	out_write(&ehdr, sizeof(ehdr));
+	pos += sizeof(ehdr);
+	for (i = 1; i < OS_COUNT; ++i) {
+		if (shdrs[i].sh_type == SHT_NOBITS) {
+			continue;
+		}
+		write_padding(&pos, shdrs[i].sh_addralign);
+		if (sections[i].len) {
+			out_write(sections[i].data, sections[i].len);
+		}
+		pos += sections[i].len;
+	}
+	write_padding(&pos, 8);
+	out_write(shdrs, sizeof(shdrs));
+}
@@ -0,0 +1,475 @@
+#include <asmgen/encode.h>
+#include <parser/astnode.h>
+#include <string.h>
+
+// instruction being encoded
+struct enc {
+	unsigned char *buf;
+	unsigned len;
+	struct asm_fixup *fixup;
+};
+
+// r/m operand: a register, or disp(base,index,scale), or sym+disp(%rip)
+struct rm {
+	int is_reg, reg;
+	int has_base, has_index, base, index, scale;
+	int disp;
+	char *sym;
+};
+
+// hardware register numbers
+static const unsigned char reg_num[] = {
+	[AR_A] = 0, [AR_C] = 1, [AR_D] = 2, [AR_B] = 3,
+	[AR_SP] = 4, [AR_BP] = 5, [AR_SI] = 6, [AR_DI] = 7,
+	[AR_8] = 8, [AR_9] = 9, [AR_10] = 10, [AR_11] = 11,
+	[AR_12] = 12, [AR_13] = 13, [AR_14] = 14, [AR_15] = 15,
+};
+
+// condition code field of jcc/setcc
+static unsigned char cc_num(enum asm_opcode oc)
+{
+	switch (oc) {
+	case AOC_JE: case AOC_SETE:	return 0x4;
+	case AOC_JNE: case AOC_SETNE:	return 0x5;
+	case AOC_JL: case AOC_SETL:	return 0xc;
+	case AOC_JGE: case AOC_SETGE:	return 0xd;
+	case AOC_JLE: case AOC_SETLE:	return 0xe;
+	default:			return 0xf;
+	}
+}
+
+static void put(struct enc *e, unsigned char byte)
+{
+	e->buf[e->len++] = byte;
+}
+
+// little-endian value of n bytes
+static void put_le(struct enc *e, uint64_t val, unsigned n)
+{
+	while (n--) {
+		put(e, val);
+		val >>= 8;
+	}
+}
+
+static int fits8(int64_t val)
+{
+	return val >= INT8_MIN && val <= INT8_MAX;
+}
+
+static int fits32(int64_t val)
+{
+	return val >= INT32_MIN && val <= INT32_MAX;
+}
+
+// size of an immediate field in an instruction of the given size (64-bit
+// instructions take a sign-extended 32-bit immediate)
+static unsigned imm_len(enum asm_size size)
+{
+	return size == AS_B ? 1 : size == AS_W ? 2 : 4;
+}
+
+// value of an immediate operand, sign-extended from the instruction size
+static int64_t imm_val(struct asm_addr *op, enum asm_size size)
+{
+	uint64_t val = *((uint64_t *) op->value.addr->val.constval);
+
+	switch (size) {
+	case AS_B:	return (int8_t) val;
+	case AS_W:	return (int16_t) val;
+	case AS_L:	return (int32_t) val;
+	default:	return (int64_t) val;
+	}
+}
+
+static int is_reg(struct asm_addr *op, enum asm_reg_name name)
+{
+	return op->mode == AAM_REGISTER && op->value.reg.name == name;
+}
+
+// %spl, %bpl, %sil and %dil can only be encoded with a REX prefix
+static int byte_rex(struct asm_addr *op)
+{
+	return op && op->mode == AAM_REGISTER && op->value.reg.size == AS_B
+		&& reg_num[op->value.reg.name] >= 4
+		&& reg_num[op->value.reg.name] < 8;
+}
+
+static void get_rm(struct asm_addr *op, struct rm *rm)
+{
+	union astnode *decl, *sc;
+	struct addr *addr;
+
+	memset(rm, 0, sizeof(struct rm));
+
+	switch (op->mode) {
+	case AAM_REGISTER:
+		rm->is_reg = 1;
+		rm->reg = reg_num[op->value.reg.name];
+		return;
+
+	case AAM_INDIRECT:
+		rm->has_base = 1;
+		rm->base = reg_num[op->value.reg.name];
+		return;
+
+	case AAM_MEMORY:
+		// temporary or local variable: disp(%rbp); global: sym(%rip)
+		addr = op->value.addr;
+		if (addr->type == AT_TMP) {
+			rm->has_base = 1;
+			rm->base = reg_num[AR_BP];
+			rm->disp = addr->offset;
+			return;
+		}
+
+		decl = addr->val.astnode;
+		sc = decl->decl.is_string ? NULL
+			: decl->decl.declspec->declspec.sc;
+		if (sc && sc->sc.scspec != SC_EXTERN
+			&& sc->sc.scspec != SC_STATIC) {
+			rm->has_base = 1;
+			rm->base = reg_num[AR_BP];
+			rm->disp = decl->decl.offset;
+			return;
+		}
+		rm->sym = asm_sym_name(decl);
+		return;
+
+	case AAM_REG_OFF:
+		rm->disp = op->value.mem.disp;
+		if (op->value.mem.sym) {
+			rm->sym = asm_sym_name(op->value.mem.sym->val.astnode);
+			return;
+		}
+		if ((rm->has_base = op->value.mem.has_base)) {
+			rm->base = reg_num[op->value.mem.base];
+		}
+		if ((rm->has_index = op->value.mem.has_index)) {
+			rm->index = reg_num[op->value.mem.index];
+			rm->scale = op->value.mem.scale;
+		}
+		return;
+
+	default:
+		yyerror_fatal("encode: not an r/m operand");
+	}
+}
+
+static void put_rex(struct enc *e, int w, int r, int x, int b, int force)
+{
+	if (w || r >= 8 || x >= 8 || b >= 8 || force) {
+		put(e, 0x40 | w << 3 | (r >= 8) << 2 | (x >= 8) << 1
+			| (b >= 8));
+	}
+}
+
+/**
+ * emit an instruction with a ModRM byte: [66] [REX] opcode ModRM [SIB] [disp]
+ * [imm]
+ *
+ * @param size		operand size (for the 66 prefix and REX.W)
+ * @param opcode	opcode bytes
+ * @param reg		register (or opcode extension) of the reg field
+ * @param reg_op	operand in the reg field, if it is a register
+ * @param rm_op		operand in the r/m field
+ * @param ilen		length of the immediate (0 if none)
+ * @param imm		immediate
+ */
+static void put_modrm_inst(struct enc *e, enum asm_size size,
+	const char *opcode, unsigned oplen, int reg, struct asm_addr *reg_op,
+	struct asm_addr *rm_op, unsigned ilen, int64_t imm)
+{
+	struct rm rm;
+	int mod, sib;
+
+	get_rm(rm_op, &rm);
+
+	if (size == AS_W) {
+		put(e, 0x66);
+	}
+	put_rex(e, size == AS_Q, reg, rm.has_index ? rm.index : 0,
+		rm.is_reg ? rm.reg : rm.has_base ? rm.base : 0,
+		byte_rex(reg_op) || byte_rex(rm_op));
+	while (oplen--) {
+		put(e, *opcode++);
+	}
+
+	reg = (reg & 7) << 3;
+	if (rm.is_reg) {
+		put(e, 0xc0 | reg | (rm.reg & 7));
+	}
+
+	// sym+disp(%rip)
+	else if (rm.sym) {
+		put(e, 0x05 | reg);
+		e->fixup->kind = AFK_PC32;
+		e->fixup->label = rm.sym;
+		e->fixup->offset = e->len;
+		e->fixup->size = 4;
+		e->fixup->addend = rm.disp;
+		put_le(e, 0, 4);
+	}
+
+	// disp32(,index,scale)
+	else if (!rm.has_base) {
+		put(e, 0x04 | reg);
+		put(e, (__builtin_ctz(rm.scale ? rm.scale : 1)) << 6
+			| (rm.has_index ? rm.index & 7 : 4) << 3 | 5);
+		put_le(e, rm.disp, 4);
+	}
+
+	// disp(base,index,scale); %rbp and %r13 as a base always have a
+	// displacement, and %rsp and %r12 always need a SIB byte
+	else {
+		mod = !rm.disp && (rm.base & 7) != 5 ? 0
+			: fits8(rm.disp) ? 1 : 2;
+		sib = rm.has_index || (rm.base & 7) == 4;
+
+		put(e, mod << 6 | reg | (sib ? 4 : rm.base & 7));
+		if (sib) {
+			put(e, (rm.has_index ? __builtin_ctz(rm.scale) : 0) << 6
+				| (rm.has_index ? rm.index & 7 : 4) << 3
+				| (rm.base & 7));
+		}
+		put_le(e, rm.disp, mod == 1 ? 1 : mod == 2 ? 4 : 0);
+	}
+
+	put_le(e, imm, ilen);
+}
+
+// emit an instruction with the register in the opcode: [66] [REX] opcode+reg
+// [imm]
+static void put_opreg_inst(struct enc *e, enum asm_size size,
+	unsigned char opcode, struct asm_addr *reg_op, unsigned ilen,
+	int64_t imm)
+{
+	int reg = reg_num[reg_op->value.reg.name];
+
+	if (size == AS_W) {
+		put(e, 0x66);
+	}
+	put_rex(e, size == AS_Q, 0, 0, reg, byte_rex(reg_op));
+	put(e, opcode + (reg & 7));
+	put_le(e, imm, ilen);
+}
+
+// jmp/jcc/call: opcode rel8/rel32
+static void put_rel_inst(struct enc *e, const char *opcode, unsigned oplen,
+	enum asm_fixup_kind kind, char *label, unsigned size)
+{
+	while (oplen--) {
+		put(e, *opcode++);
+	}
+	e->fixup->kind = kind;
+	e->fixup->label = label;
+	e->fixup->offset = e->len;
+	e->fixup->size = size;
+	e->fixup->addend = 0;
+	put_le(e, 0, size);
+}
+
+// add/sub/cmp/xor (n is the opcode extension, and opcode / 8)
+static void put_alu_inst(struct enc *e, struct asm_inst *inst, int n)
+{
+	struct asm_addr *src = inst->src, *dest = inst->dest;
+	enum asm_size size = inst->size;
+	int64_t imm;
+	char op;
+
+	if (src->mode == AAM_IMMEDIATE) {
+		imm = imm_val(src, size);
+
+		// sign-extended imm8; otherwise the accumulator has a form
+		// without a ModRM byte
+		if (size != AS_B && fits8(imm)) {
+			put_modrm_inst(e, size, "\x83", 1, n, NULL, dest, 1, imm);
+		} else if (is_reg(dest, AR_A)) {
+			if (size == AS_W) {
+				put(e, 0x66);
+			}
+			put_rex(e, size == AS_Q, 0, 0, 0, 0);
+			put(e, n << 3 | (size == AS_B ? 4 : 5));
+			put_le(e, imm, imm_len(size));
+		} else {
+			put_modrm_inst(e, size, size == AS_B ? "\x80" : "\x81",
+				1, n, NULL, dest, imm_len(size), imm);
+		}
+		return;
+	}
+
+	// op reg, r/m; or op r/m, reg
+	if (src->mode == AAM_REGISTER) {
+		op = n << 3 | (size != AS_B);
+		put_modrm_inst(e, size, &op, 1, reg_num[src->value.reg.name],
+			src, dest, 0, 0);
+	} else {
+		op = n << 3 | 2 | (size != AS_B);
+		put_modrm_inst(e, size, &op, 1, reg_num[dest->value.reg.name],
+			dest, src, 0, 0);
+	}
+}
+
+static void put_mov_inst(struct enc *e, struct asm_inst *inst)
+{
+	struct asm_addr *src = inst->src, *dest = inst->dest;
+	enum asm_size size = inst->size;
+	int64_t imm;
+
+	if (src->mode == AAM_IMMEDIATE) {
+		imm = imm_val(src, size);
+
+		// mov $imm, %reg: register in the opcode, except for 64-bit
+		// registers and sign-extended imm32 (movabs otherwise)
+		if (dest->mode == AAM_REGISTER
+			&& (size != AS_Q || !fits32(imm))) {
+			put_opreg_inst(e, size, size == AS_B ? 0xb0 : 0xb8,
+				dest, size == AS_Q ? 8 : imm_len(size), imm);
+		} else {
+			put_modrm_inst(e, size, size == AS_B ? "\xc6" : "\xc7",
+				1, 0, NULL, dest, imm_len(size), imm);
+		}
+	} else if (src->mode == AAM_REGISTER) {
+		put_modrm_inst(e, size, size == AS_B ? "\x88" : "\x89", 1,
+			reg_num[src->value.reg.name], src, dest, 0, 0);
+	} else {
+		put_modrm_inst(e, size, size == AS_B ? "\x8a" : "\x8b", 1,
+			reg_num[dest->value.reg.name], dest, src, 0, 0);
+	}
+}
+
+// movs/movz: sizes are taken from the operands
+static void put_movx_inst(struct enc *e, struct asm_inst *inst)
+{
+	struct asm_addr *src = inst->src, *dest = inst->dest;
+	char op[2] = { 0x0f };
+
+	// movslq
+	if (inst->oc == AOC_MOVS && src->size == AS_L) {
+		put_modrm_inst(e, AS_Q, "\x63", 1,
+			reg_num[dest->value.reg.name], dest, src, 0, 0);
+		return;
+	}
+
+	op[1] = (inst->oc == AOC_MOVS ? 0xbe : 0xb6) + (src->size == AS_W);
+	put_modrm_inst(e, dest->size, op, 2, reg_num[dest->value.reg.name],
+		dest, src, 0, 0);
+}
+
+unsigned asm_inst_encode(struct asm_inst *inst, int short_branch,
+	unsigned char *buf, struct asm_fixup *fixup)
+{
+	struct enc e = { buf, 0, fixup };
+	struct asm_addr *src = inst->src, *dest = inst->dest;
+	enum asm_size size = inst->size;
+	int64_t imm;
+	char op[2];
+
+	fixup->kind = AFK_NONE;
+
+	switch (inst->oc) {
+	case AOC_LEAVE:	put(&e, 0xc9); break;
+	case AOC_RET:	put(&e, 0xc3); break;
+	case AOC_CLTD:	put(&e, 0x99); break;
+	case AOC_CLTQ:	put(&e, 0x48); put(&e, 0x98); break;
+	case AOC_CQTO:	put(&e, 0x48); put(&e, 0x99); break;
+
+	// 64-bit push/pop don't need REX.W
+	case AOC_PUSH:
+	case AOC_POP:
+		put_opreg_inst(&e, AS_NONE, inst->oc == AOC_PUSH ? 0x50 : 0x58,
+			src, 0, 0);
+		break;
+
+	case AOC_CALL:
+		put_rel_inst(&e, "\xe8", 1, AFK_PLT32, src->value.label, 4);
+		break;
+
+	case AOC_JMP:
+		put_rel_inst(&e, short_branch ? "\xeb" : "\xe9", 1, AFK_BRANCH,
+			src->value.label, short_branch ? 1 : 4);
+		break;
+
+	case AOC_JE: case AOC_JNE: case AOC_JL:
+	case AOC_JLE: case AOC_JG: case AOC_JGE:
+		if (short_branch) {
+			op[0] = 0x70 | cc_num(inst->oc);
+			put_rel_inst(&e, op, 1, AFK_BRANCH, src->value.label, 1);
+		} else {
+			op[0] = 0x0f;
+			op[1] = 0x80 | cc_num(inst->oc);
+			put_rel_inst(&e, op, 2, AFK_BRANCH, src->value.label, 4);
+		}
+		break;
+
+	case AOC_SETE: case AOC_SETNE: case AOC_SETL:
+	case AOC_SETLE: case AOC_SETG: case AOC_SETGE:
+		op[0] = 0x0f;
+		op[1] = 0x90 | cc_num(inst->oc);
+		put_modrm_inst(&e, AS_B, op, 2, 0, NULL, src, 0, 0);
+		break;
+
+	case AOC_MOV:
+		put_mov_inst(&e, inst);
+		break;
+
+	case AOC_MOVS:
+	case AOC_MOVZ:
+		put_movx_inst(&e, inst);
+		break;
+
+	case AOC_LEA:
+		put_modrm_inst(&e, size, "\x8d", 1,
+			reg_num[dest->value.reg.name], dest, src, 0, 0);
+		break;
+
+	case AOC_ADD:	put_alu_inst(&e, inst, 0); break;
+	case AOC_SUB:	put_alu_inst(&e, inst, 5); break;
+	case AOC_XOR:	put_alu_inst(&e, inst, 6); break;
+	case AOC_CMP:	put_alu_inst(&e, inst, 7); break;
+
+	// two-operand imul; with an immediate, the destination is also the
+	// source
+	case AOC_MUL:
+		if (src->mode == AAM_IMMEDIATE) {
+			imm = imm_val(src, size);
+			put_modrm_inst(&e, size, fits8(imm) ? "\x6b" : "\x69",
+				1, reg_num[dest->value.reg.name], dest, dest,
+				fits8(imm) ? 1 : imm_len(size), imm);
+		} else {
+			put_modrm_inst(&e, size, "\x0f\xaf", 2,
+				reg_num[dest->value.reg.name], dest, src, 0, 0);
+		}
+		break;
+
+	case AOC_DIV:
+		put_modrm_inst(&e, size, size == AS_B ? "\xf6" : "\xf7", 1, 7,
+			NULL, src, 0, 0);
+		break;
+
+	case AOC_INC:
+	case AOC_DEC:
+		put_modrm_inst(&e, size, size == AS_B ? "\xfe" : "\xff", 1,
+			inst->oc == AOC_DEC, NULL, src, 0, 0);
+		break;
+
+	default:
+		yyerror_fatal("encode: unknown instruction");
+	}
+
+	// make the addend relative to the field (rather than to the end of
+	// the instruction, which is what the CPU adds the field to)
+	if (fixup->kind != AFK_NONE) {
+		fixup->addend -= e.len - fixup->offset;
+	}
+
+	return e.len;
+}
+
+unsigned asm_inst_length(struct asm_inst *inst)
+{
+	unsigned char buf[ASM_INST_MAX_LEN];
+	struct asm_fixup fixup;
+
+	return asm_inst_encode(inst, 1, buf, &fixup);
+}
@@ -0,0 +1,1146 @@
+#include <asmgen/asm.h>
+#include <asmgen/isel.h>
+#include <quads/printutils.h>
+#include <parser/astnode.h>
+#include <stdint.h>
+#include <string.h>
+
+// a folded expression tree may not need more than this many scratch registers
+// (Sethi-Ullman number); this leaves room for the fncall argument registers
+#define FOLD_MAX_NEED 3
+
+// scratch (caller-save) registers, in order of preference
+static enum asm_reg_name scratch_reg[] = {
+	AR_A, AR_C, AR_D, AR_SI, AR_DI, AR_8, AR_9, AR_10, AR_11
+};
+
+#define SCRATCH_COUNT	(sizeof scratch_reg / sizeof *scratch_reg)
+
+// registers currently in use while selecting a single (root) quad
+static _Thread_local unsigned reg_busy;
+
+// registers are handed out round-robin across quads, so that the
+// instructions of consecutive quads use different registers and can be
+// interleaved by the instruction scheduler; not when optimizing for size,
+// since r8-r11 need a REX prefix
+static _Thread_local unsigned reg_next;
+
+#define REG_BIT(r)	(1u << (r))
+
+static enum asm_reg_name reg_get(void)
+{
+	unsigned i, j;
+
+	for (i = 0; i < SCRATCH_COUNT; ++i) {
+		j = optimize_size ? i : (reg_next + i) % SCRATCH_COUNT;
+		if (!(reg_busy & REG_BIT(scratch_reg[j]))) {
+			reg_busy |= REG_BIT(scratch_reg[j]);
+			reg_next = j + 1;
+			return scratch_reg[j];
+		}
+	}
+
+	yyerror_fatal("isel: out of scratch registers");
+	return AR_A;
+}
+
+static void reg_take(enum asm_reg_name r)
+{
+	reg_busy |= REG_BIT(r);
+}
+
+static void reg_put(enum asm_reg_name r)
+{
+	reg_busy &= ~REG_BIT(r);
+}
+
+static enum asm_size size2as(unsigned size)
+{
+	switch (size) {
+	case 1:	return AS_B;
+	case 2:	return AS_W;
+	case 4:	return AS_L;
+	default: return AS_Q;
+	}
+}
+
+/**
+ * OPERAND HELPERS
+ */
+
+static int is_const(struct addr *a)
+{
+	return a->type == AT_CONST;
+}
+
+static int64_t const_val(struct addr *a)
+{
+	return (int64_t) *((uint64_t *)a->val.constval);
+}
+
+// constant can be used as an immediate operand (x86_64 immediates are at most
+// 32 bits, sign-extended to 64 bits)
+static int fits_imm(struct addr *a)
+{
+	int64_t val = const_val(a);
+
+	return is_const(a)
+		&& (a->size < 8 || (val >= INT32_MIN && val <= INT32_MAX));
+}
+
+// whether a value is of a signed type (plain char is signed on x86_64)
+static int is_signed(struct addr *a)
+{
+	union astnode *type = a->decl;
+
+	if (NT(type) == NT_DECLSPEC) {
+		type = type->declspec.ts;
+	}
+	return NT(type) == NT_TS_SCALAR
+		&& type->ts_scalar.basetype != BT_BOOL
+		&& type->ts_scalar.modifiers.sign != SIGN_UNSIGNED;
+}
+
+// constant's value is representable in size bytes (as a signed or unsigned
+// value)
+static int fits_size(struct addr *a, unsigned size)
+{
+	int64_t val = const_val(a);
+
+	return is_const(a) && size < 8
+		&& val >= -((int64_t) 1 << (size * 8 - 1))
+		&& val < ((int64_t) 1 << (size * 8));
+}
+
+static int is_folded(struct addr *a)
+{
+	return a && a->type == AT_TMP && a->fold;
+}
+
+// whether variable is a (rbp-relative) local variable rather than a
+// (rip-relative) global variable or string literal
+static int is_local_var(struct addr *a)
+{
+	union astnode *decl = a->val.astnode, *sc;
+
+	if (decl->decl.is_string) {
+		return 0;
+	}
+
+	sc = decl->decl.declspec->declspec.sc;
+	return sc->sc.scspec != SC_EXTERN && sc->sc.scspec != SC_STATIC;
+}
+
+// pointer arithmetic quad: dest = ADD ptr, (size_t) offset
+static int is_ptr_add(struct quad *q)
+{
+	return q->opcode == OC_ADD && QDEST(q)->size == 8
+		&& QSRC1(q)->size == 8 && QSRC2(q)->size == 8
+		&& NT(QSRC1(q)->decl) == NT_DECLARATOR_POINTER;
+}
+
+// index multiplier that fits in the scale field of a memory operand
+static int is_scale(struct addr *a)
+{
+	int64_t val;
+
+	if (!is_const(a)) {
+		return 0;
+	}
+	val = const_val(a);
+	return val == 1 || val == 2 || val == 4 || val == 8;
+}
+
+// decompose an index into a scaled index, if the index is a folded
+// multiplication by 1, 2, 4, or 8
+static struct addr *scaled_index(struct addr *idx, int *scale)
+{
+	struct quad *q;
+
+	*scale = 1;
+	if (!is_folded(idx) || (q = idx->def)->opcode != OC_MUL) {
+		return idx;
+	}
+
+	if (is_scale(QSRC1(q))) {
+		*scale = const_val(QSRC1(q));
+		return QSRC2(q);
+	}
+	if (is_scale(QSRC2(q))) {
+		*scale = const_val(QSRC2(q));
+		return QSRC1(q);
+	}
+	return idx;
+}
+
+// evaluate a (folded) constant expression, e.g., a constant array index, so
+// that it can become the displacement of a memory operand
+static int const_fold(struct addr *a, int64_t *val)
+{
+	struct quad *q;
+	int64_t v1, v2;
+
+	if (is_const(a)) {
+		*val = const_val(a);
+		return 1;
+	}
+	if (!is_folded(a)) {
+		return 0;
+	}
+
+	q = a->def;
+	switch (q->opcode) {
+	case OC_CAST:
+	case OC_MOV:
+		return QDEST(q)->size >= QSRC1(q)->size
+			&& const_fold(QSRC1(q), val);
+	case OC_ADD:
+	case OC_SUB:
+	case OC_MUL:
+		if (!const_fold(QSRC1(q), &v1) || !const_fold(QSRC2(q), &v2)) {
+			return 0;
+		}
+		*val = q->opcode == OC_ADD ? v1 + v2
+			: q->opcode == OC_SUB ? v1 - v2 : v1 * v2;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static struct asm_addr *mem_new(void)
+{
+	struct asm_addr *m = ARENA_NEW(struct asm_addr);
+
+	m->mode = AAM_REG_OFF;
+	return m;
+}
+
+// memory operand for a variable or non-folded temporary
+static struct asm_addr *slot_operand(struct addr *a, unsigned size)
+{
+	struct asm_addr *m = ARENA_NEW(struct asm_addr);
+
+	m->mode = AAM_MEMORY;
+	m->size = size2as(size);
+	m->value.addr = a;
+	return m;
+}
+
+static struct asm_addr *imm_operand(struct addr *a)
+{
+	struct asm_addr *m = ARENA_NEW(struct asm_addr);
+
+	m->mode = AAM_IMMEDIATE;
+	m->size = size2as(a->size);
+	m->value.addr = a;
+	return m;
+}
+
+// register operands take on the size of the instruction they're used in
+static struct asm_addr *resize(struct asm_addr *op, enum asm_size size)
+{
+	if (op->mode == AAM_REGISTER) {
+		op->size = op->value.reg.size = size;
+	}
+	return op;
+}
+
+// release any scratch registers held by an operand
+static void operand_put(struct asm_addr *op)
+{
+	switch (op->mode) {
+	case AAM_REGISTER:
+		reg_put(op->value.reg.name);
+		break;
+	case AAM_REG_OFF:
+		if (op->value.mem.has_base && op->value.mem.base != AR_BP) {
+			reg_put(op->value.mem.base);
+		}
+		if (op->value.mem.has_index) {
+			reg_put(op->value.mem.index);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * load an operand into register r, extending it to (at least) the given size
+ *
+ * Registers are always written as a whole (32 or 64 bits) to avoid partial
+ * register writes: 1- and 2-byte values are zero- or sign-extended into the
+ * 32-bit register according to their signedness, and 32-bit writes implicitly
+ * zero-extend to 64 bits. Thus a narrow value in a register is always
+ * extended to 32 bits.
+ *
+ * @param m		source operand (immediate, memory, or register)
+ * @param size		size of the value in the register
+ * @param sgn		whether the source operand is signed
+ * @param r		destination register
+ */
+static void load_reg(struct asm_addr *m, enum asm_size size, int sgn,
+	enum asm_reg_name r)
+{
+	enum asm_size from = m->size;
+
+	size = MAX(size, AS_L);
+
+	// same size or truncation (reads the low bytes); zero-extension from
+	// 32 bits is implicit
+	if (m->mode == AAM_IMMEDIATE || from >= size || (from == AS_L && !sgn)) {
+		from = m->mode == AAM_IMMEDIATE ? size : MIN(from, size);
+		resize(m, from)->size = from;
+		asm_inst_new(AOC_MOV, m, reg2addr(r, from), from);
+		return;
+	}
+
+	// unsigned narrow values only need to be zero-extended to 32 bits
+	asm_inst_new(sgn ? AOC_MOVS : AOC_MOVZ, m,
+		reg2addr(r, sgn ? size : AS_L), AS_NONE);
+}
+
+/**
+ * COST MODEL
+ *
+ * Costs are (approximate) instruction counts for the different ways of tiling
+ * an expression tree, mirroring the emitters below: cost_reg() to compute a
+ * value into a register, cost_rm() to make it available as an instruction
+ * operand (immediate, memory, or register), and cost_addr() to form a
+ * memory operand addressing the location it points to.
+ */
+
+// shape of a memory operand formed by cost_addr()/tile_addr()
+#define ADDR_INDEX	1	// has an index register
+#define ADDR_RIP	2	// rip-relative (no index allowed)
+
+static int cost_reg(struct addr *a);
+static int cost_quad(struct quad *q);
+
+static int cost_addr_quad(struct quad *q, int *shape);
+
+static int cost_addr(struct addr *p, int *shape)
+{
+	*shape = 0;
+
+	// if not folded, load pointer into base register
+	return is_folded(p) ? cost_addr_quad(p->def, shape) : 1;
+}
+
+// cost of forming a memory operand from the pointer computed by q
+static int cost_addr_quad(struct quad *q, int *shape)
+{
+	struct addr *idx;
+	int64_t disp;
+	int cost, s, scale;
+
+	*shape = 0;
+	switch (q->opcode) {
+	case OC_LEA:
+		*shape = is_local_var(QSRC1(q)) ? 0 : ADDR_RIP;
+		return 0;
+
+	case OC_CAST:
+		if (QSRC1(q)->size == QDEST(q)->size) {
+			return cost_addr(QSRC1(q), shape);
+		}
+		break;
+
+	case OC_ADD:
+		if (!is_ptr_add(q)) {
+			break;
+		}
+
+		cost = cost_addr(QSRC1(q), &s);
+		if (const_fold(QSRC2(q), &disp) && disp >= INT32_MIN
+			&& disp <= INT32_MAX) {
+			*shape = s;
+			return cost;
+		}
+		idx = scaled_index(QSRC2(q), &scale);
+
+		// already have an index or rip-relative: base must first be
+		// materialized with lea
+		if (s) {
+			++cost;
+		}
+		*shape = ADDR_INDEX;
+		return cost + cost_reg(idx);
+
+	default:
+		break;
+	}
+
+	return cost_quad(q);
+}
+
+static int cost_rm(struct addr *a)
+{
+	int shape;
+
+	if (fits_imm(a) || (!is_const(a) && !is_folded(a))) {
+		return 0;
+	}
+	if (is_folded(a) && a->def->opcode == OC_LOAD) {
+		return cost_addr(QSRC1(a->def), &shape);
+	}
+	return cost_reg(a);
+}
+
+static int cost_reg(struct addr *a)
+{
+	return is_folded(a) ? cost_quad(a->def) : 1;
+}
+
+// cost of computing the result of q into a register using the general
+// (non-lea) arithmetic tiling
+static int cost_arith(struct quad *q)
+{
+	return 1 + MIN(cost_reg(QSRC1(q)) + cost_rm(QSRC2(q)),
+		q->opcode == OC_SUB ? INT32_MAX
+			: cost_reg(QSRC2(q)) + cost_rm(QSRC1(q)));
+}
+
+static int cost_quad(struct quad *q)
+{
+	int shape;
+
+	switch (q->opcode) {
+	case OC_LEA:
+		return 1;
+	case OC_LOAD:
+		return 1 + cost_addr(QSRC1(q), &shape);
+	case OC_MOV:
+		return cost_reg(QSRC1(q));
+	case OC_CAST:
+		if (QDEST(q)->size <= QSRC1(q)->size || is_const(QSRC1(q))) {
+			return cost_reg(QSRC1(q));
+		}
+		return 1 + cost_rm(QSRC1(q));
+	case OC_ADD:
+		if (is_ptr_add(q)) {
+			// lea vs. mov+add
+			return MIN(cost_arith(q),
+				1 + cost_addr_quad(q, &shape));
+		}
+		return cost_arith(q);
+	case OC_SUB:
+	case OC_MUL:
+		return cost_arith(q);
+	default:
+		// not a foldable quad
+		return INT32_MAX / 4;
+	}
+}
+
+/**
+ * EMITTERS
+ */
+
+static void tile_reg(struct addr *a, enum asm_reg_name r);
+static void tile_quad(struct quad *q, enum asm_reg_name r);
+
+static struct asm_addr *tile_addr(struct addr *p, enum asm_size size);
+
+// materialize a memory operand's address into a single base register
+static struct asm_addr *flatten_addr(struct asm_addr *m)
+{
+	enum asm_reg_name r;
+
+	r = m->value.mem.has_base && m->value.mem.base != AR_BP
+		? m->value.mem.base : reg_get();
+	m->size = AS_Q;
+	asm_inst_new(AOC_LEA, m, reg2addr(r, AS_Q), AS_Q);
+	if (m->value.mem.has_index) {
+		reg_put(m->value.mem.index);
+	}
+
+	m = mem_new();
+	m->value.mem.base = r;
+	m->value.mem.has_base = 1;
+	return m;
+}
+
+static struct asm_addr *tile_addr_quad(struct quad *q)
+{
+	struct asm_addr *m;
+	struct addr *idx;
+	enum asm_reg_name r;
+	int64_t disp;
+	int scale;
+
+	switch (q->opcode) {
+	case OC_LEA:
+		m = mem_new();
+		if (is_local_var(QSRC1(q))) {
+			m->value.mem.base = AR_BP;
+			m->value.mem.has_base = 1;
+			m->value.mem.disp =
+				QSRC1(q)->val.astnode->decl.offset;
+		} else {
+			m->value.mem.sym = QSRC1(q);
+		}
+		return m;
+
+	case OC_CAST:
+		if (QSRC1(q)->size == QDEST(q)->size) {
+			return tile_addr(QSRC1(q), AS_NONE);
+		}
+		break;
+
+	case OC_ADD:
+		if (!is_ptr_add(q)) {
+			break;
+		}
+
+		m = tile_addr(QSRC1(q), AS_NONE);
+		if (const_fold(QSRC2(q), &disp) && disp >= INT32_MIN
+			&& disp <= INT32_MAX) {
+			m->value.mem.disp += disp;
+			return m;
+		}
+		idx = scaled_index(QSRC2(q), &scale);
+
+		if (m->value.mem.has_index || m->value.mem.sym) {
+			m = flatten_addr(m);
+		}
+
+		r = reg_get();
+		tile_reg(idx, r);
+		m->value.mem.index = r;
+		m->value.mem.has_index = 1;
+		m->value.mem.scale = scale;
+		return m;
+
+	default:
+		break;
+	}
+
+	// general case: compute pointer into a base register
+	r = reg_get();
+	tile_quad(q, r);
+	m = mem_new();
+	m->value.mem.base = r;
+	m->value.mem.has_base = 1;
+	return m;
+}
+
+/**
+ * returns a memory operand for the object pointed to by p
+ *
+ * @param p		pointer value
+ * @param size		size of memory access
+ */
+static struct asm_addr *tile_addr(struct addr *p, enum asm_size size)
+{
+	struct asm_addr *m;
+
+	if (is_folded(p)) {
+		m = tile_addr_quad(p->def);
+	} else {
+		m = mem_new();
+		m->value.mem.base = reg_get();
+		m->value.mem.has_base = 1;
+		tile_reg(p, m->value.mem.base);
+	}
+
+	m->size = size;
+	return m;
+}
+
+/**
+ * returns an operand holding the value of a, as an immediate, memory operand,
+ * or (newly-allocated) register; release with operand_put()
+ */
+static struct asm_addr *tile_rm(struct addr *a)
+{
+	enum asm_reg_name r;
+
+	if (fits_imm(a)) {
+		return imm_operand(a);
+	}
+	if (!is_const(a) && !is_folded(a)) {
+		return slot_operand(a, a->size);
+	}
+	if (is_folded(a) && a->def->opcode == OC_LOAD) {
+		return tile_addr(QSRC1(a->def), size2as(a->size));
+	}
+
+	r = reg_get();
+	tile_reg(a, r);
+	return reg2addr(r, size2as(a->size));
+}
+
+/**
+ * like tile_rm(), but the operand may be used in an instruction of a larger
+ * size than the value (e.g., narrow arithmetic performed in 32 bits): narrow
+ * memory operands are first loaded into a register with extension
+ */
+static struct asm_addr *tile_rm_sized(struct addr *a, enum asm_size size)
+{
+	struct asm_addr *m;
+	enum asm_reg_name r;
+
+	m = tile_rm(a);
+	if ((m->mode == AAM_MEMORY || m->mode == AAM_REG_OFF)
+		&& m->size < size) {
+		operand_put(m);
+		r = reg_get();
+		load_reg(m, size, is_signed(a), r);
+		m = reg2addr(r, size);
+	}
+	return resize(m, size);
+}
+
+// compute value of a into register r
+static void tile_reg(struct addr *a, enum asm_reg_name r)
+{
+	enum asm_size size = size2as(a->size);
+
+	if (is_folded(a)) {
+		tile_quad(a->def, r);
+	} else if (is_const(a)) {
+		load_reg(imm_operand(a), size, 0, r);
+	} else {
+		load_reg(slot_operand(a, a->size), size, is_signed(a), r);
+	}
+}
+
+// compute value of src cast to the type of dest into register r
+static void tile_cast(struct addr *src, struct addr *dest, enum asm_reg_name r)
+{
+	enum asm_size dsize = size2as(dest->size);
+	struct asm_addr *m;
+	int sgn = is_signed(dest);
+
+	// constants are used as-is
+	if (is_const(src)) {
+		load_reg(imm_operand(src), dsize, 0, r);
+		return;
+	}
+
+	// narrowing or reinterpret cast: read low bytes of source
+	if (dest->size <= src->size) {
+		if (!is_folded(src)) {
+			load_reg(slot_operand(src, dest->size), dsize, sgn, r);
+			return;
+		}
+
+		// narrow register values must be re-extended from the new type
+		tile_reg(src, r);
+		if (dsize < AS_L && (dest->size < src->size
+			|| sgn != is_signed(src))) {
+			load_reg(reg2addr(r, dsize), dsize, sgn, r);
+		}
+		return;
+	}
+
+	// widening cast: extend according to the source type
+	m = tile_rm(src);
+	load_reg(m, dsize, is_signed(src), r);
+	operand_put(m);
+}
+
+// compute result of (foldable) quad into register r
+static void tile_quad(struct quad *q, enum asm_reg_name r)
+{
+	enum asm_size size = size2as(QDEST(q)->size);
+	enum asm_opcode oc;
+	struct addr *src1, *src2;
+	struct asm_addr *m;
+	int shape;
+
+	switch (q->opcode) {
+	case OC_LEA:
+		m = tile_addr_quad(q);
+		m->size = AS_Q;
+		asm_inst_new(AOC_LEA, m, reg2addr(r, AS_Q), AS_Q);
+		return;
+
+	case OC_LOAD:
+		m = tile_addr(QSRC1(q), size);
+		load_reg(m, size, is_signed(QDEST(q)), r);
+		operand_put(m);
+		return;
+
+	case OC_MOV:
+	case OC_CAST:
+		tile_cast(QSRC1(q), QDEST(q), r);
+		return;
+
+	case OC_ADD:
+		if (is_ptr_add(q)
+			&& 1 + cost_addr_quad(q, &shape) < cost_arith(q)) {
+			m = tile_addr_quad(q);
+			m->size = AS_Q;
+			asm_inst_new(AOC_LEA, m, reg2addr(r, AS_Q), AS_Q);
+			operand_put(m);
+			return;
+		}
+		oc = AOC_ADD;
+		break;
+	case OC_SUB:	oc = AOC_SUB; break;
+	case OC_MUL:	oc = AOC_MUL; break;
+
+	default:
+		yyerror_fatal("isel: unfoldable quad");
+		return;
+	}
+
+	// binary arithmetic: mov src1, r; op src2, r (commutative operators
+	// may swap operands if cheaper); narrow arithmetic is performed in
+	// 32 bits (the low bytes of the result are the same)
+	size = MAX(size, AS_L);
+	src1 = QSRC1(q);
+	src2 = QSRC2(q);
+	if (oc != AOC_SUB && cost_reg(src2) + cost_rm(src1)
+		< cost_reg(src1) + cost_rm(src2)) {
+		src1 = QSRC2(q);
+		src2 = QSRC1(q);
+	}
+
+	tile_reg(src1, r);
+	m = tile_rm_sized(src2, size);
+	asm_inst_new(oc, m, reg2addr(r, size), size);
+	operand_put(m);
+}
+
+/**
+ * ROOT QUAD SELECTION
+ */
+
+static enum asm_opcode cc2setcc(enum cc cc)
+{
+	switch (cc) {
+	case CC_E:	return AOC_SETE;
+	case CC_NE:	return AOC_SETNE;
+	case CC_L:	return AOC_SETL;
+	case CC_LE:	return AOC_SETLE;
+	case CC_G:	return AOC_SETG;
+	default:	return AOC_SETGE;
+	}
+}
+
+// whether two addrs refer to the same storage (each variable has only one
+// addr, see var_addr())
+static int same_storage(struct addr *a, struct addr *b)
+{
+	return a == b;
+}
+
+static void select_call(struct quad *quad)
+{
+	struct asm_addr *label;
+	enum asm_size size;
+	unsigned param_count;
+
+	for (param_count = 0; param_count < CALL_ARGC(quad); ++param_count) {
+		if (param_count == 6) {
+			yyerror("not supporting more than 6"
+				" arguments in fncall");
+			break;
+		}
+
+		// arguments already loaded stay reserved
+		reg_take(param_reg[param_count]);
+		tile_reg(CALL_ARG(quad, param_count), param_reg[param_count]);
+	}
+
+	// clear eax register (for non-vector argument list)
+	asm_inst_new(AOC_XOR, reg2addr(AR_A, AS_L), reg2addr(AR_A, AS_L), AS_L);
+
+	// emit call opcode
+	label = ARENA_NEW(struct asm_addr);
+	label->mode = AAM_LABEL;
+	label->size = AS_Q;
+	label->value.label = QSRC1(quad)->val.astnode->decl.ident;
+	asm_inst_new(AOC_CALL, label, NULL, AS_NONE);
+
+	if (QDEST(quad)) {
+		size = size2as(QDEST(quad)->size);
+		asm_inst_new(AOC_MOV, reg2addr(AR_A, size),
+			slot_operand(QDEST(quad), QDEST(quad)->size), size);
+	}
+}
+
+static void select_div(struct quad *quad)
+{
+	struct asm_addr *m;
+	enum asm_reg_name r;
+	enum asm_size size;
+
+	// narrow division is performed in 32 bits
+	size = MAX(size2as(MAX(QSRC1(quad)->size, QSRC2(quad)->size)), AS_L);
+
+	// idiv uses rdx:rax as dividend, and can't take an immediate divisor
+	reg_take(AR_A);
+	reg_take(AR_D);
+	m = tile_rm_sized(QSRC2(quad), size);
+	if (m->mode == AAM_IMMEDIATE) {
+		r = reg_get();
+		asm_inst_new(AOC_MOV, m, reg2addr(r, size), size);
+		m = reg2addr(r, size);
+	}
+	tile_reg(QSRC1(quad), AR_A);
+
+	asm_inst_new(size == AS_Q ? AOC_CQTO : AOC_CLTD, NULL, NULL, AS_NONE);
+	asm_inst_new(AOC_DIV, m, NULL, size);
+	asm_inst_new(AOC_MOV, reg2addr(quad->opcode == OC_DIV ? AR_A : AR_D,
+			size2as(QDEST(quad)->size)),
+		slot_operand(QDEST(quad), QDEST(quad)->size),
+		size2as(QDEST(quad)->size));
+}
+
+static void select_cmp(struct quad *quad)
+{
+	struct asm_addr *m;
+	enum asm_reg_name r;
+	enum asm_size size;
+
+	size = size2as(MAX(QSRC1(quad)->size, QSRC2(quad)->size));
+
+	// cmp $imm, r/m
+	if (fits_imm(QSRC2(quad)) && !is_const(QSRC1(quad))
+		&& QSRC1(quad)->size >= QSRC2(quad)->size) {
+		m = tile_rm(QSRC1(quad));
+		asm_inst_new(AOC_CMP, imm_operand(QSRC2(quad)), m, m->size);
+		return;
+	}
+
+	// narrow operands are compared as extended 32-bit values
+	size = MAX(size, AS_L);
+	r = reg_get();
+	tile_reg(QSRC1(quad), r);
+	m = tile_rm_sized(QSRC2(quad), size);
+	asm_inst_new(AOC_CMP, m, reg2addr(r, size), size);
+}
+
+void select_asm_inst(struct quad *quad)
+{
+	union asm_component *before = asm_out, *first;
+	struct asm_addr *m, *dest;
+	enum asm_reg_name r;
+	enum asm_size size;
+
+	// will be emitted at its use
+	if (is_folded(QDEST(quad))) {
+		return;
+	}
+
+	reg_busy = 0;
+
+	switch (quad->opcode) {
+	case OC_MOV:
+	case OC_CAST:
+		dest = slot_operand(QDEST(quad), QDEST(quad)->size);
+
+		// mov $imm, mem (also for a constant that fits in a narrower
+		// destination)
+		if (fits_imm(QSRC1(quad))
+			&& (QSRC1(quad)->size == QDEST(quad)->size
+			|| fits_size(QSRC1(quad), QDEST(quad)->size))) {
+			asm_inst_new(AOC_MOV, imm_operand(QSRC1(quad)), dest,
+				dest->size);
+			break;
+		}
+
+		// truncation into memory: store the low bytes of the source
+		if (QDEST(quad)->size < QSRC1(quad)->size
+			&& !is_const(QSRC1(quad))) {
+			r = reg_get();
+			tile_reg(QSRC1(quad), r);
+			asm_inst_new(AOC_MOV, reg2addr(r, dest->size), dest,
+				dest->size);
+			break;
+		}
+		goto general;
+
+	case OC_ADD:
+	case OC_SUB:
+		dest = slot_operand(QDEST(quad), QDEST(quad)->size);
+
+		// read-modify-write: op src2, mem
+		if (same_storage(QDEST(quad), QSRC1(quad))
+			&& QSRC1(quad)->size == QDEST(quad)->size
+			&& QSRC2(quad)->size == QDEST(quad)->size) {
+			m = tile_rm(QSRC2(quad));
+			if (m->mode == AAM_MEMORY || m->mode == AAM_REG_OFF) {
+				r = reg_get();
+				size = m->size;
+				load_reg(m, size, is_signed(QSRC2(quad)), r);
+				m = reg2addr(r, size);
+			}
+			asm_inst_new(quad->opcode == OC_ADD ? AOC_ADD : AOC_SUB,
+				m, dest, dest->size);
+			break;
+		}
+		goto general;
+
+	case OC_MUL:
+	case OC_LEA:
+	case OC_LOAD:
+		dest = slot_operand(QDEST(quad), QDEST(quad)->size);
+	general:
+		r = reg_get();
+		tile_quad(quad, r);
+		asm_inst_new(AOC_MOV, reg2addr(r, dest->size), dest,
+			dest->size);
+		break;
+
+	case OC_DIV:
+	case OC_MOD:
+		select_div(quad);
+		break;
+
+	case OC_STORE:
+		size = size2as(QSRC1(quad)->size);
+		m = tile_addr(QSRC2(quad), size);
+
+		if (fits_imm(QSRC1(quad))) {
+			asm_inst_new(AOC_MOV, imm_operand(QSRC1(quad)), m,
+				size);
+			break;
+		}
+
+		r = reg_get();
+		tile_reg(QSRC1(quad), r);
+		asm_inst_new(AOC_MOV, reg2addr(r, size), m, size);
+		break;
+
+	case OC_CALL:
+		select_call(quad);
+		break;
+
+	case OC_CMP:
+		select_cmp(quad);
+		break;
+
+	case OC_SETCC:
+		// setcc only writes a byte: zero-extend the result to the
+		// full destination rather than leaving its upper bytes stale
+		r = reg_get();
+		size = size2as(QDEST(quad)->size);
+		asm_inst_new(cc2setcc((enum cc) *QSRC1(quad)->val.constval),
+			reg2addr(r, AS_B), NULL, AS_NONE);
+		asm_inst_new(AOC_MOVZ, reg2addr(r, AS_B), reg2addr(r, AS_L),
+			AS_NONE);
+		asm_inst_new(AOC_MOV, reg2addr(r, size),
+			slot_operand(QDEST(quad), QDEST(quad)->size), size);
+		break;
+
+	case OC_RET:
+		if (QSRC1(quad)) {
+			reg_take(AR_A);
+			tile_reg(QSRC1(quad), AR_A);
+		}
+		asm_inst_new(AOC_LEAVE, NULL, NULL, AS_NONE);
+		asm_inst_new(AOC_RET, NULL, NULL, AS_NONE);
+		break;
+
+	default:
+		yyerror("select_asm_inst: unhandled opcode");
+		return;
+	}
+
+	// annotate first instruction with the quad it implements
+	// (asm_out is built in reverse)
+	for (first = asm_out; first && LL_NEXT(first) != before;
+		first = LL_NEXT(first));
+	if (first && first != before) {
+		ADD_COMMENT(first, opcode2str(quad->opcode));
+	}
+}
+
+/**
+ * FOLDING ANALYSIS
+ */
+
+// quads whose results may be folded into their use
+static int is_foldable(struct quad *q)
+{
+	unsigned size = QDEST(q)->size;
+
+	if (size != 1 && size != 2 && size != 4 && size != 8) {
+		return 0;
+	}
+
+	switch (q->opcode) {
+	case OC_LEA:
+	case OC_LOAD:
+		return 1;
+	case OC_MOV:
+		return QSRC1(q)->size == size;
+	case OC_CAST:
+		return QSRC1(q)->size == 1 || QSRC1(q)->size == 2
+			|| QSRC1(q)->size == 4 || QSRC1(q)->size == 8;
+	case OC_ADD:
+	case OC_SUB:
+	case OC_MUL:
+		return size >= 4 && QSRC1(q)->size == size
+			&& QSRC2(q)->size == size;
+	default:
+		return 0;
+	}
+}
+
+// Sethi-Ullman number (registers needed) of a folded tree
+static int need(struct addr *a)
+{
+	struct quad *q;
+	int64_t val;
+	int l, r;
+
+	// constants become immediates or displacements
+	if (const_fold(a, &val)) {
+		return 0;
+	}
+	if (!is_folded(a)) {
+		return 1;
+	}
+
+	q = a->def;
+	switch (q->opcode) {
+	case OC_LEA:
+		return 1;
+	case OC_ADD:
+	case OC_SUB:
+	case OC_MUL:
+		l = need(QSRC1(q));
+		r = need(QSRC2(q));
+		return l == r ? l + 1 : MAX(l, r);
+	default:
+		return need(QSRC1(q));
+	}
+}
+
+static int quad_uses(struct quad *q, struct addr *a)
+{
+	unsigned i;
+
+	if (q->src1 == a->id) {
+		return 1;
+	}
+	if (q->opcode != OC_CALL) {
+		return q->src2 == a->id;
+	}
+	for (i = 0; i < CALL_ARGC(q); ++i) {
+		if (CALL_ARG(q, i) == a) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int tree_clobbered(struct quad *q, struct quad *def);
+
+/**
+ * whether quad q overwrites a value read by the (possibly folded) operand a;
+ * if so, the operand's expression tree can't be moved past q
+ *
+ * stores and fncalls may write any memory: conservatively assume they clobber
+ * all variables and pointed-to memory
+ */
+static int quad_clobbers(struct quad *q, struct addr *a)
+{
+	if (!a || is_const(a)) {
+		return 0;
+	}
+
+	if (is_folded(a)) {
+		return tree_clobbered(q, a->def);
+	}
+
+	if (QDEST(q) && same_storage(QDEST(q), a)) {
+		return 1;
+	}
+	return a->type == AT_AST
+		&& (q->opcode == OC_STORE || q->opcode == OC_CALL);
+}
+
+// same as quad_clobbers(), for the expression tree rooted at quad def
+static int tree_clobbered(struct quad *q, struct quad *def)
+{
+	switch (def->opcode) {
+	case OC_LEA:
+		// address constant
+		return 0;
+	case OC_LOAD:
+		if (q->opcode == OC_STORE || q->opcode == OC_CALL) {
+			return 1;
+		}
+		return quad_clobbers(q, QSRC1(def));
+	case OC_MOV:
+	case OC_CAST:
+		return quad_clobbers(q, QSRC1(def));
+	default:
+		return quad_clobbers(q, QSRC1(def))
+			|| quad_clobbers(q, QSRC2(def));
+	}
+}
+
+#define COUNT_USE(a) if ((a) && (a)->type == AT_TMP) { ++(a)->uses; }
+
+void isel_analyze(struct basic_block *bb_ll)
+{
+	struct basic_block *bb_iter;
+	struct quad *quad_iter, *iter, *end;
+	struct addr *tmp;
+	unsigned i;
+
+	// each function starts from the same register, so that its code
+	// doesn't depend on the functions generated before it
+	reg_next = 0;
+
+	// count definitions and uses of temporaries
+	_LL_FOR(bb_ll, bb_iter, next) {
+		end = bb_iter->quads + bb_iter->nquads;
+		for (quad_iter = bb_iter->quads; quad_iter < end; ++quad_iter) {
+			if ((tmp = QDEST(quad_iter)) && tmp->type == AT_TMP) {
+				++tmp->defs;
+				tmp->def = quad_iter;
+			}
+
+			COUNT_USE(QSRC1(quad_iter));
+			if (quad_iter->opcode == OC_CALL) {
+				for (i = 0; i < CALL_ARGC(quad_iter); ++i) {
+					COUNT_USE(CALL_ARG(quad_iter, i));
+				}
+			} else {
+				COUNT_USE(QSRC2(quad_iter));
+			}
+		}
+	}
+
+	// fold single-definition, single-use temporaries whose use follows
+	// in the same basic block, if none of the values the expression tree
+	// reads are overwritten in the meantime
+	_LL_FOR(bb_ll, bb_iter, next) {
+		end = bb_iter->quads + bb_iter->nquads;
+		for (quad_iter = bb_iter->quads; quad_iter < end; ++quad_iter) {
+			tmp = QDEST(quad_iter);
+			if (!tmp || tmp->type != AT_TMP || tmp->defs != 1
+				|| tmp->uses != 1 || !is_foldable(quad_iter)) {
+				continue;
+			}
+
+			// tentatively fold to check register pressure
+			tmp->fold = 1;
+			if (need(tmp) > FOLD_MAX_NEED) {
+				tmp->fold = 0;
+				continue;
+			}
+
+			tmp->fold = 0;
+			for (iter = quad_iter + 1; iter < end; ++iter) {
+				if (quad_uses(iter, tmp)) {
+					tmp->fold = 1;
+					break;
+				}
+				if (tree_clobbered(iter, quad_iter)) {
+					break;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,300 @@
+// for RTLD_DEFAULT
+#define _GNU_SOURCE
+
+#include <asmgen/jit.h>
+#include <asmgen/elfobj.h>
+#include <compile.h>
+#include <intern.h>
+#include <arena.h>
+#include <common.h>
+#include <context.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// jmp *0(%rip) followed by the 64-bit target, padded to 16 bytes
+#define STUB_SIZE	16
+static const unsigned char stub_code[] = { 0xff, 0x25, 0, 0, 0, 0 };
+
+struct jit {
+	// translation unit of the code (for its symbols)
+	struct context *ctx;
+
+	// mapping of the code and data, and the address at which each section
+	// was loaded in it
+	unsigned char *mem;
+	size_t size;
+	unsigned char *section_base[OS_COUNT];
+};
+
+// message of the last error on this thread
+static _Thread_local char last_error[256];
+
+static void jit_fail(const char *what, const char *name)
+{
+	snprintf(last_error, sizeof(last_error), "jit: %s%s%s", what,
+		name ? " " : "", name ? name : "");
+}
+
+// map size bytes of read/write memory; if near is nonzero, the memory must be
+// within reach of a 32-bit displacement from that address (an external
+// variable that the code refers to directly)
+static unsigned char *jit_map(size_t size, uint64_t near)
+{
+	uint64_t hint, step = 1 << 28, dist;
+	void *mem;
+	int dir;
+
+	if (!near) {
+		mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return mem == MAP_FAILED ? NULL : mem;
+	}
+
+	// try addresses up to 1.75GB below and above the variable; the hint is
+	// only used if it is free
+	for (dist = step; dist + size < (1ul << 31); dist += step) {
+		for (dir = -1; dir <= 1; dir += 2) {
+			if (dir < 0 && near < dist + size) {
+				continue;
+			}
+			hint = (dir < 0 ? near - dist - size : near + dist)
+				& ~(uint64_t) 0xfff;
+			mem = mmap((void *) hint, size,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mem == MAP_FAILED) {
+				continue;
+			}
+			if ((uint64_t) mem == hint) {
+				return mem;
+			}
+			munmap(mem, size);
+		}
+	}
+	return NULL;
+}
+
+struct jit *jit_load(void)
+{
+	struct obj_file *obj = &cur_ctx->obj;
+	struct obj_sym *sym;
+	struct obj_reloc *reloc;
+	struct jit *jit = NULL;
+	uint64_t *ext_addr, near = 0, s, p;
+	unsigned *stub_of, nstubs = 0, i;
+	size_t page = sysconf(_SC_PAGESIZE), stubs_off, ro_off, rw_off,
+		bss_off, size = 0;
+	unsigned char *mem = NULL;
+	int64_t val;
+	int32_t val32;
+
+	// global .comm variables that the process defines (e.g., stdout) are
+	// shared with it, as the linker would do; all others are allocated here
+	for (i = 0; i < obj->nsyms; ++i) {
+		if (obj->syms[i].common && !obj->syms[i].local
+			&& dlsym(RTLD_DEFAULT, obj->syms[i].name)) {
+			obj->syms[i].common = 0;
+		}
+	}
+	obj_alloc_commons(1);
+
+	// resolve the undefined symbols in this process, and give each called
+	// one a stub
+	ext_addr = calloc(obj->nsyms, sizeof(uint64_t));
+	stub_of = calloc(obj->nsyms, sizeof(unsigned));
+	if ((obj->nsyms && (!ext_addr || !stub_of))
+		|| !(jit = calloc(1, sizeof(struct jit)))) {
+		jit_fail("out of memory", NULL);
+		goto fail;
+	}
+	for (i = 0; i < obj->nrelocs; ++i) {
+		reloc = &obj->relocs[i];
+		sym = &obj->syms[reloc->sym];
+		if (sym->section) {
+			continue;
+		}
+
+		if (!ext_addr[reloc->sym] && !(ext_addr[reloc->sym] =
+			(uint64_t) dlsym(RTLD_DEFAULT, sym->name))) {
+			jit_fail("undefined symbol", sym->name);
+			goto fail;
+		}
+
+		if (reloc->type == R_X86_64_PLT32) {
+			if (!stub_of[reloc->sym]) {
+				stub_of[reloc->sym] = ++nstubs;
+			}
+		} else if (!near) {
+			near = ext_addr[reloc->sym];
+		}
+	}
+
+	// layout: code and stubs (read/execute), then .rodata and
+	// .rodata.str1.1 (read-only), then .data and .bss (read/write)
+	stubs_off = ALIGN_UP(obj->sections[OS_TEXT].len, STUB_SIZE);
+	ro_off = ALIGN_UP(stubs_off + nstubs * STUB_SIZE, page);
+	rw_off = ALIGN_UP(ro_off + obj->sections[OS_RODATA].len
+		+ obj->sections[OS_RODATA_STR].len, page);
+	bss_off = ALIGN_UP(rw_off + obj->sections[OS_DATA].len,
+		MAX(obj->bss_align, 16));
+	size = MAX(ALIGN_UP(bss_off + obj->bss_size, page), page);
+
+	if (!(mem = jit_map(size, near))) {
+		jit_fail("could not map memory for the code", NULL);
+		goto fail;
+	}
+
+	jit->section_base[OS_TEXT] = mem;
+	jit->section_base[OS_RODATA] = mem + ro_off;
+	jit->section_base[OS_RODATA_STR] = mem + ro_off
+		+ obj->sections[OS_RODATA].len;
+	jit->section_base[OS_DATA] = mem + rw_off;
+	jit->section_base[OS_BSS] = mem + bss_off;
+	for (i = OS_TEXT; i < OS_COUNT; ++i) {
+		if (jit->section_base[i] && i != OS_BSS
+			&& obj->sections[i].len) {
+			memcpy(jit->section_base[i], obj->sections[i].data,
+				obj->sections[i].len);
+		}
+	}
+
+	// stubs
+	for (i = 0; i < obj->nsyms; ++i) {
+		if (stub_of[i]) {
+			p = stubs_off + (stub_of[i] - 1) * STUB_SIZE;
+			memcpy(mem + p, stub_code, sizeof(stub_code));
+			memcpy(mem + p + sizeof(stub_code), &ext_addr[i], 8);
+		}
+	}
+
+	// relocations: S + A - P, where calls to undefined functions go to
+	// their stubs
+	for (i = 0; i < obj->nrelocs; ++i) {
+		reloc = &obj->relocs[i];
+		sym = &obj->syms[reloc->sym];
+		p = (uint64_t) mem + reloc->offset;
+
+		if (sym->section) {
+			s = (uint64_t) jit->section_base[sym->section]
+				+ sym->value;
+		} else if (reloc->type == R_X86_64_PLT32) {
+			s = (uint64_t) mem + stubs_off
+				+ (stub_of[reloc->sym] - 1) * STUB_SIZE;
+		} else {
+			s = ext_addr[reloc->sym];
+		}
+
+		val = s + reloc->addend - p;
+		if (val < INT32_MIN || val > INT32_MAX) {
+			jit_fail("relocation out of range for", sym->name);
+			goto fail;
+		}
+		val32 = val;
+		memcpy(mem + reloc->offset, &val32, 4);
+	}
+
+	if (mprotect(mem, ro_off, PROT_READ | PROT_EXEC)
+		|| (rw_off > ro_off
+			&& mprotect(mem + ro_off, rw_off - ro_off, PROT_READ))) {
+		jit_fail("could not make the code executable", NULL);
+		goto fail;
+	}
+
+	free(ext_addr);
+	free(stub_of);
+	jit->ctx = cur_ctx;
+	jit->mem = mem;
+	jit->size = size;
+	return jit;
+
+fail:
+	if (mem) {
+		munmap(mem, size);
+	}
+	free(ext_addr);
+	free(stub_of);
+	free(jit);
+	return NULL;
+}
+
+struct jit *jit_compile(const char *src, size_t len)
+{
+	struct context *prev_ctx = cur_ctx, *ctx;
+	struct arena *prev_arena = cur_arena;
+	struct jit *jit;
+	jmp_buf env;
+
+	if (!dfp) {
+		dfp = stderr;
+	}
+
+	// (functions are generated as they are parsed, on this thread)
+	ctx = begin_unit(NULL);
+	ctx->jit = 1;
+	ctx->error_jmp = &env;
+	if (setjmp(env)) {
+		// drop the function that was being parsed or generated
+		if (cur_arena != &ctx->file_arena) {
+			fn_arena_release(cur_arena);
+		}
+		snprintf(last_error, sizeof(last_error), "%s", ctx->error);
+		lex_unmap();
+		context_free(ctx);
+		jit = NULL;
+		goto done;
+	}
+
+	parse_string(src, len);
+	end_unit();
+	ctx->error_jmp = NULL;
+	jit = jit_load();
+
+	// a function that the parser gave up on after a syntax error leaves
+	// its arena current
+	if (cur_arena != &ctx->file_arena) {
+		fn_arena_release(cur_arena);
+	}
+	if (!jit) {
+		context_free(ctx);
+	}
+
+done:
+	cur_ctx = prev_ctx;
+	cur_arena = prev_arena;
+	return jit;
+}
+
+void *jit_lookup(struct jit *jit, const char *name)
+{
+	struct context *ctx = cur_ctx;
+	struct obj_sym *sym;
+
+	// (the symbols are interned in the unit of the code)
+	cur_ctx = jit->ctx;
+	sym = obj_sym_lookup(intern(name));
+	cur_ctx = ctx;
+
+	if (!sym || !sym->section) {
+		return NULL;
+	}
+	return jit->section_base[sym->section] + sym->value;
+}
+
+void jit_free(struct jit *jit)
+{
+	munmap(jit->mem, jit->size);
+	context_free(jit->ctx);
+	free(jit);
+}
+
+const char *jit_error(void)
+{
+	return last_error;
+}
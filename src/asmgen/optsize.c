@@ -0,0 +1,536 @@
+#include <asmgen/asm.h>
+#include <asmgen/optsize.h>
+#include <parser/astnode.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// estimated size of a (short) jump; all functions are assumed small enough
+// that the assembler can relax branches to their 8-bit displacement forms
+#define JMP_SIZE	2
+
+/**
+ * SIZE ESTIMATION
+ */
+
+static int64_t imm_val(struct asm_addr *op)
+{
+	return (int64_t) *((uint64_t *)op->value.addr->val.constval);
+}
+
+static int is_imm(struct asm_addr *op)
+{
+	return op && op->mode == AAM_IMMEDIATE;
+}
+
+static int is_reg(struct asm_addr *op)
+{
+	return op && op->mode == AAM_REGISTER;
+}
+
+static int disp_size(int disp)
+{
+	return disp >= INT8_MIN && disp <= INT8_MAX ? 1 : 4;
+}
+
+// registers that can only be encoded with a REX prefix
+static int reg_rex(enum asm_reg_name r, enum asm_size size)
+{
+	return r >= AR_8 || (size == AS_B && (r == AR_SI || r == AR_DI
+		|| r == AR_SP || r == AR_BP));
+}
+
+static int operand_rex(struct asm_addr *op)
+{
+	if (!op) {
+		return 0;
+	}
+
+	switch (op->mode) {
+	case AAM_REGISTER:
+		return reg_rex(op->value.reg.name, op->value.reg.size);
+	case AAM_INDIRECT:
+		return op->value.reg.name >= AR_8;
+	case AAM_REG_OFF:
+		return (op->value.mem.has_base && op->value.mem.base >= AR_8)
+			|| (op->value.mem.has_index
+				&& op->value.mem.index >= AR_8);
+	default:
+		return 0;
+	}
+}
+
+// size of the ModRM byte, SIB byte, and displacement for an r/m operand
+static int rm_size(struct asm_addr *op)
+{
+	struct asm_mem *mem;
+	union astnode *decl, *sc;
+	int size;
+
+	switch (op->mode) {
+	case AAM_REGISTER:
+		return 1;
+
+	case AAM_INDIRECT:
+		// (%rsp), (%r12) need a SIB byte, (%rbp), (%r13) a disp8
+		return 1 + (op->value.reg.name == AR_SP
+			|| op->value.reg.name == AR_12
+			|| op->value.reg.name == AR_BP
+			|| op->value.reg.name == AR_13);
+
+	case AAM_MEMORY:
+		// temporary or local variable: disp(%rbp); global: sym(%rip)
+		if (op->value.addr->type == AT_TMP) {
+			return 1 + disp_size(op->value.addr->offset);
+		}
+		decl = op->value.addr->val.astnode;
+		sc = decl->decl.is_string ? NULL
+			: decl->decl.declspec->declspec.sc;
+		if (sc && sc->sc.scspec != SC_EXTERN
+			&& sc->sc.scspec != SC_STATIC) {
+			return 1 + disp_size(decl->decl.offset);
+		}
+		return 5;
+
+	case AAM_REG_OFF:
+		mem = &op->value.mem;
+		if (mem->sym) {
+			return 5;
+		}
+		if (!mem->has_base) {
+			return 6;
+		}
+
+		size = 1;
+		if (mem->has_index || mem->base == AR_SP
+			|| mem->base == AR_12) {
+			++size;
+		}
+		if (mem->disp || mem->base == AR_BP || mem->base == AR_13) {
+			size += disp_size(mem->disp);
+		}
+		return size;
+
+	default:
+		return 0;
+	}
+}
+
+// size of an immediate operand in an instruction of the given size; most ALU
+// instructions have a sign-extended 8-bit immediate form
+static int imm_size(struct asm_addr *op, enum asm_size size, int imm8)
+{
+	int64_t val = imm_val(op);
+
+	if (size == AS_B || (imm8 && val >= INT8_MIN && val <= INT8_MAX)) {
+		return 1;
+	}
+	return size == AS_W ? 2 : 4;
+}
+
+int asm_inst_size(struct asm_inst *inst)
+{
+	struct asm_addr *src = inst->src, *dest = inst->dest;
+	int size, prefix;
+
+	// operand-size and REX prefixes
+	prefix = (inst->size == AS_W) + (inst->size == AS_Q
+		|| operand_rex(src) || operand_rex(dest));
+
+	switch (inst->oc) {
+	case AOC_LEAVE:
+	case AOC_RET:
+	case AOC_CLTD:
+		return 1;
+	case AOC_CLTQ:
+	case AOC_CQTO:
+		return 2;
+
+	case AOC_PUSH:
+	case AOC_POP:
+		return 1 + operand_rex(src);
+
+	case AOC_CALL:
+		return 5;
+
+	case AOC_JMP: case AOC_JE: case AOC_JNE:
+	case AOC_JL: case AOC_JLE: case AOC_JG: case AOC_JGE:
+		return JMP_SIZE;
+
+	case AOC_SETE: case AOC_SETNE: case AOC_SETL:
+	case AOC_SETLE: case AOC_SETG: case AOC_SETGE:
+		return operand_rex(src) + 2 + rm_size(src);
+
+	// movslq is a single-byte opcode, other movs/movz two bytes; the
+	// instruction size is taken from the operands
+	case AOC_MOVS:
+	case AOC_MOVZ:
+		size = (inst->oc == AOC_MOVS && src->size == AS_L) ? 1 : 2;
+		return (dest->size == AS_Q || operand_rex(src)
+			|| operand_rex(dest)) + size + rm_size(src);
+
+	case AOC_MOV:
+		if (is_imm(src) && is_reg(dest)) {
+			// mov $imm, %reg has no ModRM byte; 64-bit registers
+			// use a sign-extended imm32 (or movabs)
+			if (inst->size != AS_Q) {
+				return prefix + 1 + imm_size(src, inst->size, 0);
+			}
+			return imm_val(src) >= INT32_MIN
+				&& imm_val(src) <= INT32_MAX ? 7 : 10;
+		}
+		if (is_imm(src)) {
+			return prefix + 1 + rm_size(dest)
+				+ imm_size(src, inst->size, 0);
+		}
+		return prefix + 1 + rm_size(is_reg(src) ? dest : src);
+
+	case AOC_LEA:
+		return prefix + 1 + rm_size(src);
+
+	case AOC_ADD:
+	case AOC_SUB:
+	case AOC_CMP:
+	case AOC_XOR:
+		if (is_imm(src)) {
+			return prefix + 1 + rm_size(dest)
+				+ imm_size(src, inst->size, 1);
+		}
+		return prefix + 1 + rm_size(is_reg(src) ? dest : src);
+
+	case AOC_MUL:
+		return prefix + 2 + rm_size(src);
+
+	case AOC_DIV:
+	case AOC_INC:
+	case AOC_DEC:
+		return prefix + 1 + rm_size(src);
+
+	default:
+		return prefix + 1 + (src ? rm_size(src) : 0);
+	}
+}
+
+int asm_code_size(union asm_component *code)
+{
+	union asm_component *iter;
+	int size = 0;
+
+	LL_FOR(code, iter) {
+		if (iter->generic.type == ACT_INST) {
+			size += asm_inst_size(&iter->inst);
+		}
+	}
+	return size;
+}
+
+/**
+ * PEEPHOLE: SHORTER ENCODINGS
+ */
+
+static int reads_flags(struct asm_inst *inst)
+{
+	switch (inst->oc) {
+	case AOC_JE: case AOC_JNE: case AOC_JL:
+	case AOC_JLE: case AOC_JG: case AOC_JGE:
+	case AOC_SETE: case AOC_SETNE: case AOC_SETL:
+	case AOC_SETLE: case AOC_SETG: case AOC_SETGE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int writes_flags(struct asm_inst *inst)
+{
+	switch (inst->oc) {
+	case AOC_ADD: case AOC_SUB: case AOC_MUL: case AOC_DIV:
+	case AOC_CMP: case AOC_XOR: case AOC_INC: case AOC_DEC:
+	case AOC_CALL:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// substitute shorter instructions: since asm_out is in reverse order, the
+// flags liveness can be computed along the way
+static void shorten_insts(void)
+{
+	union asm_component *iter;
+	struct asm_inst *inst;
+	int flags_live = 0;
+
+	LL_FOR(asm_out, iter) {
+		// the flags are never live across basic block boundaries
+		// (every conditional branch is preceded by its cmp in the
+		// same block)
+		if (iter->generic.type != ACT_INST) {
+			flags_live = 0;
+			continue;
+		}
+		inst = &iter->inst;
+
+		switch (inst->oc) {
+		// add $1 => inc, sub $1 => dec (these don't set the carry
+		// flag, but only signed condition codes are ever used)
+		case AOC_ADD:
+		case AOC_SUB:
+			if (is_imm(inst->src) && imm_val(inst->src) == 1) {
+				inst->oc = inst->oc == AOC_ADD
+					? AOC_INC : AOC_DEC;
+				inst->src = inst->dest;
+				inst->dest = NULL;
+			}
+			break;
+
+		case AOC_MOV:
+			if (!is_imm(inst->src) || !is_reg(inst->dest)
+				|| inst->src->value.addr->type != AT_CONST) {
+				break;
+			}
+
+			// mov $0, %reg => xor %reg, %reg (which clobbers
+			// the flags)
+			if (!imm_val(inst->src) && !flags_live) {
+				inst->oc = AOC_XOR;
+				inst->size = AS_L;
+				inst->src = reg2addr(inst->dest->value.reg.name,
+					AS_L);
+				inst->dest = reg2addr(inst->dest->value.reg.name,
+					AS_L);
+			}
+
+			// movq $imm, %reg => movl $imm, %reg (zero-extends)
+			else if (inst->size == AS_Q
+				&& (uint64_t) imm_val(inst->src) <= UINT32_MAX) {
+				inst->size = AS_L;
+				inst->dest = reg2addr(inst->dest->value.reg.name,
+					AS_L);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (inst->oc == AOC_JMP || writes_flags(inst)) {
+			flags_live = 0;
+		}
+		if (reads_flags(inst)) {
+			flags_live = 1;
+		}
+	}
+}
+
+// allocate a small stack frame with push %rax (1 byte per 8 bytes) rather
+// than sub $n, %rsp (4 bytes); the frame is torn down by leave regardless
+static void shorten_prologue(void)
+{
+	union asm_component *iter, **link, *push;
+	struct asm_inst *inst;
+	int64_t frame_size;
+
+	for (link = &asm_out; (iter = *link); link = &LL_NEXT(iter)) {
+		if (iter->generic.type != ACT_INST) {
+			continue;
+		}
+		inst = &iter->inst;
+		if (inst->oc == AOC_SUB && is_reg(inst->dest)
+			&& inst->dest->value.reg.name == AR_SP
+			&& is_imm(inst->src)) {
+			break;
+		}
+	}
+	if (!iter || (frame_size = imm_val(inst->src)) > 16) {
+		return;
+	}
+
+	// no locals: no frame to allocate
+	if (!frame_size) {
+		*link = LL_NEXT(iter);
+		return;
+	}
+
+	inst->oc = AOC_PUSH;
+	inst->src = reg2addr(AR_A, AS_Q);
+	inst->dest = NULL;
+	if (frame_size > 8) {
+		ALLOC_AC(push, ACT_INST);
+		push->inst = *inst;
+		LL_NEXT(push) = LL_NEXT(iter);
+		LL_NEXT(iter) = push;
+	}
+}
+
+/**
+ * TAIL MERGING
+ */
+
+static int asm_addr_equal(struct asm_addr *a, struct asm_addr *b)
+{
+	struct addr *qa, *qb;
+
+	if (!a || !b) {
+		return a == b;
+	}
+	if (a->mode != b->mode || a->size != b->size) {
+		return 0;
+	}
+
+	switch (a->mode) {
+	case AAM_REGISTER:
+	case AAM_INDIRECT:
+		return a->value.reg.name == b->value.reg.name
+			&& a->value.reg.size == b->value.reg.size;
+
+	case AAM_IMMEDIATE:
+		qa = a->value.addr;
+		qb = b->value.addr;
+		return qa->type == AT_CONST && qb->type == AT_CONST
+			&& !memcmp(qa->val.constval, qb->val.constval, 8);
+
+	case AAM_MEMORY:
+		qa = a->value.addr;
+		qb = b->value.addr;
+		if (qa->type == AT_TMP || qb->type == AT_TMP) {
+			return qa->type == qb->type && qa->offset == qb->offset;
+		}
+		return qa->val.astnode == qb->val.astnode;
+
+	case AAM_REG_OFF:
+		return (a->value.mem.sym && b->value.mem.sym
+			? a->value.mem.sym->val.astnode
+				== b->value.mem.sym->val.astnode
+			: a->value.mem.sym == b->value.mem.sym)
+			&& a->value.mem.has_base == b->value.mem.has_base
+			&& (!a->value.mem.has_base
+				|| a->value.mem.base == b->value.mem.base)
+			&& a->value.mem.has_index == b->value.mem.has_index
+			&& (!a->value.mem.has_index
+				|| (a->value.mem.index == b->value.mem.index
+				&& a->value.mem.scale == b->value.mem.scale))
+			&& a->value.mem.disp == b->value.mem.disp;
+
+	case AAM_LABEL:
+		// (a block's label is one shared string)
+		return a->value.label == b->value.label;
+
+	default:
+		return 0;
+	}
+}
+
+static int asm_inst_equal(struct asm_inst *a, struct asm_inst *b)
+{
+	return a->oc == b->oc && a->size == b->size
+		&& asm_addr_equal(a->src, b->src)
+		&& asm_addr_equal(a->dest, b->dest);
+}
+
+/**
+ * length of the common tail of two instruction sequences (which are walked
+ * backwards in program order, i.e., forwards in the reversed asm_out)
+ *
+ * the tail of b (which will be removed) may not contain a label, since there
+ * may be jumps to it; labels in the tail of a are simply passed over
+ *
+ * @param a		last instruction of the sequence to keep
+ * @param b		last instruction of the sequence to replace
+ * @param a_end		set to the first instruction (in program order) of the
+ * 			common tail of a
+ * @param b_end		same, for b
+ * @return		size in bytes of the common tail
+ */
+static int common_tail(union asm_component *a, union asm_component *b,
+	union asm_component **a_end, union asm_component **b_end)
+{
+	int size = 0;
+
+	*a_end = *b_end = NULL;
+	while (a && b && a != b && b->generic.type == ACT_INST) {
+		if (a->generic.type != ACT_INST) {
+			a = LL_NEXT(a);
+			continue;
+		}
+		if (!asm_inst_equal(&a->inst, &b->inst)) {
+			break;
+		}
+
+		size += asm_inst_size(&b->inst);
+		*a_end = a;
+		*b_end = b;
+		a = LL_NEXT(a);
+		b = LL_NEXT(b);
+	}
+	return size;
+}
+
+// merge identical instruction sequences ending in ret: all but the last
+// (in program order) are replaced by a jump into the last one
+static void merge_tails(char *fnname)
+{
+	union asm_component *iter, **link, **rets, *a_end, *b_end,
+		*best_end, *label, *jmp;
+	struct asm_addr *target;
+	int count = 0, nrets = 0, ntails = 0, i, size, best, best_size;
+	char buf[256];
+
+	LL_FOR(asm_out, iter) {
+		++count;
+	}
+	rets = malloc(count * sizeof(union asm_component *));
+
+	for (link = &asm_out; (iter = *link); link = &LL_NEXT(*link)) {
+		if (iter->generic.type != ACT_INST || iter->inst.oc != AOC_RET) {
+			continue;
+		}
+
+		// find the earlier-seen (later in program order) ret with the
+		// longest common tail
+		best = -1;
+		best_size = JMP_SIZE;
+		for (i = 0; i < nrets; ++i) {
+			size = common_tail(rets[i], iter, &a_end, &b_end);
+			if (size > best_size) {
+				best = i;
+				best_size = size;
+				best_end = a_end;
+			}
+		}
+
+		if (best < 0) {
+			rets[nrets++] = iter;
+			continue;
+		}
+
+		// label the start of the tail to keep
+		common_tail(rets[best], iter, &a_end, &b_end);
+		snprintf(buf, sizeof(buf), ".BB.%s.tail%d", fnname, ntails++);
+		ALLOC_AC(label, ACT_LABEL);
+		label->label.name = arena_strdup(cur_arena, buf);
+		LL_NEXT(label) = LL_NEXT(best_end);
+		LL_NEXT(best_end) = label;
+
+		// replace this tail with a jump to it
+		target = ARENA_NEW(struct asm_addr);
+		target->mode = AAM_LABEL;
+		target->size = AS_Q;
+		target->value.label = label->label.name;
+		ALLOC_AC(jmp, ACT_INST);
+		jmp->inst.oc = AOC_JMP;
+		jmp->inst.src = target;
+		jmp->inst.size = AS_NONE;
+		LL_NEXT(jmp) = LL_NEXT(b_end);
+		*link = jmp;
+	}
+
+	free(rets);
+}
+
+void optimize_size_asm(char *fnname)
+{
+	merge_tails(fnname);
+	shorten_insts();
+	shorten_prologue();
+}
@@ -0,0 +1,465 @@
+#include <asmgen/asm.h>
+#include <asmgen/sched.h>
+#include <parser/astnode.h>
+#include <limits.h>
+#include <stdlib.h>
+
+// maximum number of instructions scheduled together (the dependence graph is
+// quadratic in size); longer regions are split
+#define SCHED_WINDOW	256
+
+// latency model (in cycles), roughly that of a modern x86_64 core
+#define LAT_ALU		1	// add, sub, xor, cmp, lea, mov, setcc
+#define LAT_MUL		3	// imul
+#define LAT_DIV		26	// idivl
+#define LAT_DIVQ	40	// idivq
+#define LAT_LOAD	4	// load from simple address
+#define LAT_LOAD_IDX	5	// load from indexed address
+
+// register and condition code bits for dependence tracking
+#define REG_BIT(r)	(1u << (r))
+#define FLAGS		(1u << 16)
+
+/**
+ * memory location accessed by an instruction, for (simple) alias analysis
+ *
+ * MR_TMP and MR_FRAME are rbp-relative with a known offset (temporaries and
+ * local variables); MR_FRAME_ANY is an rbp-relative access at an unknown
+ * offset (indexing into a local array); MR_GLOBAL is a rip-relative access to
+ * a symbol; MR_UNKNOWN is an access through a pointer. The address of a
+ * temporary is never taken, so a temporary never aliases a pointer access.
+ */
+struct mem_ref {
+	enum { MR_NONE, MR_TMP, MR_FRAME, MR_FRAME_ANY, MR_GLOBAL, MR_UNKNOWN }
+		kind;
+	union astnode *sym;
+	int off, size;
+};
+
+struct sched_node {
+	union asm_component *inst;
+
+	// registers (and flags) read and written, memory read and written
+	unsigned uses, defs;
+	struct mem_ref load, store;
+
+	int latency;
+
+	// whether the flags written by this instruction are read later; dead
+	// flags definitions may be reordered among themselves
+	int flags_live;
+
+	// priority (critical path length to end of region), earliest cycle
+	// the instruction may issue, and number of unscheduled predecessors
+	int prio, earliest, npreds, done;
+};
+
+static int asm_size_bytes(enum asm_size size)
+{
+	switch (size) {
+	case AS_B:	return 1;
+	case AS_W:	return 2;
+	case AS_L:	return 4;
+	default:	return 8;
+	}
+}
+
+static void mem_classify(struct asm_addr *op, struct mem_ref *ref)
+{
+	struct addr *a;
+	union astnode *decl, *sc;
+	struct asm_mem *mem;
+
+	ref->size = asm_size_bytes(op->size);
+	ref->kind = MR_UNKNOWN;
+
+	switch (op->mode) {
+	case AAM_MEMORY:
+		a = op->value.addr;
+		if (a->type == AT_TMP) {
+			ref->kind = MR_TMP;
+			ref->off = a->offset;
+			return;
+		}
+
+		decl = a->val.astnode;
+		sc = decl->decl.is_string ? NULL
+			: decl->decl.declspec->declspec.sc;
+		if (sc && sc->sc.scspec != SC_EXTERN
+			&& sc->sc.scspec != SC_STATIC) {
+			ref->kind = MR_FRAME;
+			ref->off = decl->decl.offset;
+		} else {
+			ref->kind = MR_GLOBAL;
+			ref->sym = decl;
+			ref->off = 0;
+		}
+		return;
+
+	case AAM_REG_OFF:
+		mem = &op->value.mem;
+		if (mem->sym) {
+			ref->kind = MR_GLOBAL;
+			ref->sym = mem->sym->val.astnode;
+			ref->off = mem->disp;
+		} else if (mem->has_base && mem->base == AR_BP) {
+			ref->kind = mem->has_index ? MR_FRAME_ANY : MR_FRAME;
+			ref->off = mem->disp;
+		}
+		return;
+
+	default:
+		return;
+	}
+}
+
+static int overlap(struct mem_ref *a, struct mem_ref *b)
+{
+	return a->off < b->off + b->size && b->off < a->off + a->size;
+}
+
+// whether two memory accesses may refer to the same location
+static int may_alias(struct mem_ref *a, struct mem_ref *b)
+{
+	struct mem_ref *t;
+
+	if (a->kind == MR_NONE || b->kind == MR_NONE) {
+		return 0;
+	}
+
+	// order the pair so that a->kind <= b->kind
+	if (a->kind > b->kind) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	switch (a->kind) {
+	case MR_TMP:
+		return (b->kind == MR_TMP || b->kind == MR_FRAME)
+			&& overlap(a, b);
+	case MR_FRAME:
+		return b->kind == MR_FRAME ? overlap(a, b)
+			: b->kind != MR_GLOBAL;
+	case MR_FRAME_ANY:
+		return b->kind != MR_GLOBAL;
+	case MR_GLOBAL:
+		return b->kind == MR_UNKNOWN
+			|| (a->sym == b->sym && overlap(a, b));
+	default:
+		return 1;
+	}
+}
+
+// registers used to form the address of a memory operand
+static void addr_uses(struct sched_node *n, struct asm_addr *op)
+{
+	switch (op->mode) {
+	case AAM_INDIRECT:
+		n->uses |= REG_BIT(op->value.reg.name);
+		break;
+	case AAM_REG_OFF:
+		if (op->value.mem.has_base) {
+			n->uses |= REG_BIT(op->value.mem.base);
+		}
+		if (op->value.mem.has_index) {
+			n->uses |= REG_BIT(op->value.mem.index);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static int is_mem(struct asm_addr *op)
+{
+	return op->mode == AAM_MEMORY || op->mode == AAM_REG_OFF
+		|| op->mode == AAM_INDIRECT;
+}
+
+// source operand: read
+static void operand_use(struct sched_node *n, struct asm_addr *op)
+{
+	if (op->mode == AAM_REGISTER) {
+		n->uses |= REG_BIT(op->value.reg.name);
+	} else if (is_mem(op)) {
+		addr_uses(n, op);
+		mem_classify(op, &n->load);
+	}
+}
+
+// destination operand: written, and also read if rmw
+static void operand_def(struct sched_node *n, struct asm_addr *op, int rmw)
+{
+	if (op->mode == AAM_REGISTER) {
+		n->defs |= REG_BIT(op->value.reg.name);
+		if (rmw) {
+			n->uses |= REG_BIT(op->value.reg.name);
+		}
+	} else if (is_mem(op)) {
+		addr_uses(n, op);
+		mem_classify(op, &n->store);
+		if (rmw) {
+			n->load = n->store;
+		}
+	}
+}
+
+// instructions that cannot be moved, and which nothing can move across
+static int is_barrier(union asm_component *c)
+{
+	if (c->generic.type != ACT_INST) {
+		return 1;
+	}
+
+	switch (c->inst.oc) {
+	case AOC_MOV: case AOC_MOVS: case AOC_MOVZ: case AOC_LEA:
+	case AOC_ADD: case AOC_SUB: case AOC_MUL: case AOC_XOR:
+	case AOC_CMP: case AOC_DIV: case AOC_CLTD: case AOC_CQTO:
+	case AOC_CLTQ: case AOC_SETE: case AOC_SETNE: case AOC_SETL:
+	case AOC_SETLE: case AOC_SETG: case AOC_SETGE:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+// determine the dependences and latency of an instruction
+static void inst_info(struct sched_node *n)
+{
+	struct asm_inst *inst = &n->inst->inst;
+
+	n->latency = LAT_ALU;
+
+	switch (inst->oc) {
+	case AOC_MOV:
+	case AOC_MOVS:
+	case AOC_MOVZ:
+		operand_use(n, inst->src);
+		operand_def(n, inst->dest, 0);
+		break;
+
+	case AOC_LEA:
+		addr_uses(n, inst->src);
+		operand_def(n, inst->dest, 0);
+		break;
+
+	case AOC_MUL:
+		n->latency = LAT_MUL;
+		// fallthrough
+	case AOC_ADD:
+	case AOC_SUB:
+	case AOC_XOR:
+		// xor %reg, %reg is a zeroing idiom with no input dependence
+		if (inst->oc == AOC_XOR && inst->src->mode == AAM_REGISTER
+			&& inst->dest->mode == AAM_REGISTER
+			&& inst->src->value.reg.name
+				== inst->dest->value.reg.name) {
+			operand_def(n, inst->dest, 0);
+		} else {
+			operand_use(n, inst->src);
+			operand_def(n, inst->dest, 1);
+		}
+		n->defs |= FLAGS;
+		break;
+
+	case AOC_CMP:
+		operand_use(n, inst->src);
+		operand_use(n, inst->dest);
+		n->defs |= FLAGS;
+		break;
+
+	case AOC_DIV:
+		n->latency = inst->size == AS_Q ? LAT_DIVQ : LAT_DIV;
+		operand_use(n, inst->src);
+		n->uses |= REG_BIT(AR_A) | REG_BIT(AR_D);
+		n->defs |= REG_BIT(AR_A) | REG_BIT(AR_D) | FLAGS;
+		break;
+
+	case AOC_CLTD:
+	case AOC_CQTO:
+		n->uses |= REG_BIT(AR_A);
+		n->defs |= REG_BIT(AR_D);
+		break;
+
+	case AOC_CLTQ:
+		n->uses |= REG_BIT(AR_A);
+		n->defs |= REG_BIT(AR_A);
+		break;
+
+	// setcc
+	default:
+		n->uses |= FLAGS;
+		operand_def(n, inst->dest ? inst->dest : inst->src, 0);
+		break;
+	}
+
+	if (n->load.kind != MR_NONE) {
+		n->latency += n->load.kind == MR_FRAME_ANY
+			|| (n->load.kind == MR_UNKNOWN
+				&& inst->src->mode == AAM_REG_OFF
+				&& inst->src->value.mem.has_index)
+			? LAT_LOAD_IDX : LAT_LOAD;
+	}
+}
+
+// latency of the dependence of b on a (which precedes it), or -1 if none
+static int dep_latency(struct sched_node *a, struct sched_node *b)
+{
+	unsigned waw = a->defs & b->defs;
+	int lat = -1;
+
+	if (!a->flags_live && !b->flags_live) {
+		waw &= ~FLAGS;
+	}
+
+	// read after write
+	if ((a->defs & b->uses) || may_alias(&a->store, &b->load)) {
+		lat = a->latency;
+	}
+	// write after write
+	else if (waw || may_alias(&a->store, &b->store)) {
+		lat = 1;
+	}
+	// write after read
+	else if ((a->uses & b->defs) || may_alias(&a->load, &b->store)) {
+		lat = 0;
+	}
+
+	return lat;
+}
+
+// list-schedule a region of (non-barrier) instructions in place; flags_live
+// indicates whether the flags are read after the region
+static void schedule_region(union asm_component **insts, int n, int flags_live)
+{
+	struct sched_node *nodes;
+	short *dep;
+	int i, j, k, best, cycle, next;
+
+	if (n < 2) {
+		return;
+	}
+
+	nodes = calloc(n, sizeof(struct sched_node));
+	dep = malloc(n * n * sizeof(short));
+
+	for (i = 0; i < n; ++i) {
+		nodes[i].inst = insts[i];
+		inst_info(&nodes[i]);
+	}
+
+	// flags liveness
+	for (i = n - 1; i >= 0; --i) {
+		if (nodes[i].defs & FLAGS) {
+			nodes[i].flags_live = flags_live;
+			flags_live = 0;
+		}
+		if (nodes[i].uses & FLAGS) {
+			flags_live = 1;
+		}
+	}
+
+	// build dependence graph
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < n; ++j) {
+			dep[i * n + j] = j > i
+				? dep_latency(&nodes[i], &nodes[j]) : -1;
+			if (dep[i * n + j] >= 0) {
+				++nodes[j].npreds;
+			}
+		}
+	}
+
+	// priority: latency-weighted longest path to the end of the region
+	for (i = n - 1; i >= 0; --i) {
+		nodes[i].prio = nodes[i].latency;
+		for (j = i + 1; j < n; ++j) {
+			if (dep[i * n + j] >= 0) {
+				nodes[i].prio = MAX(nodes[i].prio,
+					dep[i * n + j] + nodes[j].prio);
+			}
+		}
+	}
+
+	// issue one instruction per cycle: the ready instruction with the
+	// highest priority (ties broken by original order)
+	cycle = 0;
+	for (k = 0; k < n; ) {
+		best = -1;
+		next = INT_MAX;
+		for (i = 0; i < n; ++i) {
+			if (nodes[i].done || nodes[i].npreds) {
+				continue;
+			}
+			if (nodes[i].earliest > cycle) {
+				next = MIN(next, nodes[i].earliest);
+			} else if (best < 0 || nodes[i].prio > nodes[best].prio) {
+				best = i;
+			}
+		}
+
+		// nothing ready: stall until something is
+		if (best < 0) {
+			cycle = next;
+			continue;
+		}
+
+		insts[k++] = nodes[best].inst;
+		nodes[best].done = 1;
+		for (j = best + 1; j < n; ++j) {
+			if (dep[best * n + j] >= 0) {
+				--nodes[j].npreds;
+				nodes[j].earliest = MAX(nodes[j].earliest,
+					cycle + dep[best * n + j]);
+			}
+		}
+		++cycle;
+	}
+
+	free(nodes);
+	free(dep);
+}
+
+void schedule_asm(union asm_component *mark, int flags_live)
+{
+	union asm_component **insts, *iter;
+	int count, start, i;
+
+	count = 0;
+	for (iter = asm_out; iter != mark; iter = LL_NEXT(iter)) {
+		++count;
+	}
+	if (count < 2) {
+		return;
+	}
+
+	// get instructions in program order (asm_out is built in reverse)
+	insts = malloc(count * sizeof(union asm_component *));
+	i = count;
+	for (iter = asm_out; iter != mark; iter = LL_NEXT(iter)) {
+		insts[--i] = iter;
+	}
+
+	// schedule each region between barriers
+	start = 0;
+	for (i = 0; i <= count; ++i) {
+		if (i == count || is_barrier(insts[i])) {
+			schedule_region(insts + start, i - start,
+				i == count && flags_live);
+			start = i + 1;
+		} else if (i - start == SCHED_WINDOW) {
+			// keep everything that may depend on the flags in order
+			schedule_region(insts + start, i - start, 1);
+			start = i;
+		}
+	}
+
+	// relink in reverse order
+	for (i = 0; i < count; ++i) {
+		LL_NEXT(insts[i]) = i ? insts[i - 1] : mark;
+	}
+	asm_out = insts[count - 1];
+
+	free(insts);
+}
@@ -0,0 +1,258 @@
+#include <backend.h>
+#include <quads/quads.h>
+#include <asmgen/asm.h>
+#include <parser/types.h>
+#include <parser/split.h>
+#include <common.h>
+#include <context.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+// functions in flight per worker thread (parsed but not yet output)
+#define JOBS_PER_THREAD	4
+
+struct fn_job {
+	union astnode *fndecl;
+	struct arena *arena;
+
+	// body to be parsed first, if it was skipped (see split.h), and its
+	// number among the bodies submitted
+	struct fn_body *body;
+	unsigned body_seq;
+
+	// translation unit that the function belongs to
+	struct context *ctx;
+
+	// generated code, once done is set
+	union asm_component *code;
+	int done;
+};
+
+// ring buffer of the functions in flight; jobs are numbered in source order:
+// next_submit is the number of functions submitted, next_claim the number
+// that workers have started on, and next_output the number that have been
+// output
+static struct fn_job *jobs;
+static unsigned njobs, next_submit, next_claim, next_output;
+
+// number of skipped function bodies submitted, and the number that have been
+// parsed and added to their translation unit (see split_finish())
+static unsigned next_body, next_finish;
+
+static pthread_t *threads;
+static unsigned nthreads;
+static int stopping;
+
+// lock protects the job counters and done flags; output_lock is held while a
+// thread outputs functions
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER,
+	output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// signaled when a job is submitted (or the workers should stop), when a
+// function has been output, and when a skipped body has been finished
+static pthread_cond_t submitted = PTHREAD_COND_INITIALIZER,
+	output = PTHREAD_COND_INITIALIZER,
+	finished = PTHREAD_COND_INITIALIZER;
+
+// parse a skipped function body into a new arena; the bodies are parsed in
+// parallel, but added to their translation unit in order
+static void fn_job_parse(struct fn_job *job)
+{
+	split_parse_body(job->body);
+	job->arena = job->body->arena;
+
+	if (!nthreads) {
+		split_finish(job->body);
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	while (next_finish != job->body_seq) {
+		pthread_cond_wait(&finished, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+
+	split_finish(job->body);
+
+	pthread_mutex_lock(&lock);
+	++next_finish;
+	pthread_cond_broadcast(&finished);
+	pthread_mutex_unlock(&lock);
+}
+
+// generate the quads and assembly of a function in its arena
+static void fn_job_generate(struct fn_job *job)
+{
+	struct basic_block *quads;
+
+	cur_ctx = job->ctx;
+	if (job->body) {
+		fn_job_parse(job);
+	}
+	cur_arena = job->arena;
+	quads = generate_quads(job->fndecl);
+	job->code = generate_asm(job->fndecl, quads);
+}
+
+// output a function's code, and release its body
+static void fn_job_output(struct fn_job *job)
+{
+	struct arena *arena = cur_arena;
+
+	// (the object file writer allocates from the current arena)
+	cur_ctx = job->ctx;
+	cur_arena = job->arena;
+	print_asm(job->code);
+	cur_arena = arena;
+
+	job->fndecl->decl.fn_body = NULL;
+	job->fndecl->decl.fn_scope = NULL;
+	fn_arena_release(job->arena);
+}
+
+// output the functions that are done, in order, up to the first one that
+// isn't
+static void output_done_jobs(void)
+{
+	struct fn_job *job;
+
+	pthread_mutex_lock(&output_lock);
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		job = &jobs[next_output % njobs];
+		if (next_output == next_submit || !job->done) {
+			pthread_mutex_unlock(&lock);
+			break;
+		}
+		pthread_mutex_unlock(&lock);
+
+		fn_job_output(job);
+
+		pthread_mutex_lock(&lock);
+		job->done = 0;
+		++next_output;
+		pthread_cond_broadcast(&output);
+		pthread_mutex_unlock(&lock);
+	}
+	pthread_mutex_unlock(&output_lock);
+}
+
+static void *worker(void *arg)
+{
+	struct fn_job *job;
+
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		while (next_claim == next_submit && !stopping) {
+			pthread_cond_wait(&submitted, &lock);
+		}
+		if (next_claim == next_submit) {
+			pthread_mutex_unlock(&lock);
+			return NULL;
+		}
+		job = &jobs[next_claim++ % njobs];
+		pthread_mutex_unlock(&lock);
+
+		fn_job_generate(job);
+
+		pthread_mutex_lock(&lock);
+		job->done = 1;
+		pthread_mutex_unlock(&lock);
+
+		output_done_jobs();
+	}
+}
+
+void backend_start(unsigned n)
+{
+	unsigned i;
+
+	if (!(nthreads = n)) {
+		return;
+	}
+
+	njobs = nthreads * JOBS_PER_THREAD;
+	jobs = calloc(njobs, sizeof(struct fn_job));
+	threads = calloc(nthreads, sizeof(pthread_t));
+	if (!jobs || !threads) {
+		yyerror_fatal("out of memory");
+	}
+
+	for (i = 0; i < nthreads; ++i) {
+		if (pthread_create(&threads[i], NULL, worker, NULL)) {
+			yyerror_fatal("could not create worker thread");
+		}
+	}
+}
+
+static void submit(struct fn_job *job)
+{
+	struct arena *parser_arena = cur_arena;
+
+	if (!nthreads) {
+		fn_job_generate(job);
+		fn_job_output(job);
+		cur_arena = parser_arena;
+		return;
+	}
+
+	// wait for a free slot
+	pthread_mutex_lock(&lock);
+	while (next_submit - next_output == njobs) {
+		pthread_cond_wait(&output, &lock);
+	}
+	if (job->body) {
+		job->body_seq = next_body++;
+	}
+	jobs[next_submit++ % njobs] = *job;
+	pthread_cond_signal(&submitted);
+	pthread_mutex_unlock(&lock);
+}
+
+void backend_submit(union astnode *fndecl, struct arena *arena)
+{
+	struct fn_job job = { .fndecl = fndecl, .arena = arena,
+		.ctx = cur_ctx };
+
+	submit(&job);
+}
+
+void backend_submit_body(struct fn_body *body)
+{
+	struct fn_job job = { .fndecl = body->fndecl, .body = body,
+		.ctx = cur_ctx };
+
+	submit(&job);
+}
+
+void backend_wait_parsed(void)
+{
+	if (!nthreads) {
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	while (next_finish != next_body) {
+		pthread_cond_wait(&finished, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void backend_finish(void)
+{
+	unsigned i;
+
+	if (!nthreads) {
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	pthread_cond_broadcast(&submitted);
+	pthread_mutex_unlock(&lock);
+
+	for (i = 0; i < nthreads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	nthreads = 0;
+}
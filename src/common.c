@@ -2,8 +2,20 @@
 
 union astnode *ELLIPSIS_DECLARATOR;
 
-union astnode *ll_append_iter;
+_Thread_local union astnode *ll_append_iter;
 
 int indi;
 
-FILE *dfp, *ofp;
\ No newline at end of file
+FILE *dfp;
+
+int optimize_size;
+
+int emit_object;
+
+int run_jit;
+
+int lex_thread;
+
+int split_parse;
+
+unsigned debug_flags;
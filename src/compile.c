@@ -0,0 +1,122 @@
+#include <compile.h>
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <lexer/numutils.h>
+#include <lexer/fastlex.h>
+#include <lexer/tokring.h>
+#include <parser.tab.h>
+#include <parser/scope.h>
+#include <parser/types.h>
+#include <parser/split.h>
+#include <asmgen/asm.h>
+#include <lex.yy.h>
+#include <common.h>
+#include <arena.h>
+#include <context.h>
+
+struct context *begin_unit(FILE *ofp)
+{
+	struct context *ctx = context_new(ofp);
+
+	context_enter(ctx);
+	types_init();
+	scope_push(0);
+	return ctx;
+}
+
+// parse the mapped input of the current context
+static void parse_mapped(void)
+{
+	if (split_parse) {
+		split_begin();
+	} else if (lex_thread) {
+		tokring_start();
+	}
+	yyparse();
+	if (cur_ctx->ring) {
+		tokring_stop();
+	}
+	split_end();
+	lex_unmap();
+}
+
+void parse_file(FILE *ifp)
+{
+	if (lex_map(ifp)) {
+		yyrestart(ifp, cur_ctx->scanner);
+		yyparse();
+		return;
+	}
+	parse_mapped();
+}
+
+void parse_string(const char *src, size_t len)
+{
+	if (lex_map_string(src, len)) {
+		yyerror_fatal("could not map the input");
+	}
+	parse_mapped();
+}
+
+// after the translation unit is complete, add global vars to output (after
+// all of the functions)
+void end_unit(void)
+{
+	gen_globalvar_asm(cur_ctx->global_vars);
+
+	if (DEBUGGING(DEBUG_STATS)) {
+		fprintf(dfp, "arena memory: %zu bytes (file), %zu bytes"
+			" (largest function)\n", cur_ctx->file_arena.peak
+			+ cur_ctx->intern_arena.peak, fn_arena_peak);
+		symtab_print_stats(dfp);
+	}
+}
+
+// report an error or warning at the current position; errors are fatal
+static void report(const char *err, int is_fatal_error)
+{
+	char buf[1024];
+	const char *text, *filename;
+	struct context *unit;
+	int len, lineno;
+
+	// replace default syntax error message
+	if (!strcmp(err, "syntax error")) {
+		is_fatal_error = 1;
+		text = lex_text(&len);
+		snprintf(buf, sizeof(buf), "unexpected token \"%.*s\"\n",
+			len, text);
+		err = buf;
+	}
+
+	filename = cur_ctx ? cur_ctx->tok_filename : "<command line>";
+	lineno = cur_ctx ? lex_lineno() : 0;
+
+	// the compiler is embedded: give the error back (see jit_compile())
+	if (is_fatal_error && cur_ctx && (unit = cur_ctx->unit)->error_jmp) {
+		snprintf(unit->error, sizeof(unit->error), "%s:%d: %s",
+			filename, lineno, err);
+		longjmp(*unit->error_jmp, 1);
+	}
+
+	fprintf(dfp, "%s:%d: %s: %s\n", filename, lineno,
+		is_fatal_error ? "error" : "warning", err);
+
+	if (is_fatal_error) {
+		_exit(-1);
+	}
+}
+
+// declared in parser.h
+int yyerror(const char *err)
+{
+	report(err, 0);
+}
+
+// declared in parser.h
+int yyerror_fatal(const char *err)
+{
+	report(err, 1);
+}
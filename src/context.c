@@ -0,0 +1,68 @@
+#include <context.h>
+#include <parser/parser.h>
+#include <asmgen/asm.h>
+#include <common.h>
+#include <parser.tab.h>
+#include <lex.yy.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Thread_local struct context *cur_ctx;
+
+struct context *context_new(FILE *ofp)
+{
+	struct context *ctx;
+
+	if (!(ctx = calloc(1, sizeof(struct context)))
+		|| (ofp && !(ctx->out_buf = malloc(OUT_BUF_SIZE)))) {
+		yyerror_fatal("out of memory");
+	}
+	if (yylex_init(&ctx->scanner)) {
+		yyerror_fatal("could not create the scanner");
+	}
+
+	ctx->unit = ctx;
+	ctx->filename = ctx->tok_filename = "<stdin>";
+	ctx->lineno = ctx->tok_lineno = ctx->tok_line = ctx->lex.line = 1;
+	ctx->tok_text = "";
+	pthread_mutex_init(&ctx->intern_lock, NULL);
+	ctx->scope_pos = ctx->su_decl_stack_pos = -1;
+	ctx->file_types.arena = &ctx->file_arena;
+	ctx->obj.bss_align = 1;
+	ctx->ofp = ofp;
+	ctx->jit = run_jit;
+	return ctx;
+}
+
+void context_enter(struct context *ctx)
+{
+	cur_ctx = ctx;
+	cur_arena = &ctx->file_arena;
+}
+
+void context_free(struct context *ctx)
+{
+	union astnode *iter;
+
+	// the buffers of the string literals are heap-allocated (see
+	// end_string())
+	_LL_FOR(ctx->string_ll, iter, string.symbol_next) {
+		free(iter->string.string.buf);
+	}
+
+	free(ctx->lex.scratch);
+	yylex_destroy(ctx->scanner);
+	free(ctx->scope_stack);
+	free(ctx->su_decl_stack);
+	obj_free(&ctx->obj);
+	arena_free(&ctx->file_arena);
+	arena_free(&ctx->intern_arena);
+	pthread_mutex_destroy(&ctx->intern_lock);
+	free(ctx->out_buf);
+
+	if (cur_ctx == ctx) {
+		cur_ctx = NULL;
+		cur_arena = NULL;
+	}
+	free(ctx);
+}
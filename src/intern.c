@@ -0,0 +1,100 @@
+#include <intern.h>
+#include <arena.h>
+#include <context.h>
+#include <string.h>
+
+#define INTERN_INIT_CAP	1024
+
+// hashtable of interned strings (open addressing, linear probing), in the
+// context of the current translation unit; capacity is a power of two, and the
+// table is kept at most half full
+#define tab	(cur_ctx->unit->intern_tab)
+#define cap	(cur_ctx->unit->intern_cap)
+#define count	(cur_ctx->unit->intern_count)
+
+// djb2: http://www.cse.yorku.ca/~oz/hash.html
+static unsigned intern_hash(const char *s, unsigned len)
+{
+	const char *c = s;
+	unsigned hash = 5381;
+
+	/* hash * 33 + c */
+	while (c < s + len) {
+		hash = ((hash << 5) + hash) + *c++;
+	}
+
+	// the tables index with the low bits of the hash, which djb2 alone
+	// spreads poorly for similar names (e.g., x1, x2, ...); mix all of the
+	// bits into them (murmur3 finalizer)
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static void intern_rehash(void)
+{
+	struct intern **old = tab;
+	unsigned old_cap = cap, i, j;
+
+	cap = cap ? cap * 2 : INTERN_INIT_CAP;
+	tab = arena_alloc(&cur_ctx->unit->intern_arena,
+		cap * sizeof(struct intern *));
+
+	// the old table is left behind in the arena
+	for (i = 0; i < old_cap; ++i) {
+		if (!old[i]) {
+			continue;
+		}
+
+		for (j = old[i]->hash & (cap - 1); tab[j];
+			j = (j + 1) & (cap - 1));
+		tab[j] = old[i];
+	}
+}
+
+char *intern(const char *str)
+{
+	return intern_len(str, strlen(str));
+}
+
+char *intern_len(const char *str, unsigned len)
+{
+	struct intern *rec;
+	unsigned hash = intern_hash(str, len), i;
+	int locked = cur_ctx->unit->intern_shared;
+
+	if (locked) {
+		pthread_mutex_lock(&cur_ctx->unit->intern_lock);
+	}
+
+	if (2 * (count + 1) > cap) {
+		intern_rehash();
+	}
+
+	for (i = hash & (cap - 1); (rec = tab[i]); i = (i + 1) & (cap - 1)) {
+		if (rec->hash == hash && rec->len == len
+			&& !memcmp(rec->str, str, len)) {
+			goto done;
+		}
+	}
+
+	rec = arena_alloc(&cur_ctx->unit->intern_arena,
+		sizeof(struct intern) + len + 1);
+	rec->hash = hash;
+	rec->len = len;
+	rec->globals = 0;
+	memcpy(rec->str, str, len);
+	rec->str[len] = 0;
+
+	tab[i] = rec;
+	++count;
+
+done:
+	if (locked) {
+		pthread_mutex_unlock(&cur_ctx->unit->intern_lock);
+	}
+	return rec->str;
+}
@@ -2,24 +2,20 @@
 #include <lexer/stringutils.h>
 #include <lexer/numutils.h>
 #include <parser.tab.h>
+#include <context.h>
+#include <intern.h>
 
-int lineno = 1;
-char filename[255] = "<stdin>";
-
-extern char *yytext;
-
-void parse_lineno() {
-	char *c = yytext;
-	int i = 0;
+void parse_lineno(const char *text) {
+	const char *c = text, *name;
 
 	// discard extra characters
 	while (*c < '0' || *c > '9')
 		++c;
 
 	// read line number
-	lineno = 0;
+	cur_ctx->lineno = 0;
 	while (*c >= '0' && *c <= '9')
-		lineno = lineno * 10 + (*c++ - '0');
+		cur_ctx->lineno = cur_ctx->lineno * 10 + (*c++ - '0');
 	
 	// discard extra characters
 	while (*c != '"')
@@ -27,14 +23,13 @@ void parse_lineno() {
 	++c;
 
 	// read filename
-	while (*c != '"')
-		filename[i++] = *c++;
-	filename[i] = 0;
+	for (name = c; *c != '"'; ++c);
+	cur_ctx->filename = intern_len(name, c - name);
 }
 
-void print_lexical_error() {
+void print_lexical_error(const char *text) {
 	fprintf(stderr, "%s: %d: Error: unexpected '%s'.\n",
-		filename, lineno, yytext);
+		cur_ctx->filename, cur_ctx->lineno, text);
 }
 
 char *toktostr(int enumval) {
@@ -0,0 +1,745 @@
+#include <lexer/fastlex.h>
+#include <lexer/tokring.h>
+#include <lexer/numutils.h>
+#include <parser/parser.h>
+#include <parser/split.h>
+#include <parser.tab.h>
+#include <lex.yy.h>
+#include <intern.h>
+#include <context.h>
+#include <common.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+// zero bytes after the input: a scan stops at the first zero byte, and may
+// read up to a vector (32 bytes) past it
+#define MAP_PADDING	64
+
+// character classes; CC_IDENT is only used for spans (letters and digits)
+enum char_class {
+	CC_OTHER,
+	CC_SPACE,
+	CC_ALPHA,
+	CC_DIGIT,
+	CC_IDENT,
+};
+
+static const unsigned char char_class[256] = {
+	[' '] = CC_SPACE, ['\t' ... '\r'] = CC_SPACE,
+	['a' ... 'z'] = CC_ALPHA, ['A' ... 'Z'] = CC_ALPHA, ['_'] = CC_ALPHA,
+	['0' ... '9'] = CC_DIGIT,
+};
+
+/**
+ * CHARACTER CLASS SCANS
+ *
+ * span() returns the number of characters starting at p that are in a class,
+ * and for CC_SPACE, adds the number of newlines among them. The vector
+ * versions test 16 (SSE2) or 32 (AVX2) characters at a time: each class is a
+ * few ranges, and a range test is a single signed compare once both sides are
+ * offset by 128.
+ */
+
+#ifdef __x86_64__
+
+static inline __m128i in_range16(__m128i v, char lo, char n)
+{
+	return _mm_cmpgt_epi8(_mm_set1_epi8((char) (n - 128)),
+		_mm_sub_epi8(v, _mm_set1_epi8((char) (lo + 128))));
+}
+
+static inline unsigned class_mask16(__m128i v, enum char_class cls)
+{
+	__m128i m = in_range16(v, '0', 10);
+
+	switch (cls) {
+	case CC_SPACE:
+		m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+			in_range16(v, '\t', 5));
+		break;
+	case CC_IDENT:
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+		m = _mm_or_si128(m, in_range16(_mm_or_si128(v,
+			_mm_set1_epi8(0x20)), 'a', 26));
+		break;
+	default:
+		break;
+	}
+	return _mm_movemask_epi8(m);
+}
+
+static size_t span_sse2(const char *p, enum char_class cls, unsigned *nl)
+{
+	const char *s = p;
+	unsigned m, lines;
+	__m128i v;
+
+	for (;; s += 16) {
+		v = _mm_loadu_si128((const __m128i *) s);
+		m = ~class_mask16(v, cls) & 0xffff;
+		if (cls == CC_SPACE) {
+			lines = _mm_movemask_epi8(_mm_cmpeq_epi8(v,
+				_mm_set1_epi8('\n')));
+			if (m) {
+				lines &= (1u << __builtin_ctz(m)) - 1;
+			}
+			*nl += __builtin_popcount(lines);
+		}
+		if (m) {
+			return s - p + __builtin_ctz(m);
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m256i in_range32(__m256i v, char lo, char n)
+{
+	return _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (n - 128)),
+		_mm256_sub_epi8(v, _mm256_set1_epi8((char) (lo + 128))));
+}
+
+__attribute__((target("avx2")))
+static inline unsigned class_mask32(__m256i v, enum char_class cls)
+{
+	__m256i m = in_range32(v, '0', 10);
+
+	switch (cls) {
+	case CC_SPACE:
+		m = _mm256_or_si256(_mm256_cmpeq_epi8(v,
+			_mm256_set1_epi8(' ')), in_range32(v, '\t', 5));
+		break;
+	case CC_IDENT:
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v,
+			_mm256_set1_epi8('_')));
+		m = _mm256_or_si256(m, in_range32(_mm256_or_si256(v,
+			_mm256_set1_epi8(0x20)), 'a', 26));
+		break;
+	default:
+		break;
+	}
+	return _mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static size_t span_avx2(const char *p, enum char_class cls, unsigned *nl)
+{
+	const char *s = p;
+	unsigned m, lines;
+	__m256i v;
+
+	for (;; s += 32) {
+		v = _mm256_loadu_si256((const __m256i *) s);
+		m = ~class_mask32(v, cls);
+		if (cls == CC_SPACE) {
+			lines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+				_mm256_set1_epi8('\n')));
+			if (m) {
+				lines &= (1u << __builtin_ctz(m)) - 1;
+			}
+			*nl += __builtin_popcount(lines);
+		}
+		if (m) {
+			return s - p + __builtin_ctz(m);
+		}
+	}
+}
+
+#endif
+
+static inline int in_class(char c, enum char_class cls)
+{
+	enum char_class c_cls = char_class[(unsigned char) c];
+
+	return c_cls == cls || (cls == CC_IDENT
+		&& (c_cls == CC_ALPHA || c_cls == CC_DIGIT));
+}
+
+// most runs (a space between tokens, an identifier) are only a few characters
+// long, so the first few characters are tested one at a time, and only longer
+// runs (indentation, blank lines) are scanned with vectors
+#define SPAN_SHORT	8
+
+static inline size_t span(struct fastlex *lex, const char *p,
+	enum char_class cls, unsigned *nl)
+{
+	const char *s;
+
+	for (s = p; s < p + SPAN_SHORT; ++s) {
+		if (!in_class(*s, cls)) {
+			return s - p;
+		}
+		if (*s == '\n') {
+			++*nl;
+		}
+	}
+
+#ifdef __x86_64__
+	return SPAN_SHORT + (lex->avx2 ? span_avx2(s, cls, nl)
+		: span_sse2(s, cls, nl));
+#else
+	for (; in_class(*s, cls); ++s) {
+		if (*s == '\n') {
+			++*nl;
+		}
+	}
+	return s - p;
+#endif
+}
+
+/**
+ * KEYWORDS
+ *
+ * Perfect hash of the keywords, from their first two and last two characters
+ * and their length (the multiplier was found by trying random ones), so that
+ * an identifier is compared with at most one keyword.
+ */
+
+#define KW_HASH_BITS	6
+
+static inline unsigned keyword_hash(const char *p, unsigned len)
+{
+	uint32_t w = (unsigned char) p[0] | (unsigned char) p[1] << 8
+		| (unsigned char) p[len - 2] << 16
+		| (uint32_t) (unsigned char) p[len - 1] << 24;
+
+	return (w + len) * 0xa00f7bafu >> (32 - KW_HASH_BITS);
+}
+
+// indexed by keyword_hash()
+static const struct keyword {
+	const char *name;
+	int token;
+} keywords[1 << KW_HASH_BITS] = {
+	[2] = { "while", WHILE },
+	[4] = { "static", STATIC },
+	[5] = { "void", VOID },
+	[7] = { "register", REGISTER },
+	[9] = { "auto", AUTO },
+	[10] = { "signed", SIGNED },
+	[11] = { "continue", CONTINUE },
+	[13] = { "double", DOUBLE },
+	[15] = { "inline", INLINE },
+	[17] = { "_Complex", _COMPLEX },
+	[18] = { "long", LONG },
+	[19] = { "break", BREAK },
+	[21] = { "enum", ENUM },
+	[22] = { "sizeof", SIZEOF },
+	[26] = { "return", RETURN },
+	[27] = { "extern", EXTERN },
+	[30] = { "char", CHAR },
+	[31] = { "default", DEFAULT },
+	[32] = { "restrict", RESTRICT },
+	[33] = { "if", IF },
+	[34] = { "goto", GOTO },
+	[37] = { "float", FLOAT },
+	[38] = { "const", CONST },
+	[39] = { "int", INT },
+	[43] = { "do", DO },
+	[44] = { "short", SHORT },
+	[45] = { "volatile", VOLATILE },
+	[47] = { "typedef", TYPEDEF },
+	[48] = { "union", UNION },
+	[49] = { "switch", SWITCH },
+	[50] = { "else", ELSE },
+	[51] = { "struct", STRUCT },
+	[54] = { "_Imaginary", _IMAGINARY },
+	[55] = { "case", CASE },
+	[58] = { "for", FOR },
+	[61] = { "unsigned", UNSIGNED },
+	[62] = { "_Bool", _BOOL },
+};
+
+// returns the token of a keyword, or 0 if the identifier isn't one
+static inline int keyword(const char *p, unsigned len)
+{
+	const struct keyword *kw;
+
+	if (len < 2 || len > 10) {
+		return 0;
+	}
+	kw = &keywords[keyword_hash(p, len)];
+	return kw->name && !strncmp(kw->name, p, len) && !kw->name[len]
+		? kw->token : 0;
+}
+
+/**
+ * TOKENS
+ */
+
+#define OP2(a, b)	((a) << 8 | (b))
+
+// operators, longest match first; returns 0 if p isn't an operator
+static int lex_operator(const char *p, int *len)
+{
+	*len = 2;
+	switch (OP2(p[0], p[1])) {
+	case OP2('-', '>'):	return INDSEL;
+	case OP2('+', '+'):	return PLUSPLUS;
+	case OP2('-', '-'):	return MINUSMINUS;
+	case OP2('<', '='):	return LTEQ;
+	case OP2('>', '='):	return GTEQ;
+	case OP2('=', '='):	return EQEQ;
+	case OP2('!', '='):	return NOTEQ;
+	case OP2('&', '&'):	return LOGAND;
+	case OP2('|', '|'):	return LOGOR;
+	case OP2('*', '='):	return TIMESEQ;
+	case OP2('/', '='):	return DIVEQ;
+	case OP2('%', '='):	return MODEQ;
+	case OP2('+', '='):	return PLUSEQ;
+	case OP2('-', '='):	return MINUSEQ;
+	case OP2('&', '='):	return ANDEQ;
+	case OP2('|', '='):	return OREQ;
+	case OP2('^', '='):	return XOREQ;
+	case OP2('<', '<'):
+		*len = p[2] == '=' ? 3 : 2;
+		return *len == 3 ? SHLEQ : SHL;
+	case OP2('>', '>'):
+		*len = p[2] == '=' ? 3 : 2;
+		return *len == 3 ? SHREQ : SHR;
+	case OP2('.', '.'):
+		if (p[2] == '.') {
+			*len = 3;
+			return ELLIPSIS;
+		}
+		break;
+	}
+
+	// single-character operators are their own token type
+	*len = 1;
+	return *p && strchr("~!%^&*()-=+[]{}|;:<>,.?/", *p) ? *p : 0;
+}
+
+// integer constants without a suffix; returns 0 for other numbers, which
+// are lexed by flex
+static int lex_int(struct fastlex *lex, const char *p, int *len, int *radix)
+{
+	const char *s;
+
+	if (*p != '0') {
+		*radix = 10;
+		s = p + span(lex, p, CC_DIGIT, NULL);
+		if (*s == '.' || (*s | 0x20) == 'e') {
+			return 0;
+		}
+	} else if ((p[1] | 0x20) == 'x' && isxdigit(p[2])) {
+		*radix = 16;
+		for (s = p + 2; isxdigit(*s); ++s);
+		if (*s == '.' || (*s | 0x20) == 'p') {
+			return 0;
+		}
+	} else {
+		*radix = 8;
+		for (s = p + 1; *s >= '0' && *s <= '7'; ++s);
+		if (*s == '8' || *s == '9' || *s == '.'
+			|| (*s | 0x20) == 'e') {
+			return 0;
+		}
+	}
+
+	if ((*s | 0x20) == 'u' || (*s | 0x20) == 'l') {
+		return 0;
+	}
+	*len = s - p;
+	return 1;
+}
+
+// length of the line marker (e.g., # 1 "file.c" 2) at p, up to and
+// including the newline, or 0 if p isn't one
+static size_t line_marker(const char *p)
+{
+	const char *s = p + 2;
+
+	if (p[1] != ' ' || *s < '0' || *s > '9') {
+		return 0;
+	}
+	while (*s >= '0' && *s <= '9') {
+		++s;
+	}
+	if (*s++ != ' ' || *s++ != '"' || *s == '"') {
+		return 0;
+	}
+	for (; *s != '"'; ++s) {
+		if (!*s || *s == '\n') {
+			return 0;
+		}
+	}
+	for (; *s != '\n'; ++s) {
+		if (!*s) {
+			return 0;
+		}
+	}
+	return s + 1 - p;
+}
+
+// length of the text that flex needs to lex a number (a floating-point or
+// suffixed constant) that starts at p
+static size_t number_len(const char *p)
+{
+	const char *s = p;
+
+	while (char_class[(unsigned char) *s] >= CC_ALPHA || *s == '.'
+		|| *s == '+' || *s == '-') {
+		++s;
+	}
+	return s - p;
+}
+
+// length of a string or character literal with a prefix of len characters,
+// through the closing quote (or the end of the input)
+static size_t literal_len(struct fastlex *lex, const char *p, size_t len)
+{
+	const char *s = p + len + 1;
+	char quote = p[len];
+
+	for (; s < lex->end && *s != quote; ++s) {
+		if (*s == '\\' && s + 1 < lex->end) {
+			++s;
+		}
+	}
+	return (s < lex->end ? s + 1 : lex->end) - p;
+}
+
+// lex the next token in the first len characters at pos with the flex rules
+// (see lexer.l); returns the token, or 0 if there isn't one, in which case
+// all of the text was consumed
+static int lex_flex(struct fastlex *lex, union YYSTYPE *lval, size_t len)
+{
+	yyscan_t scanner = cur_ctx->scanner;
+	YY_BUFFER_STATE buf;
+	int token;
+
+	// flex wants the text followed by two null characters, and writes to
+	// it as it goes
+	if (len + 2 > lex->scratch_cap) {
+		lex->scratch_cap = MAX(len + 2, 2 * lex->scratch_cap);
+		if (!(lex->scratch = realloc(lex->scratch,
+			lex->scratch_cap))) {
+			yyerror_fatal("out of memory");
+		}
+	}
+	memcpy(lex->scratch, lex->pos, len);
+	lex->scratch[len] = lex->scratch[len + 1] = 0;
+
+	if (!(buf = yy_scan_buffer(lex->scratch, len + 2, scanner))) {
+		yyerror_fatal("could not create the scanner buffer");
+	}
+	yyset_lineno(lex->line, scanner);
+
+	token = yylex(lval, scanner);
+
+	lex->line = yyget_lineno(scanner);
+	if (token) {
+		lex->tok = lex->pos + (yyget_text(scanner) - lex->scratch);
+		lex->tok_len = yyget_leng(scanner);
+		lex->pos = lex->tok + lex->tok_len;
+	} else {
+		lex->pos += len;
+	}
+
+	yy_delete_buffer(buf, scanner);
+	return token;
+}
+
+int lex_next(union YYSTYPE *lval)
+{
+	struct fastlex *lex = &cur_ctx->lex;
+	yyscan_t scanner;
+	const char *p;
+	unsigned nl;
+	int len, radix, token;
+	size_t n;
+
+	if (!lex->pos) {
+		scanner = cur_ctx->scanner;
+		token = yylex(lval, scanner);
+		lex->line = yyget_lineno(scanner);
+		lex->tok = yyget_text(scanner);
+		lex->tok_len = yyget_leng(scanner);
+		return token;
+	}
+
+	for (;;) {
+		p = lex->pos;
+		if (p >= lex->end) {
+			lex->tok = p;
+			lex->tok_len = 0;
+			return 0;
+		}
+
+		switch (char_class[(unsigned char) *p]) {
+		case CC_SPACE:
+			nl = 0;
+			lex->pos += span(lex, p, CC_SPACE, &nl);
+			cur_ctx->lineno += nl;
+			lex->line += nl;
+			continue;
+
+		case CC_ALPHA:
+			len = span(lex, p, CC_IDENT, NULL);
+
+			// string and character literal prefixes
+			if ((p[len] == '"' || p[len] == '\'') && ((len == 1
+				&& (*p == 'u' || *p == 'U' || *p == 'L'))
+				|| (len == 2 && p[len] == '"' && *p == 'u'
+					&& p[1] == '8'))) {
+				n = literal_len(lex, p, len);
+				break;
+			}
+
+			if ((token = keyword(p, len))) {
+				lval->sc = token;
+			} else {
+				lval->ident = intern_len(p, len);
+				token = IDENT;
+			}
+			goto done;
+
+		case CC_DIGIT:
+			if (!lex_int(lex, p, &len, &radix)) {
+				n = number_len(p);
+				break;
+			}
+			lval->astnode = make_int(p, radix, BT_INT, LLS_UNSPEC,
+				SIGN_SIGNED);
+			token = NUMBER;
+			goto done;
+
+		default:
+			if (*p == '"' || *p == '\'') {
+				n = literal_len(lex, p, 0);
+				break;
+			}
+
+			if (*p == '#') {
+				if ((n = line_marker(p))) {
+					parse_lineno(p);
+					lex->pos += n;
+					++lex->line;
+					continue;
+				}
+				for (n = 1; p + n < lex->end && p[n] != '\n';
+					++n);
+				break;
+			}
+
+			if (*p == '.' && p[1] >= '0' && p[1] <= '9') {
+				n = number_len(p);
+				break;
+			}
+
+			if ((token = lex_operator(p, &len))) {
+				lval->sc = token;
+				goto done;
+			}
+
+			// invalid character
+			n = 1;
+			break;
+		}
+
+		if ((token = lex_flex(lex, lval, n))) {
+			return token;
+		}
+	}
+
+done:
+	lex->tok = p;
+	lex->tok_len = len;
+	lex->pos = p + len;
+	return token;
+}
+
+// start lexing a mapping of len bytes of input (followed by zero padding)
+static void lex_set_map(struct fastlex *lex, char *map, size_t len)
+{
+	lex->map = map;
+	lex->map_len = len + MAP_PADDING;
+	lex->pos = lex->tok = map;
+	lex->end = map + len;
+	lex->tok_len = 0;
+#ifdef __x86_64__
+	lex->avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+int lex_map(FILE *ifp)
+{
+	struct fastlex *lex = &cur_ctx->lex;
+	struct stat st;
+	char *map;
+	size_t len;
+
+	if (fstat(fileno(ifp), &st) || !S_ISREG(st.st_mode)) {
+		return 1;
+	}
+
+	// the file is mapped over the beginning of zeroed memory, so that it
+	// is followed by zeros even if it ends on a page boundary
+	len = st.st_size;
+	map = mmap(NULL, len + MAP_PADDING, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		return 1;
+	}
+	if (len && mmap(map, len, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+		fileno(ifp), 0) == MAP_FAILED) {
+		munmap(map, len + MAP_PADDING);
+		return 1;
+	}
+
+	lex_set_map(lex, map, len);
+	return 0;
+}
+
+int lex_map_string(const char *src, size_t len)
+{
+	char *map;
+
+	// a copy, followed by zeros like a mapped file
+	map = mmap(NULL, len + MAP_PADDING, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		return 1;
+	}
+	memcpy(map, src, len);
+
+	lex_set_map(&cur_ctx->lex, map, len);
+	return 0;
+}
+
+void lex_unmap(void)
+{
+	struct fastlex *lex = &cur_ctx->lex;
+
+	if (lex->map) {
+		munmap(lex->map, lex->map_len);
+	}
+	lex->map = NULL;
+	lex->pos = lex->end = lex->tok = NULL;
+}
+
+/**
+ * SPLIT PARSING
+ *
+ * A function body is a brace at the top level right after a parenthesis (the
+ * end of a function declarator); the grammar has no other use for one, since
+ * initializers aren't supported. It is skipped by scanning for its closing
+ * brace, which only has to step over literals, and keep track of the position
+ * in the source file like lex_next() does.
+ */
+
+// skip a function body whose opening brace has just been lexed, and returns
+// the end of its closing brace (or of the input, if it is missing)
+static const char *skip_body(struct fastlex *lex)
+{
+	const char *p, *q;
+	unsigned depth = 1;
+	size_t n;
+
+	for (p = lex->pos; p < lex->end; ++p) {
+		switch (*p) {
+		case '\n':
+			++cur_ctx->lineno;
+			++lex->line;
+			break;
+		case '{':
+			++depth;
+			break;
+		case '}':
+			if (!--depth) {
+				return p + 1;
+			}
+			break;
+		case '"':
+		case '\'':
+			for (q = p, p += literal_len(lex, p, 0) - 1; q < p;
+				++q) {
+				if (*q == '\n') {
+					++cur_ctx->lineno;
+					++lex->line;
+				}
+			}
+			break;
+		case '#':
+			if ((n = line_marker(p))) {
+				parse_lineno(p);
+				p += n - 1;
+				++lex->line;
+			}
+			break;
+		}
+	}
+	return lex->end;
+}
+
+static int lex_split(struct fastlex *lex, union YYSTYPE *lval)
+{
+	struct fn_body *body;
+	int token;
+
+	if (lex->split == SPLIT_BODY) {
+		lex->split = SPLIT_NONE;
+		lex->tok = lex->pos;
+		lex->tok_len = 0;
+		return SPLITSTART;
+	}
+
+	token = lex_next(lval);
+	if (token == '{' && !lex->depth && lex->prev == ')') {
+		body = ARENA_NEW(struct fn_body);
+		body->start = lex->tok;
+		body->filename = cur_ctx->filename;
+		body->lineno = cur_ctx->lineno;
+		body->line = lex->line;
+		body->end = lex->pos = skip_body(lex);
+		lex->tok_len = 1;
+
+		lval->body = body;
+		lex->prev = token = FNBODY;
+		return token;
+	}
+
+	if (token == '{') {
+		++lex->depth;
+	} else if (token == '}') {
+		--lex->depth;
+	}
+	lex->prev = token;
+	return token;
+}
+
+int lex_token(union YYSTYPE *lval)
+{
+	struct context *ctx = cur_ctx;
+	int token;
+
+	if (ctx->ring) {
+		return tokring_next(lval);
+	}
+
+	token = ctx->lex.split ? lex_split(&ctx->lex, lval) : lex_next(lval);
+	ctx->tok_filename = ctx->filename;
+	ctx->tok_lineno = ctx->lineno;
+	ctx->tok_line = ctx->lex.line;
+	ctx->tok_text = ctx->lex.tok;
+	ctx->tok_len = ctx->lex.tok_len;
+	return token;
+}
+
+int lex_lineno(void)
+{
+	return cur_ctx->tok_line;
+}
+
+const char *lex_text(int *len)
+{
+	*len = cur_ctx->tok_len;
+	return cur_ctx->tok_text;
+}
@@ -4,11 +4,9 @@
 #include <parser/astnode.h>
 #include <lexer/numutils.h>
 
-extern char *yytext;
-
 // struct number make_int(int radix, enum sign sign, enum type type) {
-union astnode *make_int(int radix, enum scalar_basetype type,
-	enum scalar_lls lls, enum scalar_sign sign)
+union astnode *make_int(const char *text, int radix,
+	enum scalar_basetype type, enum scalar_lls lls, enum scalar_sign sign)
 {
 	union astnode *number, *ts;
 
@@ -22,7 +20,7 @@ union astnode *make_int(int radix, enum scalar_basetype type,
 
 	ALLOC_TYPE(number, NT_NUMBER);
 	number->num.ts = ts;
-	*((unsigned long long*)number->num.buf) = strtoull(yytext, NULL, radix);
+	*((unsigned long long*)number->num.buf) = strtoull(text, NULL, radix);
 
 	return number;
 
@@ -39,18 +37,12 @@ union astnode *make_int(int radix, enum scalar_basetype type,
 
 union astnode *make_one(void)
 {
-	char *tmp = yytext;
-	union astnode *one;
-
-	yytext = "1";
-	one = make_int(10, BT_INT, LLS_UNSPEC, SIGN_SIGNED);
-	yytext = tmp;
-
-	return one;
+	return make_int("1", 10, BT_INT, LLS_UNSPEC, SIGN_SIGNED);
 }
 
 // struct number make_fp(enum type type) {
-union astnode *make_fp(enum scalar_basetype type, enum scalar_lls lls)
+union astnode *make_fp(const char *text, enum scalar_basetype type,
+	enum scalar_lls lls)
 {
 	union astnode *number, *ts;
 
@@ -61,7 +53,7 @@ union astnode *make_fp(enum scalar_basetype type, enum scalar_lls lls)
 
 	ALLOC_TYPE(number, NT_NUMBER);
 	number->num.ts = ts;
-	*((long double*)number->num.buf) = (long double)strtod(yytext, NULL);
+	*((long double*)number->num.buf) = (long double)strtod(text, NULL);
 
 	return number;
 
@@ -4,8 +4,7 @@
 #include <ctype.h>
 #include <lexer/stringutils.h>
 #include <lexer/unicodeutils.h>
-
-extern char *yytext;
+#include <context.h>
 
 size_t char_widths[5] = {
 	sizeof(char),			// CW_NONE
@@ -15,33 +14,29 @@ size_t char_widths[5] = {
 	sizeof(unsigned char)		// CW_u8
 };
 
-// for building the string; buf_len includes the null character at the
-// end, cur_len does not
-static char *strbuf = NULL;
-static unsigned cur_len, buf_len, initial_size = 16;
-enum literal_type literal_type;
-enum char_width char_width;
-union char_t char_val;
+// initial size of the buffer of a string literal (see struct literal)
+static unsigned initial_size = 16;
 
-void begin_literal() {
-	unsigned len = strlen(yytext);
+void begin_literal(const char *text) {
+	struct literal *lit = &cur_ctx->literal;
+	unsigned len = strlen(text);
 
 	// detecting literal type
-	literal_type = yytext[len-1] == '"' ? LT_STRING : LT_CHARLIT;
+	lit->type = text[len-1] == '"' ? LT_STRING : LT_CHARLIT;
 
 	// detecting character width
-	switch (yytext[0]) {
+	switch (text[0]) {
 		case '\'': case '\"':
-			char_width = CW_NONE;
+			lit->width = CW_NONE;
 			break;
 		case 'U':
-			char_width = CW_U;
+			lit->width = CW_U;
 			break;
 		case 'L':
-			char_width = CW_L;
+			lit->width = CW_L;
 			break;
 		case 'u':
-			char_width = yytext[1] == '8' ? CW_u8 : CW_u;
+			lit->width = text[1] == '8' ? CW_u8 : CW_u;
 			break;
 		default:
 			fprintf(stderr, "Error: unknown char width");
@@ -49,36 +44,38 @@ void begin_literal() {
 	}
 
 	// initialize empty string/character
-	if (literal_type == LT_STRING) {
-		strbuf = (void *) malloc(initial_size * sizeof(char));
-		buf_len = initial_size;
-		cur_len = 0;
+	if (lit->type == LT_STRING) {
+		lit->buf = (void *) malloc(initial_size * sizeof(char));
+		lit->cap = initial_size;
+		lit->len = 0;
 	} else {
-		// cur_len to indicate whether character is filled or not
+		// len to indicate whether character is filled or not
 		// in the case of multi-character literals (which are
 		// not supported in this implementation); also used to
 		// indicate empty character constant (an error)
-		cur_len = 0;
+		lit->len = 0;
 	}
 }
 
 struct string end_string() {
-	strbuf[cur_len] = 0;
-	switch (char_width) {
+	struct literal *lit = &cur_ctx->literal;
+
+	lit->buf[lit->len] = 0;
+	switch (lit->width) {
 		case CW_NONE:
-			((char *) strbuf)[cur_len] = 0;
+			((char *) lit->buf)[lit->len] = 0;
 			break;
 		case CW_L:
-			((wchar_t *) strbuf)[cur_len] = 0;
+			((wchar_t *) lit->buf)[lit->len] = 0;
 			break;
 		case CW_u:
-			((char16_t *) strbuf)[cur_len] = 0;
+			((char16_t *) lit->buf)[lit->len] = 0;
 			break;
 		case CW_U:
-			((char32_t *) strbuf)[cur_len] = 0;
+			((char32_t *) lit->buf)[lit->len] = 0;
 			break;
 		case CW_u8:
-			((unsigned char *) strbuf)[cur_len] = 0;
+			((unsigned char *) lit->buf)[lit->len] = 0;
 			break;
 		default:
 			fprintf(stderr, "Error: unknown character width.\n");
@@ -86,29 +83,32 @@ struct string end_string() {
 	}
 
 	return (struct string) {
-		.width = char_width,
-		.length = cur_len,
-		.buf = realloc(strbuf, (cur_len+1) * char_widths[char_width])
+		.width = lit->width,
+		.length = lit->len,
+		.buf = realloc(lit->buf,
+			(lit->len+1) * char_widths[lit->width])
 	};
 }
 
 struct charlit end_charlit() {
+	struct literal *lit = &cur_ctx->literal;
+
 	// empty character constant is an error
-	if (!cur_len) {
+	if (!lit->len) {
 		fprintf(stderr, "Error: empty character constant.\n");
 		return (struct charlit) {};
 	}
 
 	// multiple code points is a warning; we mimick the behavior of gcc8
 	// by returning only the last code point in the character constant
-	if (cur_len > char_widths[char_width]) {
+	if (lit->len > char_widths[lit->width]) {
 		fprintf(stderr, "Warning: multiple code points in character "
 			"constant.\n");
 	}
 
 	return (struct charlit) {
-		.width = char_width,
-		.value = char_val
+		.width = lit->width,
+		.value = lit->value
 	};
 }
 
@@ -117,19 +117,20 @@ struct charlit end_charlit() {
 // append_buf_len is the number of bytes to add to the buffer, not the
 // number of characters (append_buf_length = number_of_characters*char_width
 // except for u8 strings, which have a VLE)
-static void append_buffer(void *append_buf, unsigned append_buf_len) {
+static void append_buffer(const void *append_buf, unsigned append_buf_len) {
+	struct literal *lit = &cur_ctx->literal;
 
 	// strings
-	if (literal_type == LT_STRING) {
+	if (lit->type == LT_STRING) {
 		// realloc when necessary; doubles buffer size until sufficient
-		if (buf_len - cur_len - 1 < append_buf_len) {
-			while (buf_len - cur_len - 1 < append_buf_len)
-				buf_len <<= 1;
-			strbuf = realloc(strbuf, buf_len);
+		if (lit->cap - lit->len - 1 < append_buf_len) {
+			while (lit->cap - lit->len - 1 < append_buf_len)
+				lit->cap <<= 1;
+			lit->buf = realloc(lit->buf, lit->cap);
 		}
 
-		memcpy(strbuf + cur_len, append_buf, append_buf_len);
-		cur_len += append_buf_len;
+		memcpy(lit->buf + lit->len, append_buf, append_buf_len);
+		lit->len += append_buf_len;
 		return;
 	}
 
@@ -140,55 +141,56 @@ static void append_buffer(void *append_buf, unsigned append_buf_len) {
 	// this matches the behavior on gcc8: treat character constant as
 	// an integer, and truncate to the first char_width bytes, assuming
 	// a little-endian system
-	switch (char_width) {
+	switch (lit->width) {
 		case CW_NONE:
-			char_val.none = *((char *) append_buf);
+			lit->value.none = *((const char *) append_buf);
 			break;
 		case CW_L:
-			char_val.L = *((wchar_t *) append_buf);
+			lit->value.L = *((const wchar_t *) append_buf);
 			break;
 		case CW_u:
-			char_val.u = *((char16_t *) append_buf);
+			lit->value.u = *((const char16_t *) append_buf);
 			break;
 		case CW_U:
-			char_val.U = *((char32_t *) append_buf);
+			lit->value.U = *((const char32_t *) append_buf);
 			break;
 		case CW_u8:
-			char_val.u8 = *((unsigned char *) append_buf);
+			lit->value.u8 = *((const unsigned char *) append_buf);
 			break;
 		default: 
 			fprintf(stderr, "Error: unknown character type\n");
 			return;
 	}
-	cur_len += append_buf_len;
+	lit->len += append_buf_len;
 }
 
 // this assumes a valid UTF-8 source file -- see the README and unicodeutils.h
-void append_text() {
+void append_text(const char *text) {
+	struct literal *lit = &cur_ctx->literal;
 	void *buf;
 	int len;
 
 	// for a UTF-8 string paste string literally
-	if (literal_type == LT_STRING && char_width == CW_u8) {
-		append_buffer(yytext, strlen(yytext));
+	if (lit->type == LT_STRING && lit->width == CW_u8) {
+		append_buffer(text, strlen(text));
 		return;
 	}
 
 	// otherwise, convert to unicode string with fixed width
-	len = utowc(yytext, char_widths[char_width], &buf);
+	len = utowc(text, char_widths[lit->width], &buf);
 	append_buffer(buf, len);
 	free(buf);
 }
 
-void parse_append_escape() {
+void parse_append_escape(const char *text) {
 	unsigned long val;
 
-	switch (yytext[1]) {
+	switch (text[1]) {
 		case '\\':
 		case '\'':
 		case '"':
 		case '?':
-			val = yytext[1];
+			val = text[1];
 			break;
 		case 'a': val = '\a'; break;
 		case 'b': val = '\b'; break;
@@ -199,7 +201,7 @@ void parse_append_escape() {
 		case 'v': val = '\v'; break;
 		default:
 			fprintf(stderr, "Error: bad escape code %c\n",
-				yytext[1]);
+				text[1]);
 			return;
 	}
 	append_buffer(&val, 1);
@@ -208,23 +210,24 @@ void parse_append_escape() {
 // note that this assumes a little-endian system; unsigned
 // long should be at least as long as all possible character types
 // (i.e., at least 32 bits), so it acts as a simple LE-buffer
-void parse_append_octal() {
+void parse_append_octal(const char *text) {
+	struct literal *lit = &cur_ctx->literal;
 	unsigned long val = 0;
-	char *it = yytext;
+	const char *it = text;
 
 	// detect and handle overflow; overflow is only possible if
 	// 3 digits with first digit is > 3 and 1 byte width
-	if (char_widths[char_width] == 1 && 
-		strlen(yytext) == 4 && yytext[1] > '3') {
+	if (char_widths[lit->width] == 1 && 
+		strlen(text) == 4 && text[1] > '3') {
 		fprintf(stderr, "Warning: octal escape code %s exceeds "
-			"code point width.\n", yytext);
+			"code point width.\n", text);
 	}
 
 	// skip over leading slash
 	while (*++it)
 		val = (val<<3) + (*it-'0');
 
-	append_buffer(&val, char_widths[char_width]);
+	append_buffer(&val, char_widths[lit->width]);
 }
 
 // helper function to convert hexidecimal to decimal;
@@ -242,16 +245,17 @@ static unsigned char htod(char c) {
 	}
 }
 
-void parse_append_hexadecimal() {
+void parse_append_hexadecimal(const char *text) {
 	// see notes for parse_append_octcal
+	struct literal *lit = &cur_ctx->literal;
 	unsigned long val = 0;
-	char *it = yytext + 1;
+	const char *it = text + 1;
 
 	// detect overflow: since each byte is 2 hex digits,
 	// overflow if digits > 2 * char_width
-	if (strlen(yytext) - 2 > 2 * char_widths[char_width]) {
+	if (strlen(text) - 2 > 2 * char_widths[lit->width]) {
 		fprintf(stderr, "Warning: hexadecimal escape code %s exceeds "
-			"code point width.\n", yytext);
+			"code point width.\n", text);
 	}
 
 	// skip over leading \x
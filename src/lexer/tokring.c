@@ -0,0 +1,194 @@
+#include <lexer/tokring.h>
+#include <lexer/fastlex.h>
+#include <lexer/numutils.h>
+#include <parser/parser.h>
+#include <parser.tab.h>
+#include <context.h>
+#include <arena.h>
+#include <common.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// number of tokens in the ring (a power of two)
+#define RING_SIZE	4096
+
+// times that a side waiting for the other checks the ring before it yields
+#define RING_SPINS	64
+
+#define CACHE_LINE	64
+
+// a token, and the state of the lexer after it (see lex_token())
+struct token {
+	int type;
+	YYSTYPE val;
+	char *filename;
+	int lineno, line;
+	const char *text;
+	int len;
+};
+
+struct token_ring {
+	struct token tokens[RING_SIZE];
+
+	// number of tokens that the lexer has put into the ring, and its copy
+	// of tail; only written by the lexer thread
+	unsigned head __attribute__((aligned(CACHE_LINE)));
+	unsigned lexer_tail;
+
+	// number of tokens that the parser has taken from the ring, its copy
+	// of head, and whether it has taken the last one; only written by the
+	// parser
+	unsigned tail __attribute__((aligned(CACHE_LINE)));
+	unsigned parser_head;
+	int done;
+
+	// set by the parser to stop the lexer before the end of the input
+	int stop __attribute__((aligned(CACHE_LINE)));
+
+	// numbers are allocated by the lexer from one of two arenas, switched
+	// every RING_SIZE tokens; an arena is reset when the lexer switches
+	// back to it, by which time the parser has taken (and copied, see
+	// copy_number()) all of the tokens lexed into it
+	struct arena num_arenas[2];
+
+	pthread_t thread;
+};
+
+static void ring_wait(unsigned *spins)
+{
+	if (++*spins < RING_SPINS) {
+#ifdef __x86_64__
+		__builtin_ia32_pause();
+#endif
+	} else {
+		sched_yield();
+	}
+}
+
+static void *lexer_thread(void *arg)
+{
+	struct context *ctx = arg;
+	struct token_ring *ring = ctx->ring;
+	struct token *tok;
+	unsigned head = 0, spins;
+	int type;
+
+	cur_ctx = ctx;
+	do {
+		// wait for a free slot
+		for (spins = 0; head - ring->lexer_tail == RING_SIZE; ) {
+			if (__atomic_load_n(&ring->stop, __ATOMIC_RELAXED)) {
+				return NULL;
+			}
+			ring->lexer_tail = __atomic_load_n(&ring->tail,
+				__ATOMIC_ACQUIRE);
+			if (head - ring->lexer_tail == RING_SIZE) {
+				ring_wait(&spins);
+			}
+		}
+
+		// the parser is past every token that was lexed into the other
+		// arena: the slot of the first of them is free
+		if (!(head % RING_SIZE)) {
+			cur_arena = &ring->num_arenas[head / RING_SIZE % 2];
+			arena_reset(cur_arena);
+		}
+
+		tok = &ring->tokens[head % RING_SIZE];
+		tok->type = type = lex_next(&tok->val);
+		tok->filename = ctx->filename;
+		tok->lineno = ctx->lineno;
+		tok->line = ctx->lex.line;
+		tok->text = ctx->lex.tok;
+		tok->len = ctx->lex.tok_len;
+		__atomic_store_n(&ring->head, ++head, __ATOMIC_RELEASE);
+	} while (type);
+
+	return NULL;
+}
+
+// copy a number (and its type) out of the lexer's arena into the current one
+static union astnode *copy_number(union astnode *num)
+{
+	union astnode *copy, *ts;
+
+	ts = arena_alloc(cur_arena, astnode_sizes[num->num.ts->generic.type]);
+	memcpy(ts, num->num.ts, astnode_sizes[num->num.ts->generic.type]);
+	copy = arena_alloc(cur_arena, astnode_sizes[NT_NUMBER]);
+	memcpy(copy, num, astnode_sizes[NT_NUMBER]);
+	copy->num.ts = ts;
+	return copy;
+}
+
+void tokring_start(void)
+{
+	struct context *ctx = cur_ctx;
+	struct token_ring *ring;
+
+	if (!(ring = aligned_alloc(CACHE_LINE, sizeof(struct token_ring)))) {
+		yyerror_fatal("out of memory");
+	}
+	memset(ring, 0, sizeof(struct token_ring));
+
+	ctx->ring = ring;
+	ctx->intern_shared = 1;
+	if (pthread_create(&ring->thread, NULL, lexer_thread, ctx)) {
+		yyerror_fatal("could not create the lexer thread");
+	}
+}
+
+void tokring_stop(void)
+{
+	struct token_ring *ring = cur_ctx->ring;
+
+	__atomic_store_n(&ring->stop, 1, __ATOMIC_RELAXED);
+	pthread_join(ring->thread, NULL);
+
+	arena_free(&ring->num_arenas[0]);
+	arena_free(&ring->num_arenas[1]);
+	free(ring);
+	cur_ctx->ring = NULL;
+	cur_ctx->intern_shared = 0;
+}
+
+int tokring_next(union YYSTYPE *lval)
+{
+	struct context *ctx = cur_ctx;
+	struct token_ring *ring = ctx->ring;
+	struct token *tok;
+	unsigned spins;
+	int type;
+
+	if (ring->done) {
+		return 0;
+	}
+
+	// wait for a token
+	for (spins = 0; ring->tail == ring->parser_head; ) {
+		ring->parser_head = __atomic_load_n(&ring->head,
+			__ATOMIC_ACQUIRE);
+		if (ring->tail == ring->parser_head) {
+			ring_wait(&spins);
+		}
+	}
+
+	tok = &ring->tokens[ring->tail % RING_SIZE];
+	type = tok->type;
+	*lval = tok->val;
+	if (type == NUMBER) {
+		lval->astnode = copy_number(tok->val.astnode);
+	}
+	ring->done = !type;
+
+	ctx->tok_filename = tok->filename;
+	ctx->tok_lineno = tok->lineno;
+	ctx->tok_line = tok->line;
+	ctx->tok_text = tok->text;
+	ctx->tok_len = tok->len;
+
+	// the slot may be reused as soon as tail is published
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+	return type;
+}
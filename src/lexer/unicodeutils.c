@@ -9,8 +9,8 @@
 // this assumes that utf8_text is also a valid UTF-8 string;
 // returns length of created buffer, or -1 on error;
 // buffer should be manually freed when finished using it
-size_t utowc(char *utf8_text, size_t char_width, void **buf) {
-	char *c = utf8_text;
+size_t utowc(const char *utf8_text, size_t char_width, void **buf) {
+	const char *c = utf8_text;
 	unsigned long value, width, buf_len = 16, cur_len = 0;
 	void *strbuf = malloc(buf_len);
 
@@ -35,7 +35,7 @@ size_t utowc(char *utf8_text, size_t char_width, void **buf) {
 		}
 
 		// realloc if necessary
-		if (char_width * (cur_len+1) < buf_len) {
+		if (char_width * (cur_len+1) > buf_len) {
 			strbuf = realloc(strbuf, buf_len *= 2);
 		}
 
@@ -1,24 +1,62 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <lexer/numutils.h>
-#include <lexer/errorutils.h>
 #include <parser.tab.h>
-#include <parser/scope.h>
-#include <parser/decl.h>
-#include <asmgen/asm.h>
-#include <lex.yy.h>
+#include <asmgen/jit.h>
+#include <compile.h>
+#include <backend.h>
 #include <common.h>
+#include <context.h>
+#include <pthread.h>
+
+// parse the debug dump letters of -d (e.g., -dAQ); returns 0 if the argument
+// isn't made of uppercase letters only, in which case it is a filename
+static int parse_debug_flags(const char *arg)
+{
+	const char *c;
+	unsigned flags = 0;
+
+	for (c = arg; *c; ++c) {
+		if (*c < 'A' || *c > 'Z') {
+			return 0;
+		}
+	}
+
+	for (c = arg; *c; ++c) {
+		switch (*c) {
+		case 'A':	flags |= DEBUG_AST; break;
+		case 'Q':	flags |= DEBUG_QUADS; break;
+		case 'F':	flags |= DEBUG_FRAME; break;
+		case 'S':	flags |= DEBUG_STATS; break;
+		default:
+			fprintf(dfp, "ignoring unknown debug dump -d%c\n", *c);
+		}
+	}
+
+	debug_flags |= flags;
+	return 1;
+}
+
+// number of threads (-j), and output file name (-o)
+static unsigned nthreads;
+static char *out_name;
 
 static int parse_args(int argc, char **argv)
 {
 	int c, i;
 	FILE *fp;
 
-	while ((c = getopt(argc, argv, "d:o:")) != -1) {
+	while ((c = getopt(argc, argv, "cd:j:o:O:pPr")) != -1) {
 		switch (c) {
 
-		// debug output file
+		// debug dumps (uppercase letters) or debug output file
 		case 'd':
+			if (parse_debug_flags(optarg)) {
+				break;
+			}
 			if (!(fp = fopen(optarg, "w+"))) {
 				fprintf(dfp, "could not open debug file %s"
 					" for writing: %s\n",
@@ -30,13 +68,43 @@ static int parse_args(int argc, char **argv)
 
 		// output file
 		case 'o':
-			if (!(fp = fopen(optarg, "w+"))) {
-				fprintf(dfp, "could not open output file %s"
-					" for writing: %s\n",
-					optarg, strerror(errno));
-				break;
+			out_name = optarg;
+			break;
+
+		// emit an object file rather than assembly
+		case 'c':
+			emit_object = 1;
+			break;
+
+		// compile into memory and run main()
+		case 'r':
+			emit_object = run_jit = 1;
+			break;
+
+		// lex on a separate thread
+		case 'p':
+			lex_thread = 1;
+			break;
+
+		// parse function bodies apart from the rest of the file
+		case 'P':
+			split_parse = 1;
+			break;
+
+		// compile files (or generate functions) on n threads
+		case 'j':
+			nthreads = strtoul(optarg, NULL, 10);
+			break;
+
+		// optimization mode: -Os optimizes for code size
+		case 'O':
+			if (!strcmp(optarg, "s")) {
+				optimize_size = 1;
+			} else {
+				optimize_size = 0;
+				fprintf(dfp, "ignoring unknown optimization"
+					" mode -O%s\n", optarg);
 			}
-			ofp = fp;
 			break;
 
 		case '?':
@@ -47,17 +115,142 @@ static int parse_args(int argc, char **argv)
 	return 0;
 }
 
-int main(int argc, char **argv)
+static FILE *open_input(const char *name)
 {
-	int i;
 	FILE *ifp;
 
+	if (!(ifp = fopen(name, "r"))) {
+		fprintf(dfp, "could not open input file %s for reading: %s\n",
+			name, strerror(errno));
+		return NULL;
+	}
+	if (debug_flags) {
+		fprintf(dfp, "Compiling input file %s...\n", name);
+	}
+	return ifp;
+}
+
+/**
+ * SEPARATE COMPILATION
+ *
+ * With -j and several input files, each file is compiled as its own
+ * translation unit, in its own context, into its own output file; the files
+ * are compiled on up to n threads at once, each of which takes the next file
+ * that no one has started on. Functions are generated on the thread that
+ * parses their file.
+ */
+
+static char **inputs;
+static unsigned ninputs, next_input;
+static int failed;
+
+// name of the output file of an input file compiled separately: its base
+// name, with the extension replaced by .s (or .o with -c)
+static char *output_name(const char *name)
+{
+	const char *base = strrchr(name, '/'), *ext;
+	size_t len;
+	char *out;
+
+	base = base ? base + 1 : name;
+	ext = strrchr(base, '.');
+	len = ext && ext != base ? ext - base : strlen(base);
+
+	if (!(out = malloc(len + 3))) {
+		yyerror_fatal("out of memory");
+	}
+	memcpy(out, base, len);
+	memcpy(out + len, emit_object ? ".o" : ".s", 3);
+	return out;
+}
+
+// returns nonzero if the file couldn't be compiled
+static int compile_file(const char *name)
+{
+	FILE *ifp, *ofp = NULL;
+	char *out = output_name(name);
+
+	if (!strcmp(out, name)) {
+		fprintf(dfp, "input file %s would be overwritten by its"
+			" output\n", name);
+	} else if (!(ofp = fopen(out, "w+"))) {
+		fprintf(dfp, "could not open output file %s for writing: %s\n",
+			out, strerror(errno));
+	}
+	free(out);
+	if (!ofp || !(ifp = open_input(name))) {
+		if (ofp) {
+			fclose(ofp);
+		}
+		return 1;
+	}
+
+	begin_unit(ofp);
+	parse_file(ifp);
+	end_unit();
+	context_free(cur_ctx);
+
+	fclose(ifp);
+	fclose(ofp);
+	return 0;
+}
+
+static void *compile_files_worker(void *arg)
+{
+	unsigned i;
+
+	while ((i = __atomic_fetch_add(&next_input, 1, __ATOMIC_RELAXED))
+		< ninputs) {
+		if (compile_file(inputs[i])) {
+			__atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+		}
+	}
+	return NULL;
+}
+
+static int compile_files(char **names, unsigned n)
+{
+	pthread_t *threads;
+	unsigned i;
+
+	inputs = names;
+	ninputs = n;
+
+	// the debug dumps of different files would be interleaved
+	if (debug_flags || nthreads > n) {
+		nthreads = debug_flags ? 1 : n;
+	}
+	if (!(threads = calloc(nthreads, sizeof(pthread_t)))) {
+		yyerror_fatal("out of memory");
+	}
+
+	// the main thread compiles files too
+	for (i = 1; i < nthreads; ++i) {
+		if (pthread_create(&threads[i], NULL, compile_files_worker,
+			NULL)) {
+			yyerror_fatal("could not create worker thread");
+		}
+	}
+	compile_files_worker(NULL);
+	for (i = 1; i < nthreads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	int i, (*main_fn)(int, char **);
+	FILE *ifp, *ofp;
+	struct jit *jit;
+
 #if YYDEBUG
 	yydebug = 1;
 #endif
 
 	// set default file pointers
-	yyin = stdin;
 	dfp = stderr;
 	ofp = stdout;
 
@@ -66,65 +259,79 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	// create default global scope
-	scope_push(0);
+	// the debug dumps follow the order in which the file is parsed, which
+	// split parsing changes
+	if (debug_flags) {
+		split_parse = 0;
+	}
+
+	// the lexer that skips the function bodies runs on the parser thread
+	if (split_parse && lex_thread) {
+		fprintf(dfp, "ignoring -p, which can't be used with -P\n");
+		lex_thread = 0;
+	}
+
+	// several input files with -j are compiled separately, each into its
+	// own output file
+	if (nthreads && argc - optind > 1 && !run_jit) {
+		if (out_name) {
+			fprintf(dfp, "-o cannot be used with -j and several"
+				" input files (each file gets its own output"
+				" file)\n");
+			return 1;
+		}
+		return compile_files(argv + optind, argc - optind);
+	}
+
+	if (out_name && !(ofp = fopen(out_name, "w+"))) {
+		fprintf(dfp, "could not open output file %s for writing: %s\n",
+			out_name, strerror(errno));
+		ofp = stdout;
+	}
+
+	// otherwise, all input files are compiled into one translation unit
+	begin_unit(ofp);
+
+	// the debug dumps of the back end are printed as functions are
+	// generated, so they need a single thread
+	if (debug_flags & ~DEBUG_AST) {
+		nthreads = 0;
+	}
+	backend_start(nthreads > 1 ? nthreads : 0);
 
 	// parse each input file serially
 	if (optind == argc) {
-		yyparse();
+		parse_file(stdin);
 	} else {
 		for (i = optind; i < argc; ++i) {
-			if (!(ifp = fopen(argv[i], "r"))) {
-				fprintf(dfp, "could not open input file %s for"
-					" reading: %s\n",
-					argv[i], strerror(errno));
+			if (!(ifp = open_input(argv[i]))) {
 				continue;
 			}
-			fprintf(dfp, "Compiling input file %s...\n", argv[i]);
-
-			yyin = ifp;
-			yyparse();
-
+			parse_file(ifp);
 			fclose(ifp);
 		}
 	}
 
-	// after file is complete, add global vars to output
-	gen_globalvar_asm(global_vars);
+	backend_finish();
+	end_unit();
+
+	// run the program in memory; its argv[0] is the (first) input file
+	if (run_jit) {
+		if (!(jit = jit_load()) || !(main_fn = (int (*)(int, char **))
+			jit_lookup(jit, "main"))) {
+			fprintf(dfp, "%s\n", jit ? "jit: no main function"
+				: jit_error());
+			return 1;
+		}
+		exit(main_fn(1, (char *[]) {
+			optind < argc ? argv[optind] : "-", NULL }));
+	}
 
 	// close file pointers as appropriate
 	if (dfp != stderr) {
 		fclose(stderr);
 	}
 	if (ofp != stdout) {
-		fclose(stdout);
-	}
-}
-
-// declared in parser.h
-static int is_fatal_error = 0;
-int yyerror(const char *err)
-{
-	char buf[1024];
-
-	// replace default syntax error message
-	if (!strcmp(err, "syntax error")) {
-		is_fatal_error = 1;
-		snprintf(buf, sizeof(buf), "unexpected token \"%s\"\n", yytext);
-		err = buf;
-	}
-
-	fprintf(dfp, "%s:%d: %s: %s\n", filename, yylineno,
-		is_fatal_error ? "error" : "warning", err);
-
-	if (is_fatal_error) {
-		_exit(-1);
+		fclose(ofp);
 	}
 }
-
-// declared in parser.h
-int yyerror_fatal(const char *err)
-{
-	is_fatal_error = 1;
-	yyerror(err);
-}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include <parser/astnode.h>
+
+// allocation size of each astnode type; nodes are only as large as the struct
+// for their type (not the whole union), so a node must only be accessed
+// through the union member for its type (or the generic header)
+const size_t astnode_sizes[] = {
+	[NT_NUMBER]		= sizeof(struct astnode_number),
+	[NT_STRING]		= sizeof(struct astnode_string),
+	[NT_CHARLIT]		= sizeof(struct astnode_charlit),
+	[NT_IDENT]		= sizeof(struct astnode_ident),
+
+	[NT_BINOP]		= sizeof(struct astnode_binop),
+	[NT_UNOP]		= sizeof(struct astnode_unop),
+	[NT_TERNOP]		= sizeof(struct astnode_ternop),
+	[NT_FNCALL]		= sizeof(struct astnode_fncall),
+
+	[NT_TS_SCALAR]		= sizeof(struct astnode_typespec_scalar),
+	[NT_TS_STRUCT_UNION]	= sizeof(struct astnode_typespec_structunion),
+	[NT_TQ]			= sizeof(struct astnode_typequal),
+	[NT_SC]			= sizeof(struct astnode_storageclass),
+
+	[NT_DECLSPEC]		= sizeof(struct astnode_declspec),
+	[NT_DECLARATOR_POINTER]	= sizeof(struct astnode_decl_pointer),
+	[NT_DECLARATOR_FUNCTION]= sizeof(struct astnode_decl_function),
+	[NT_DECLARATOR_ARRAY]	= sizeof(struct astnode_decl_array),
+	[NT_DECL]		= sizeof(struct astnode_decl),
+
+	[NT_STMT_EXPR]		= sizeof(struct astnode_stmt_expr),
+	[NT_STMT_LABEL]		= sizeof(struct astnode_stmt_label),
+	[NT_STMT_COMPOUND]	= sizeof(struct astnode_stmt_compound),
+	[NT_STMT_IFELSE]	= sizeof(struct astnode_stmt_if_else),
+	[NT_STMT_SWITCH]	= sizeof(struct astnode_stmt_switch),
+	[NT_STMT_DO_WHILE]	= sizeof(struct astnode_stmt_do_while),
+	[NT_STMT_WHILE]		= sizeof(struct astnode_stmt_while),
+	[NT_STMT_FOR]		= sizeof(struct astnode_stmt_for),
+	[NT_STMT_GOTO]		= sizeof(struct astnode_stmt_goto),
+	[NT_STMT_CONT]		= sizeof(struct astnode_stmt_break_cont),
+	[NT_STMT_BREAK]		= sizeof(struct astnode_stmt_break_cont),
+	[NT_STMT_RETURN]	= sizeof(struct astnode_stmt_return),
+};
+
+void arglist_append(struct arglist *arglist, union astnode *arg)
+{
+	union astnode **args;
+
+	// double the array; the old one is left behind in the arena
+	if (arglist->argc == arglist->cap) {
+		arglist->cap = arglist->cap ? arglist->cap * 2 : 4;
+		args = arena_alloc(cur_arena,
+			arglist->cap * sizeof(union astnode *));
+		if (arglist->argc) {
+			memcpy(args, arglist->args,
+				arglist->argc * sizeof(union astnode *));
+		}
+		arglist->args = args;
+	}
+
+	arglist->args[arglist->argc++] = arg;
+}
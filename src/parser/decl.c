@@ -1,12 +1,56 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <common.h>
 #include <parser/parser.h>
 #include <parser/astnode.h>
 #include <parser/decl.h>
 #include <parser/scope.h>
 #include <parser/printutils.h>
+#include <parser/split.h>
+#include <quads/sizeof.h>
+#include <context.h>
+
+// global_vars (see context.h) is used after the function arena is reset (the
+// variables are emitted at the end of the file), so static/extern variables
+// declared in a function body are copied into the file arena; only the name
+// and size are needed for that, so the copy gets an equally-sized char array
+// type rather than a deep copy of the original type
+static union astnode *decl_persist(union astnode *decl)
+{
+	union astnode *copy, *ts, *declspec, *length, *array;
+	struct arena *arena = cur_arena;
+	unsigned size;
+
+	if (cur_arena == &cur_ctx->file_arena) {
+		return decl;
+	}
 
-union astnode *global_vars;
+	size = astnode_sizeof_symbol(decl);
+	cur_arena = &cur_ctx->file_arena;
+
+	ALLOC_TYPE(ts, NT_TS_SCALAR);
+	ts->ts_scalar.basetype = BT_CHAR;
+	ALLOC_TYPE(declspec, NT_DECLSPEC);
+	declspec->declspec.ts = ts;
+	declspec->declspec.sc = decl->decl.declspec->declspec.sc;
+
+	ALLOC_TYPE(length, NT_NUMBER);
+	*((uint64_t*)length->num.buf) = size;
+	ALLOC_TYPE(array, NT_DECLARATOR_ARRAY);
+	array->decl_array.length = length;
+	array->decl_array.of = declspec;
+
+	// (the ident and static_uid are interned, and thus live as long as the
+	// file)
+	ALLOC_TYPE(copy, NT_DECL);
+	copy->decl = decl->decl;
+	copy->decl.components = array;
+	copy->decl.declspec = declspec;
+	copy->decl.scope = NULL;
+
+	cur_arena = arena;
+	return copy;
+}
 
 union astnode *decl_new(char *ident)
 {
@@ -14,16 +58,19 @@ union astnode *decl_new(char *ident)
 
 	ALLOC_TYPE(decl, NT_DECL);
 
-	// ident can be NULL (abstract decl)
-	if (ident) {
-		decl->decl.ident = strdup(ident);
-	}
+	// ident can be NULL (abstract decl); it is interned by the lexer
+	decl->decl.ident = ident;
 
 	return decl;
 }
 
 union astnode *decl_append(union astnode *decl, union astnode *components)
 {
+	// the components so far are in reverse order (see decl_reverse()), so
+	// the new ones go in front of them: only the new chain is walked (a
+	// run of pointers, or a single array or function component), not the
+	// declarator, so each component is visited once and building a
+	// declarator is linear in its number of components
 	LL_APPEND_OF(components, decl->decl.components);
 	decl->decl.components = components;
 
@@ -171,18 +218,43 @@ union astnode *decl_function_new(union astnode *paramdecls)
 	return decl_function;
 }
 
+// give a static variable or function a unique identifier
+static void decl_static_uid(union astnode *decl)
+{
+	struct intern *rec = INTERN_REC(decl->decl.ident);
+	char *buf;
+	int len;
+
+	// name.N, where N - 1 is the number of global variables with the same
+	// name before it; the names only depend on the order of the source
+	if (!(buf = malloc(rec->len + 12))) {
+		yyerror_fatal("out of memory");
+	}
+	len = sprintf(buf, "%s.%u", rec->str, rec->globals + 1);
+	decl->decl.static_uid = intern_len(buf, len);
+	free(buf);
+}
+
+void decl_add_global(union astnode *decl)
+{
+	union astnode *persist;
+
+	if (decl->decl.declspec->declspec.sc->sc.scspec == SC_STATIC) {
+		decl_static_uid(decl);
+	}
+
+	persist = decl_persist(decl);
+	persist->decl.symbol_next = cur_ctx->global_vars;
+	cur_ctx->global_vars = persist;
+	++INTERN_REC(decl->decl.ident)->globals;
+}
+
 void decl_install(union astnode *decl, union astnode *declspec)
 {
-	FILE *fp = stdout;
 	char *ident;
 	struct scope *scope;
 	union astnode *sc;
-	unsigned static_id;
-	union astnode *iter;
-
-	// note: this limits static variable names to be <256 characters long,
-	// which (should?) be plenty long enough
-	char static_uid_buf[256];
+	struct fn_body *body;
 
 	// get ident from declarator
 	ident = decl->decl.ident;
@@ -191,8 +263,8 @@ void decl_install(union astnode *decl, union astnode *declspec)
 	decl_finalize(decl, declspec);
 
 	// set lineno, filename
-	decl->decl.lineno = lineno;
-	decl->decl.filename = filename;
+	decl->decl.lineno = cur_ctx->tok_lineno;
+	decl->decl.filename = cur_ctx->tok_filename;
 
 	// insert into symbol table
 	if (!(scope = scope_insert(ident, NS_IDENT, decl))) {
@@ -218,48 +290,45 @@ void decl_install(union astnode *decl, union astnode *declspec)
 	// check fndecl (will have no effect if not a function declaration)
 	decl_check_fndecl(decl);
 
-	// special treatment for static variables: give it a unique identifier
-	sc = decl->decl.declspec->declspec.sc;
-	if (sc->sc.scspec == SC_STATIC) {
-		static_id = 0;
-		_LL_FOR(global_vars, iter, decl.symbol_next) {
-			if (!strcmp(iter->decl.ident, decl->decl.ident)) {
-				++static_id;
-			}
-		}
-
-		sprintf(static_uid_buf, "%s.%d", decl->decl.ident, static_id+1);
-		decl->decl.static_uid = strdup(static_uid_buf);
-	}
-
 	// add this variable to the linked list of variables (either global
 	// or local); if in global scope or has static/extern duration, then
 	// global; else local; calculate offset from base pointer
 	// TODO: confirm that it is global scope or static/extern
-	if (NT(decl->decl.components) != NT_DECLARATOR_FUNCTION) {
-		// global scope
-		if (sc->sc.scspec == SC_STATIC || sc->sc.scspec == SC_EXTERN
-			|| scope->type == ST_FILE) {
-			decl->decl.symbol_next = global_vars;
-			global_vars = decl;
-		}
-		// prototype scope
-		else if (scope->type == ST_PROTO) {
-			decl->decl.symbol_next = scope->symbols_ll;
-			scope->symbols_ll = decl;
+	sc = decl->decl.declspec->declspec.sc;
+	if (NT(decl->decl.components) == NT_DECLARATOR_FUNCTION) {
+		// special treatment for static functions: give it a unique
+		// identifier
+		if (sc->sc.scspec == SC_STATIC) {
+			decl_static_uid(decl);
 		}
-		// local scope: add to nearest function scope symbols ll
-		else {
-			scope = get_fn_scope();
-			decl->decl.symbol_next = scope->symbols_ll;
-			scope->symbols_ll = decl;
+	}
+	// global scope
+	else if (sc->sc.scspec == SC_STATIC || sc->sc.scspec == SC_EXTERN
+		|| scope->type == ST_FILE) {
+		// a split-off function body adds its variables in source
+		// order once it has been parsed (see split.h)
+		if ((body = cur_ctx->split_body)) {
+			decl->decl.symbol_next = NULL;
+			_LL_TAIL_APPEND(body->globals, decl, decl.symbol_next);
+		} else {
+			decl_add_global(decl);
 		}
 	}
-	
+	// prototype scope
+	else if (scope->type == ST_PROTO) {
+		decl->decl.symbol_next = scope->symbols_ll;
+		scope->symbols_ll = decl;
+	}
+	// local scope: add to nearest function scope symbols ll
+	else {
+		scope = get_fn_scope();
+		decl->decl.symbol_next = scope->symbols_ll;
+		scope->symbols_ll = decl;
+	}
 
-#if DEBUG
-	print_symbol(decl, 1, 0);
-#endif
+	if (DEBUGGING(DEBUG_AST)) {
+		print_symbol(decl, 1, 0);
+	}
 }
 
 void decl_check_fndecl(union astnode *decl)
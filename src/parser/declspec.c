@@ -151,8 +151,7 @@ union astnode *merge_declspec(union astnode *spec1, union astnode *spec2) {
 		ds1.sc = ds2.sc;
 	}
 
-	// cleanup
-	free(spec2);
+	// spec2 is abandoned (arena-allocated, see arena.h)
 	spec1->declspec = ds1;
 	return spec1;
 }
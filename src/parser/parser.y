@@ -1,5 +1,6 @@
 %debug
 %define parse.error verbose
+%define api.pure full
 %{
 #define YYDEBUG 0
 
@@ -13,13 +14,25 @@
 #include <parser/structunion.h>
 #include <parser/decl.h>
 #include <parser/stmt.h>
+#include <parser/split.h>
 #include <quads/quads.h>
+#include <quads/exprquads.h>
 #include <asmgen/asm.h>
+#include <backend.h>
+#include <context.h>
 #include <stdio.h>
 
 int yydebug;
 %}
 
+%code {
+#include <lexer/fastlex.h>
+
+// the input is lexed by the fast path lexer (or by flex, if it isn't
+// memory-mapped) of the current context
+#define yylex(lval)	lex_token(lval)
+}
+
 %union {
 	// from lexer
 	int sc;	// single-character tokens
@@ -27,9 +40,12 @@ int yydebug;
 	char *ident;
 	struct string string;
 	struct charlit charlit;
+	struct fn_body *body;		// skipped function body
 	
 	// from syntax parsing
 	union astnode *astnode;		// abstract syntax tree
+	struct astnode_ll ll;		// lists that are appended to
+	struct arglist arglist;		// fncall arguments
 }
 
 %token		IDENT NUMBER CHARLIT STRING
@@ -44,6 +60,10 @@ int yydebug;
 %token<sc>	',' '=' '?' ':' '|' '^' '&' '<' '>' '+' '-' '*' '/' '%' '!' '~'
 %token<sc>	'(' ')' '[' ']' '.'
 
+/* function body skipped by the lexer, and the start of the parse of one (see split.h) */
+%token<body>	FNBODY
+%token		SPLITSTART
+
 /* reference: https://en.cppreference.com/w/c/language/operator_precedence
  * these are redundant because of rule hierarchy but still nice to have in
  * one place */
@@ -75,17 +95,19 @@ int yydebug;
 %left ELSE
 
 %type<sc> 	uop
-%type<astnode>	constant pexpr pofexpr arglist arglistopt uexpr
+%type<astnode>	constant pexpr pofexpr uexpr
+%type<arglist>	arglist arglistopt
 %type<astnode>	castexpr multexpr addexpr shftexpr relexpr eqexpr andexpr
 %type<astnode>	xorexpr orexpr logandexpr logorexpr condexpr asnmtexpr expr
 %type<astnode>	decl initdecllist initdecl typespec scspec declspec typequal
 %type<astnode>	pointer dirdeclarator typequallist declarator
-%type<astnode>	paramlist paramtypelist paramdecl absdeclarator declspeclist
+%type<astnode>	paramtypelist paramdecl absdeclarator declspeclist
+%type<ll>	paramlist blockitemlist
 %type<astnode>	specquallist typename dirabsdeclarator paramtypelistopt
 %type<astnode>	structunionspec structunion structdeclaratorlist
 %type<astnode>	structdeclarator specqual exprstmt fordecl labeledstmt
 %type<astnode>	stmt compoundstmt selectionstmt iterationstmt jumpstmt
-%type<astnode>	blockitemlist blockitem translnunit externdecl funcdef
+%type<astnode>	blockitem translnunit externdecl funcdef fndeclarator
 %type<ident> 	IDENT
 %type<string>	STRING
 %type<charlit>	CHARLIT
@@ -93,7 +115,11 @@ int yydebug;
 %%
 /* beware, the document gets wide here (rip 80 characters) */
 
-/* top level is translation unit (from 6.9 external definitions) */
+/* top level is translation unit (from 6.9 external definitions), or a function body that was split off from one (see split.h) */
+start:		translnunit							{/*nothing to do*/}
+		| SPLITSTART compoundstmt					{cur_ctx->split_body->fndecl->decl.fn_body=$2;}
+		;
+
 translnunit: 	externdecl 							{/*nothing to do*/}
 		| translnunit externdecl					{/*nothing to do*/}
 		;
@@ -105,7 +131,7 @@ translnunit: 	externdecl 							{/*nothing to do*/}
 /* 6.4.4 */
 constant:	NUMBER								{$$=$1;}
 		/*| enumconst							{/*not implementing enums}*/
-		| CHARLIT							{ALLOC($$);$$->charlit=(struct astnode_charlit){NT_CHARLIT,NULL,$1};}
+		| CHARLIT							{ALLOC_TYPE($$,NT_CHARLIT);$$->charlit=(struct astnode_charlit){NT_CHARLIT,NULL,$1};}
 		;
 
 /* primary expr: 6.5.1 */
@@ -113,7 +139,10 @@ pexpr:		IDENT								{$$=scope_lookup($1,NS_IDENT);
 										 /*if not found indicate it with dummy pexpr*/
 										 if(!$$){ALLOC_IMPL_FN($$,$1);}}
 		| constant							{$$=$1;}
-		| STRING							{ALLOC($$);$$->string=(struct astnode_string){NT_STRING,NULL,$1};}
+		| STRING							{ALLOC_TYPE($$,NT_STRING);$$->string=(struct astnode_string){NT_STRING,NULL,$1};
+										 /*a split-off function body pools its strings in order once it has been parsed (see split.h)*/
+										 if(cur_ctx->split_body){_LL_TAIL_APPEND(cur_ctx->split_body->strings,$$,string.symbol_next);}
+										 else{$$->string.label=string_pool_get(&$1)->string.label;}}
 		| '(' expr ')'							{$$=$2;}
 		;
 
@@ -124,7 +153,7 @@ pofexpr:	pexpr								{$$=$1;}
 										 CHECK_SYM_FOUND($1);
 										 ALLOC_SET_BINOP(inner,'+',$1,$3);
 										 ALLOC_SET_UNOP($$,'*',inner);}
-		| pofexpr '(' arglistopt ')'					{ALLOC($$);
+		| pofexpr '(' arglistopt ')'					{ALLOC_TYPE($$,NT_FNCALL);
 										 /*implicit declaration warning*/
 										 CHECK_SYM_FOUND_WARN($1);
 										 $$->fncall=(struct astnode_fncall){NT_FNCALL,NULL,$1,$3};}
@@ -146,12 +175,12 @@ pofexpr:	pexpr								{$$=$1;}
 		| '(' typename ')' '{' initlist ',' '}'				{not implementing compound literals}*/
 		;
 
-arglist:	asnmtexpr							{$$=$1;}
-		| arglist ',' asnmtexpr						{$$=$1;LL_APPEND($1,$3);}
+arglist:	asnmtexpr							{$$=(struct arglist){0};arglist_append(&$$,$1);}
+		| arglist ',' asnmtexpr						{$$=$1;arglist_append(&$$,$3);}
 		;
 
 arglistopt:	arglist								{$$=$1;}
-		|								{$$=NULL;}
+		|								{$$=(struct arglist){0};}
 		;
 
 /* unary operators: 6.5.3; doesn't include C11 _Alignof */
@@ -404,12 +433,12 @@ typequallist:	typequal							{ALLOC_TYPE($$,NT_DECLSPEC);$$->declspec.tq=$1;}
 										 $$=merge_declspec($1,$$);}
 		;
 
-paramtypelist:	paramlist							{$$=$1;}
-		| paramlist ',' ELLIPSIS					{$$=$1;LL_APPEND($1,ELLIPSIS_DECLARATOR);}
+paramtypelist:	paramlist							{$$=$1.head;}
+		| paramlist ',' ELLIPSIS					{LL_TAIL_APPEND($1,ELLIPSIS_DECLARATOR);$$=$1.head;}
 		;
 
-paramlist:	paramdecl							{$$=$1;}
-		| paramlist ',' paramdecl					{$$=$1;LL_APPEND($1,$3);}
+paramlist:	paramdecl							{$$=(struct astnode_ll){$1,$1};}
+		| paramlist ',' paramdecl					{$$=$1;LL_TAIL_APPEND($$,$3);}
 		;
 
 paramdecl:	declspeclist declarator						{$$=$2;decl_install($2,$1);}
@@ -483,14 +512,12 @@ labeledstmt:	IDENT ':' stmt							{ALLOC_STMT_LABEL($$, LABEL_NAMED, $1, NULL, $
 
 /* 6.8.2 compound statement */
 compoundstmt:	'{' {scope_push(0);} blockitemlist {scope_pop();} '}'		{/*have to be wary that since next token is seen by the time of the midrule action*/
-										 ALLOC_STMT_COMPOUND($$,$3);}
+										 ALLOC_STMT_COMPOUND($$,$3.head);}
 		| '{' {scope_push(0);scope_pop();} '}'				{ALLOC_STMT_COMPOUND($$,NULL);}
 		;
 
-blockitemlist:	blockitem							{$$=$1;}
-		| blockitemlist blockitem					{if(!$1) {$$=$2;}
-										 else if(!$2) {$$=$1;}
-										 else {$$=$1;LL_APPEND($1,$2);}}
+blockitemlist:	blockitem							{$$=(struct astnode_ll){$1,$1};}
+		| blockitemlist blockitem					{$$=$1;if($2){LL_TAIL_APPEND($$,$2);}}
 		;
 
 blockitem:	decl								{/*don't need to do anything*/}
@@ -544,18 +571,26 @@ externdecl: 	funcdef								{$$=$1;}
 		;
 
 /* 6.9.1 Function definitions */
-funcdef:	declspeclist declarator {decl_check_fndef($2);scope_set_fndef();decl_install($2,$1);} compoundstmt
+funcdef:	fndeclarator {/*function body is allocated from the function arena*/
+										 fn_arena_begin();} compoundstmt
 										{/*note that this doesn't allow for old fndef syntax*/
-										 $$=$2;
-										 $2->decl.fn_body=$4;
+										 $$=$1;
+										 $1->decl.fn_body=$3;
 										 /*scopes get "lost" after pop, so need this*/
-										 associate_fn_with_scope($2);
+										 associate_fn_with_scope($1);
 										 /*print function body*/
-										 print_astnode($$);
-										 /*generate quads for this function*/
-										 struct basic_block *quads=generate_quads($$);
-										 /*generate target code for this function*/
-										 generate_asm($$,quads);}
+										 if(DEBUGGING(DEBUG_AST))print_astnode($$);
+										 /*generate quads and target code for this function
+										   (possibly on another thread); the body and its
+										   scopes are gone once its code has been output*/
+										 backend_submit($$,cur_arena);
+										 fn_arena_end();}
+		| fndeclarator FNBODY						{/*the body is parsed on its own later (see split.h)*/
+										 $$=$1;
+										 split_defer($1,$2);}
+		;
+
+fndeclarator:	declspeclist declarator						{decl_check_fndef($2);scope_set_fndef();decl_install($2,$1);$$=$2;}
 		;
 
 %%
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <parser/structunion.h>
 #include <parser/printutils.h>
 #include <parser.tab.h>
+#include <context.h>
 
 void print_typespec(union astnode *node)
 {
@@ -80,7 +81,7 @@ void print_structunion_def(union astnode *node)
 		su->ident, su->def_filename, su->def_lineno);
 
 	// loop through fields
-	iter = su->members;
+	iter = su->members.head;
 	while (iter) {
 		print_symbol(iter, 0, 1);
 		iter = iter->generic.next;
@@ -237,7 +238,8 @@ void print_symbol(union astnode *node, int is_not_member, int depth)
 	}
 	fprintf(dfp, "\n");
 	INDENT(depth+1);
-	fprintf(dfp, "at %s:%d [in ", filename, lineno);
+	fprintf(dfp, "at %s:%d [in ", cur_ctx->tok_filename,
+		cur_ctx->tok_lineno);
 	print_scope(is_not_member ? get_scope(node->decl.ident, NS_IDENT)
 		: get_current_scope());
 	fprintf(dfp, "] as a\n");
@@ -398,24 +400,18 @@ void print_expr(union astnode *node, int depth)
 		break;
 
 	case NT_FNCALL:;
-		// count number of arguments
-		int argc = 0;
-		union astnode *argnode = node->fncall.arglist;
-		while (argnode) {
-			++argc;
-			argnode = argnode->generic.next;
-		}
-		fprintf(dfp, "FNCALL,  %d  arguments\n", argc);
+		fprintf(dfp, "FNCALL,  %d  arguments\n",
+			node->fncall.arglist.argc);
 
 		// print function declarator
 		print_expr(node->fncall.fnname, depth+1);
 
 		// print arglist
-		for (argc=0, argnode=node->fncall.arglist; argnode;
-			++argc, argnode = argnode->generic.next) {
+		unsigned argc;
+		for (argc = 0; argc < node->fncall.arglist.argc; ++argc) {
 			INDENT(depth);
 			fprintf(dfp, "arg  #%d=\n", argc+1);
-			print_expr(argnode, depth+1);
+			print_expr(node->fncall.arglist.args[argc], depth+1);
 		}
 		break;
 	}
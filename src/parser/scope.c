@@ -2,17 +2,37 @@
 #include <parser/scope.h>
 #include <parser/parser.h>
 #include <lexer/errorutils.h>
+#include <parser/split.h>
+#include <context.h>
 #include <stdio.h>
 
-static struct scope **scope_stack = NULL;
-static int scope_pos = -1, scope_stack_capacity = 0;
+// the scope stack and its flags are part of the current context (see
+// context.h)
+#define scope_stack		(cur_ctx->scope_stack)
+#define scope_pos		(cur_ctx->scope_pos)
+#define scope_stack_capacity	(cur_ctx->scope_stack_capacity)
+#define prev_fn_scope		(cur_ctx->prev_fn_scope)
+#define prototype_hold		(cur_ctx->prototype_hold)
+#define is_fndef		(cur_ctx->is_fndef)
+
+// grow scope_stack if necessary to hold n scopes
+static void scope_stack_reserve(int n)
+{
+	if (scope_stack_capacity >= n) {
+		return;
+	}
 
-// see associate_fn_with_scope
-static struct scope *prev_fn_scope = NULL;
+	// stack has never been initialized, give it an initial value
+	if (!scope_stack_capacity) {
+		scope_stack_capacity = 16;
+	}
+	while (scope_stack_capacity < n) {
+		scope_stack_capacity *= 2;
+	}
+	scope_stack = realloc(scope_stack,
+		scope_stack_capacity * sizeof(struct scope *));
+}
 
-// special flag used for transferring prototype scopes to function scopes
-// if definition (function body) follows function declaration
-static int prototype_hold = 0, is_fndef = 0;
 void scope_set_fndef()
 {
 	is_fndef = 1;
@@ -60,6 +80,13 @@ void scope_push(enum scope_type type)
 
 			prev_fn_scope = scope_stack[1];
 
+			// the prototype scope's tables were allocated in the file
+			// arena; the function's arena is current by now (see the
+			// funcdef rule), so the locals go in it (cf.
+			// scope_attach_proto())
+			for (i = 0; i < 3; i++) {
+				scope_stack[1]->ns[i].arena = cur_arena;
+			}
 			scope_stack[1]->type = ST_FUNC;
 			prototype_hold = 0;
 			// TODO: check that there are no abstract declarators?
@@ -71,29 +98,19 @@ void scope_push(enum scope_type type)
 		}
 	}
 
-	// grow scope_stack if necessary
-	if (scope_stack_capacity <= scope_pos + 1) {
-		// stack has never been initialized, give it an initial value
-		if (!scope_stack_capacity) {
-			scope_stack_capacity = 16;
-		} else {
-			scope_stack_capacity *= 2;
-		}
-		scope_stack = realloc(scope_stack,
-			scope_stack_capacity * sizeof(struct scope *));
-	}
+	scope_stack_reserve(scope_pos + 2);
 
 	// create scope
 	struct scope *scope = scope_stack[++scope_pos]
-		= calloc(1, sizeof(struct scope));
+		= ARENA_NEW(struct scope);
 	for (i = 0; i < 3; i++) {
 		symtab_init(&scope->ns[i]);
 	}
 
 	// set scope parameters
 	scope->type = type;
-	scope->filename = strdup(filename);
-	scope->lineno = lineno;
+	scope->filename = cur_ctx->tok_filename;
+	scope->lineno = cur_ctx->tok_lineno;
 }
 
 // scope ended, destroy it
@@ -139,9 +156,9 @@ static int extern_redeclaration(char *ident, enum name_space ns,
 	}
 		
 	// shouldn't be a warning but here for debugging
-#ifdef DEBUG
-	yyerror("previously-declared extern variable");
-#endif
+	if (DEBUGGING(DEBUG_AST)) {
+		yyerror("previously-declared extern variable");
+	}
 	
 	// TODO: check that types are compatible
 
@@ -150,7 +167,7 @@ static int extern_redeclaration(char *ident, enum name_space ns,
 
 	// replace input decl with old declaration
 	// TODO: discard new declaration
-	*node = *search;
+	node->decl = search->decl;
 
 	// redeclaration
 	return 1;
@@ -196,6 +213,21 @@ struct scope *scope_insert(char *ident, enum name_space ns, union astnode *node)
 	return scope;
 }
 
+// looks up a symbol in one scope of the stack; a split-off function body only
+// sees the symbols of the file scope that were declared before it (see
+// split.h)
+static union astnode *scope_lookup_at(int pos, char *ident,
+	enum name_space ns)
+{
+	struct symtab *st = &scope_stack[pos]->ns[ns];
+
+	if (!pos && cur_ctx->split_body) {
+		return symtab_lookup_before(st, ident,
+			cur_ctx->split_body->visible[ns]);
+	}
+	return symtab_lookup(st, ident);
+}
+
 // traverses up the stack to lookup a symbol
 union astnode *scope_lookup(char *ident, enum name_space ns)
 {
@@ -204,7 +236,7 @@ union astnode *scope_lookup(char *ident, enum name_space ns)
 
 	for (current_scope = scope_pos;
 		current_scope >= 0 && !(search =
-		symtab_lookup(&scope_stack[current_scope]->ns[ns], ident));
+		scope_lookup_at(current_scope, ident, ns));
 		--current_scope);
 
 	return search;
@@ -218,7 +250,7 @@ struct scope *get_scope(char *ident, enum name_space ns)
 
 	for (current_scope = scope_pos;
 		current_scope >= 0 && !(search =
-		symtab_lookup(&scope_stack[current_scope]->ns[ns], ident));
+		scope_lookup_at(current_scope, ident, ns));
 		--current_scope);
 
 	return current_scope >= 0 ? scope_stack[current_scope] : NULL;
@@ -242,4 +274,39 @@ struct scope *get_fn_scope()
 void associate_fn_with_scope(union astnode *fn_decl)
 {
 	fn_decl->decl.fn_scope = prev_fn_scope;
-}
\ No newline at end of file
+}
+
+struct scope *scope_detach_proto(void)
+{
+	struct scope *proto;
+
+	if (!prototype_hold) {
+		return NULL;
+	}
+
+	// the scope isn't destroyed, since the body will be parsed in it
+	proto = scope_stack[1];
+	--scope_pos;
+	prototype_hold = 0;
+	return proto;
+}
+
+void scope_attach_proto(struct scope *file_scope, struct scope *proto)
+{
+	int i;
+
+	scope_stack_reserve(2);
+	scope_stack[scope_pos = 0] = file_scope;
+	if (!proto) {
+		return;
+	}
+
+	// the symbols declared at the top level of the body go in the
+	// prototype scope (see scope_push()), whose tables were allocated in
+	// the file arena; new tables are allocated in the function's arena
+	for (i = 0; i < 3; i++) {
+		proto->ns[i].arena = cur_arena;
+	}
+	scope_stack[scope_pos = 1] = proto;
+	prototype_hold = 1;
+}
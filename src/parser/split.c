@@ -0,0 +1,100 @@
+#include <parser/split.h>
+#include <parser/scope.h>
+#include <parser/decl.h>
+#include <quads/exprquads.h>
+#include <lexer/fastlex.h>
+#include <parser.tab.h>
+#include <backend.h>
+#include <context.h>
+
+void split_begin(void)
+{
+	cur_ctx->lex.split = SPLIT_FILE;
+}
+
+void split_defer(union astnode *fndecl, struct fn_body *body)
+{
+	struct context *ctx = cur_ctx;
+	struct scope *file_scope;
+	int i;
+
+	body->fndecl = fndecl;
+	body->proto = scope_detach_proto();
+
+	// the function itself has been declared
+	file_scope = get_current_scope();
+	for (i = 0; i < 3; ++i) {
+		body->visible[i] = file_scope->ns[i].seq;
+	}
+
+	if (ctx->bodies_tail) {
+		ctx->bodies_tail->next = body;
+	} else {
+		ctx->bodies = body;
+	}
+	ctx->bodies_tail = body;
+}
+
+void split_end(void)
+{
+	struct context *ctx = cur_ctx;
+	struct fn_body *body;
+
+	ctx->lex.split = SPLIT_NONE;
+	if (!ctx->bodies) {
+		return;
+	}
+
+	// the file scope doesn't change from here on, and the bodies intern
+	// their identifiers into the table of the file
+	ctx->intern_shared = 1;
+	for (body = ctx->bodies; body; body = body->next) {
+		backend_submit_body(body);
+	}
+
+	// (the bodies are lexed from the mapping of the file)
+	backend_wait_parsed();
+	ctx->intern_shared = 0;
+	ctx->bodies = ctx->bodies_tail = NULL;
+}
+
+void split_parse_body(struct fn_body *body)
+{
+	struct context *unit = cur_ctx, *ctx = context_new(NULL);
+
+	ctx->unit = unit;
+	ctx->split_body = body;
+	ctx->filename = body->filename;
+	ctx->lineno = body->lineno;
+	ctx->lex.line = body->line;
+	ctx->lex.pos = body->start;
+	ctx->lex.end = body->end;
+	ctx->lex.avx2 = unit->lex.avx2;
+	ctx->lex.split = SPLIT_BODY;
+
+	context_enter(ctx);
+	body->arena = fn_arena_begin();
+	scope_attach_proto(unit->scope_stack[0], body->proto);
+	yyparse();
+	associate_fn_with_scope(body->fndecl);
+
+	context_free(ctx);
+	cur_ctx = unit;
+	cur_arena = body->arena;
+}
+
+void split_finish(struct fn_body *body)
+{
+	union astnode *iter, *next;
+
+	_LL_FOR(body->strings.head, iter, string.symbol_next) {
+		iter->string.label =
+			string_pool_get(&iter->string.string)->string.label;
+	}
+
+	// (decl_add_global() links the variables into global_vars)
+	for (iter = body->globals.head; iter; iter = next) {
+		next = iter->decl.symbol_next;
+		decl_add_global(iter);
+	}
+}
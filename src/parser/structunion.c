@@ -6,10 +6,13 @@
 #include <string.h>
 #include <parser/printutils.h>
 #include <lexer/errorutils.h>
+#include <context.h>
 
-// stack of union astnodes currently being declared
-static union astnode **su_decl_stack = NULL;
-int su_decl_stack_pos = -1, su_decl_stack_capacity = 0;
+// stack of union astnodes currently being declared, in the current context
+// (see context.h)
+#define su_decl_stack		(cur_ctx->su_decl_stack)
+#define su_decl_stack_pos	(cur_ctx->su_decl_stack_pos)
+#define su_decl_stack_capacity	(cur_ctx->su_decl_stack_capacity)
 
 void structunion_new(enum structunion_type type)
 {
@@ -27,13 +30,12 @@ void structunion_new(enum structunion_type type)
 	}
 
 	// create new struct/union
-	ALLOC(node);
+	ALLOC_TYPE(node, NT_TS_STRUCT_UNION);
 	su = &node->ts_structunion;
 
 	// fill in struct fields
-	su->type = NT_TS_STRUCT_UNION;
 	su->ident = NULL;
-	su->members = NULL;
+	su->members = (struct astnode_ll) { NULL, NULL };
 	su->su_type = type;
 	symtab_init(&su->members_ht);
 	su->is_complete = su->is_being_defined = 0;
@@ -69,8 +71,8 @@ void structunion_set_name(char *ident, int begin_def)
 			yyerror_fatal("nested struct/union redefinition");
 		}
 
-		// replace top of stack with found, set begin_def
-		free(su_decl_stack[su_decl_stack_pos]);
+		// replace top of stack with found, set begin_def (the new
+		// node is simply abandoned in the arena)
 		su_decl_stack[su_decl_stack_pos] = node;
 		su->is_being_defined = begin_def;
 	}
@@ -92,7 +94,7 @@ void structunion_set_name(char *ident, int begin_def)
 			su = &node->ts_structunion;
 
 			// set name, is_being_defined
-			su->ident = ident ? strdup(ident) : "(untagged)";
+			su->ident = ident ? ident : "(untagged)";
 			su->is_being_defined = begin_def;
 
 			// insert into symtab
@@ -104,8 +106,8 @@ void structunion_set_name(char *ident, int begin_def)
 
 	// debugging info
 	if (begin_def) {
-		su->def_filename = strdup(filename);
-		su->def_lineno = lineno;
+		su->def_filename = cur_ctx->tok_filename;
+		su->def_lineno = cur_ctx->tok_lineno;
 	}
 }
 
@@ -136,11 +138,7 @@ void structunion_install_member(union astnode *decl, union astnode *declspec)
 	symtab_insert(&su->members_ht, ident, decl);
 
 	// install (symbol) into linked list
-	if (!su->members) {
-		su->members = decl;
-	} else {
-		LL_APPEND(su->members, decl);
-	}
+	LL_TAIL_APPEND(su->members, decl);
 }
 
 union astnode *structunion_done(int is_complete)
@@ -158,7 +156,7 @@ union astnode *structunion_done(int is_complete)
 	su = &node->ts_structunion;
 
 	// print out definition (only if just defined)
-	if (su->is_being_defined && is_complete) {
+	if (DEBUGGING(DEBUG_AST) && su->is_being_defined && is_complete) {
 		// push dummy struct/union scope (for printing purposes)
 		scope_push(ST_STRUCTUNION);
 		dummy_scope = get_current_scope();
@@ -199,7 +197,7 @@ void structunion_forward_declare(char *tag, enum structunion_type type)
 	// from structunion_set_name()
 	node = su_decl_stack[su_decl_stack_pos];
 	su = &node->ts_structunion;
-	su->ident = strdup(tag);
+	su->ident = tag;
 	su->is_being_defined = 0;
 	scope_insert(tag, NS_TAG, node);
 
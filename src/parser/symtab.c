@@ -2,108 +2,169 @@
 #include <stdlib.h>
 #include <string.h>
 #include <parser/symtab.h>
+#include <arena.h>
+#include <intern.h>
+#include <common.h>
+#include <context.h>
 
-// good hash primes: https://planetmath.org/goodhashtableprimes
-static int ghp[] = {53, 97, 193, 389, 769, 1533, 3079, 6151, 12289, 24593};
-void *symtab_init(struct symtab *st) {
-	st->size = 0;
-	st->capacity = ghp[0];
-	st->bs = (struct symbol **) calloc(st->capacity,
-		sizeof(struct symbol *));
-}
+#define SYMTAB_INIT_CAP	8
 
-void symtab_destroy(struct symtab *st) {
-	int i;
 
-	// free each astnode recursively
-	for (i = 0; i < st->capacity; i++) {
-		if (st->bs[i]) {
-			// TODO: how to clean up node at st->bs[i] ??????????
-			// free(st->bs[i].value);
-		}
-	}
+void symtab_init(struct symtab *st) {
+	*st = (struct symtab) {
+		.arena = cur_arena,
+	};
+}
 
-	// free symtab
-	free(st->bs);
+void symtab_destroy(struct symtab *st) {
+	// the table, symbols, and nodes are arena-allocated and are released
+	// together with their arena (see arena.h)
+	st->bs = NULL;
+	st->size = st->capacity = 0;
 }
 
-// djb2: http://www.cse.yorku.ca/~oz/hash.html
-static unsigned long symtab_hash(char *s) {
-	unsigned long hash = 5381;
-	int c;
+// find the slot of ident, or the empty slot where it would be inserted
+static unsigned symtab_probe(struct symtab *st, char *ident, unsigned hash) {
+	struct symtab_stats *stats = &cur_ctx->symtab_stats;
+	unsigned i, mask = st->capacity - 1, probes = 1;
 
-	/* hash * 33 + c */
-	while (c = *s++)
-		hash = ((hash << 5) + hash) + c;
+	for (i = hash & mask; st->bs[i].ident && st->bs[i].ident != ident;
+		i = (i+1) & mask) {
+		++probes;
+	}
 
-	return hash;
+	++stats->lookups;
+	stats->probes += probes;
+	stats->max_probe = MAX(stats->max_probe, probes);
+	return i;
 }
 
 static void symtab_rehash(struct symtab *st) {
-	int i;
-	struct symbol **tmp, *iter, *end;
-
-	// find next "good hash prime"
-	for (i = 0; i < 10 && ghp[i] != st->capacity; i++);
-	if (i == 9) {
-		yyerror_fatal("maximum symbol hashtable capacity exceeded");
+	unsigned i, j, mask, old_capacity = st->capacity;
+	struct symbol *tmp = st->bs;
+
+	// first insert: allocate a small table
+	if (!old_capacity) {
+		st->capacity = SYMTAB_INIT_CAP;
+		st->bs = (struct symbol *) arena_alloc(st->arena,
+			st->capacity * sizeof(struct symbol));
+		++cur_ctx->symtab_stats.tables;
+		return;
 	}
 
-	st->capacity = ghp[i+1];
-	tmp = st->bs;
-	st->bs = (struct symbol **) calloc(st->capacity,
-		sizeof(struct symbol *));
+	// the table can grow without bound
+	st->capacity *= 2;
+	st->bs = (struct symbol *) arena_alloc(st->arena,
+		st->capacity * sizeof(struct symbol));
+	mask = st->capacity - 1;
+
+	// move all of the old symbols into the new table using their stored
+	// hashes (the old table is left behind in the arena)
+	for (i = 0; i < old_capacity; ++i) {
+		if (!tmp[i].ident) {
+			continue;
+		}
 
-	// rehash and reinsert all of the old elements
-	for (iter = *tmp, end = *tmp+ghp[i]; iter < end; ++iter) {
-		symtab_insert(st, iter->ident, iter->value);
-		free(iter);
+		for (j = tmp[i].hash & mask; st->bs[j].ident; j = (j+1) & mask);
+		st->bs[j] = tmp[i];
 	}
 
-	free(tmp);
+	++cur_ctx->symtab_stats.rehashes;
 }
 
 void symtab_insert(struct symtab *st, char *ident, union astnode *node) {
-	int i;
-	struct symbol *symbol;
+	struct symtab_stats *stats = &cur_ctx->symtab_stats;
+	unsigned i, hash = INTERN_HASH(ident);
 
 	// resize hashtable if necessary
 	if (st->size >= st->capacity / 2) {
 		symtab_rehash(st);
 	}
 
-	// hash and linear probe; if name already exists then error
-	for (i = symtab_hash(ident) % st->capacity;
-		st->bs[i] && strcmp(ident, st->bs[i]->ident);
-		i = (i+1) % st->capacity);
-
 	// identifier already exists in this symbol table
-	if (st->bs[i] && !strcmp(ident, st->bs[i]->ident)) {
+	i = symtab_probe(st, ident, hash);
+	if (st->bs[i].ident) {
 		yyerror_fatal("symbol already exists in symbol table");
 	}
 
-	// allocate symbol
-	symbol = malloc(sizeof(struct symbol));
-	symbol->value = node;
-	symbol->ident = ident;
-
-	st->bs[i] = symbol;
+	st->bs[i] = (struct symbol) {
+		.ident = ident,
+		.value = node,
+		.hash = hash,
+		.seq = st->seq++,
+	};
 	++st->size;
+
+	++stats->inserts;
+	stats->max_size = MAX(stats->max_size, st->size);
+	stats->max_load = MAX(stats->max_load,
+		(double) st->size / st->capacity);
 }
 
 union astnode *symtab_lookup(struct symtab *st, char *ident) {
-	int i;
+	unsigned i;
+
+	// empty (or never allocated) table
+	if (!st->size) {
+		return NULL;
+	}
 
-	if (!st->capacity) {
+	i = symtab_probe(st, ident, INTERN_HASH(ident));
+	return st->bs[i].ident ? st->bs[i].value : NULL;
+}
+
+union astnode *symtab_lookup_before(struct symtab *st, char *ident,
+	unsigned seq) {
+	unsigned i;
+
+	if (!st->size) {
 		return NULL;
 	}
 
-	for (i = symtab_hash(ident) % st->capacity;
-		st->bs[i] && strcmp(ident, st->bs[i]->ident);
-		i = (i+1) % st->capacity);
+	i = symtab_probe(st, ident, INTERN_HASH(ident));
+	return st->bs[i].ident && st->bs[i].seq < seq ? st->bs[i].value : NULL;
+}
+
+union astnode *symtab_delete(struct symtab *st, char *ident) {
+	unsigned i, j, home, mask = st->capacity - 1;
+	union astnode *value;
 
-	if (st->bs[i] && !(strcmp(ident, st->bs[i]->ident))) {
-		return st->bs[i]->value;
+	if (!st->size) {
+		return NULL;
 	}
-	return NULL;
-}
\ No newline at end of file
+
+	i = symtab_probe(st, ident, INTERN_HASH(ident));
+	if (!st->bs[i].ident) {
+		return NULL;
+	}
+	value = st->bs[i].value;
+
+	// backward-shift deletion: move later entries of the probe sequence
+	// into the hole unless that would put them before their home slot, so
+	// that no tombstones are needed
+	for (j = (i+1) & mask; st->bs[j].ident; j = (j+1) & mask) {
+		home = st->bs[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			st->bs[i] = st->bs[j];
+			i = j;
+		}
+	}
+	st->bs[i].ident = NULL;
+	--st->size;
+
+	++cur_ctx->symtab_stats.deletes;
+	return value;
+}
+
+void symtab_print_stats(FILE *fp) {
+	struct symtab_stats *stats = &cur_ctx->symtab_stats;
+
+	fprintf(fp, "symbol tables: %lu lookups (%.2f probes on average, %lu"
+		" at most), %lu tables, %lu inserts, %lu deletes, %lu rehashes;"
+		" largest table %u symbols, max load factor %.2f\n",
+		stats->lookups,
+		stats->lookups ? (double) stats->probes / stats->lookups : 0.,
+		stats->max_probe, stats->tables, stats->inserts,
+		stats->deletes, stats->rehashes,
+		stats->max_size, stats->max_load);
+}
@@ -0,0 +1,285 @@
+#include <parser/types.h>
+#include <context.h>
+
+#define TYPES_INIT_CAP	64
+
+// the file's types (in the current context) are shared by all threads, and
+// nothing is inserted into them while functions are being generated on other
+// threads (see types_init()); each thread has its own table for the function
+// it is generating
+#define file_types	(cur_ctx->file_types)
+static _Thread_local struct type_tab fn_types;
+
+// what identifies a canonical type: its kind, the (canonical) type it is
+// derived from, and its qualifiers/array length/scalar modifiers
+struct type_key {
+	enum astnode_type type;
+	union astnode *of;
+	uint64_t extra;
+};
+
+static unsigned type_key_hash(struct type_key *key)
+{
+	uint64_t hash = (uintptr_t) key->of ^ key->extra * 0x9e3779b97f4a7c15u
+		^ key->type;
+
+	// mix all of the bits into the low bits used for indexing
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdu;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static unsigned char type_qual(union astnode *tq)
+{
+	return tq ? tq->tq.qual : 0;
+}
+
+// key of a type whose components are already canonical
+static struct type_key type_key_of(union astnode *type)
+{
+	struct astnode_typespec_scalar *sc;
+
+	switch (NT(type)) {
+	case NT_TS_SCALAR:
+		sc = &type->ts_scalar;
+		return (struct type_key) { NT_TS_SCALAR, NULL, sc->basetype
+			| sc->modifiers.lls << 8 | sc->modifiers.sign << 16 };
+	case NT_DECLSPEC:
+		return (struct type_key) { NT_DECLSPEC, type->declspec.ts,
+			type_qual(type->declspec.tq) };
+	case NT_DECLARATOR_POINTER:
+		return (struct type_key) { NT_DECLARATOR_POINTER,
+			type->decl_pointer.of,
+			type_qual(type->decl_pointer.spec) };
+	case NT_DECLARATOR_ARRAY:
+		return (struct type_key) { NT_DECLARATOR_ARRAY,
+			type->decl_array.of,
+			*((uint64_t *) type->decl_array.length->num.buf) };
+	default:
+		yyerror_fatal("types: not a canonicalizable type");
+		return (struct type_key) { 0 };
+	}
+}
+
+static int type_key_eq(struct type_key *a, struct type_key *b)
+{
+	return a->type == b->type && a->of == b->of && a->extra == b->extra;
+}
+
+static void type_tab_rehash(struct type_tab *tab)
+{
+	union astnode **old = tab->bs;
+	unsigned old_capacity = tab->capacity, i, j;
+	struct type_key key;
+
+	tab->capacity = old_capacity ? old_capacity * 2 : TYPES_INIT_CAP;
+	tab->bs = arena_alloc(tab->arena,
+		tab->capacity * sizeof(union astnode *));
+
+	// the old table is left behind in the arena
+	for (i = 0; i < old_capacity; ++i) {
+		if (!old[i]) {
+			continue;
+		}
+
+		key = type_key_of(old[i]);
+		for (j = type_key_hash(&key) & (tab->capacity - 1); tab->bs[j];
+			j = (j + 1) & (tab->capacity - 1));
+		tab->bs[j] = old[i];
+	}
+}
+
+// returns the slot for key in tab (which is either the matching type or an
+// empty slot), or NULL if the table hasn't been allocated
+static union astnode **type_tab_probe(struct type_tab *tab,
+	struct type_key *key)
+{
+	unsigned i, mask = tab->capacity - 1;
+	struct type_key other;
+
+	if (!tab->capacity) {
+		return NULL;
+	}
+
+	for (i = type_key_hash(key) & mask; tab->bs[i]; i = (i + 1) & mask) {
+		other = type_key_of(tab->bs[i]);
+		if (type_key_eq(key, &other)) {
+			break;
+		}
+	}
+	return &tab->bs[i];
+}
+
+// look up the canonical type with the given key; if it doesn't exist yet,
+// returns NULL and sets *tab to the table that it should be inserted into
+static union astnode *type_lookup(struct type_key *key, struct type_tab **tab)
+{
+	union astnode **slot;
+
+	if ((slot = type_tab_probe(&file_types, key)) && *slot) {
+		return *slot;
+	}
+	if (cur_arena != &cur_ctx->file_arena
+		&& (slot = type_tab_probe(&fn_types, key)) && *slot) {
+		return *slot;
+	}
+
+	// scalars don't depend on other types, so they can always be shared
+	*tab = key->type == NT_TS_SCALAR || cur_arena == &cur_ctx->file_arena
+		? &file_types : &fn_types;
+	return NULL;
+}
+
+static union astnode *type_insert(struct type_tab *tab, union astnode *type)
+{
+	struct type_key key = type_key_of(type);
+
+	if (2 * (tab->size + 1) > tab->capacity) {
+		type_tab_rehash(tab);
+	}
+
+	++tab->size;
+	return *type_tab_probe(tab, &key) = type;
+}
+
+union astnode *type_scalar(enum scalar_basetype basetype, enum scalar_lls lls,
+	enum scalar_sign sign)
+{
+	struct type_key key;
+	struct type_tab *tab;
+	union astnode *type;
+
+	// (short/long/long long) int is signed unless specified otherwise;
+	// this is not the case for char
+	if (basetype == BT_INT && sign == SIGN_UNSPEC) {
+		sign = SIGN_SIGNED;
+	}
+
+	key = (struct type_key) { NT_TS_SCALAR, NULL,
+		basetype | lls << 8 | sign << 16 };
+	if ((type = type_lookup(&key, &tab))) {
+		return type;
+	}
+
+	type = arena_alloc(tab->arena, astnode_sizes[NT_TS_SCALAR]);
+	type->ts_scalar.type = NT_TS_SCALAR;
+	type->ts_scalar.basetype = basetype;
+	type->ts_scalar.modifiers.lls = lls;
+	type->ts_scalar.modifiers.sign = sign;
+	return type_insert(tab, type);
+}
+
+// canonical declspec/pointer with the given qualifiers
+static union astnode *type_qualified(enum astnode_type nt, union astnode *of,
+	unsigned char qual)
+{
+	struct type_key key = { nt, of, qual };
+	struct type_tab *tab;
+	union astnode *type, *tq = NULL;
+
+	if ((type = type_lookup(&key, &tab))) {
+		return type;
+	}
+
+	if (qual) {
+		tq = arena_alloc(tab->arena, astnode_sizes[NT_TQ]);
+		tq->tq.type = NT_TQ;
+		tq->tq.qual = qual;
+	}
+
+	type = arena_alloc(tab->arena, astnode_sizes[nt]);
+	type->generic.type = nt;
+	if (nt == NT_DECLSPEC) {
+		type->declspec.ts = of;
+		type->declspec.tq = tq;
+	} else {
+		type->decl_pointer.of = of;
+		type->decl_pointer.spec = tq;
+	}
+	return type_insert(tab, type);
+}
+
+union astnode *type_pointer_to(union astnode *of)
+{
+	return type_qualified(NT_DECLARATOR_POINTER, type_canon(of), 0);
+}
+
+union astnode *type_array_of(union astnode *of, uint64_t length)
+{
+	struct type_key key = { NT_DECLARATOR_ARRAY, type_canon(of), length };
+	struct type_tab *tab;
+	union astnode *type, *num;
+
+	if ((type = type_lookup(&key, &tab))) {
+		return type;
+	}
+
+	num = arena_alloc(tab->arena, astnode_sizes[NT_NUMBER]);
+	num->num.type = NT_NUMBER;
+	*((uint64_t *) num->num.buf) = length;
+
+	type = arena_alloc(tab->arena, astnode_sizes[NT_DECLARATOR_ARRAY]);
+	type->decl_array.type = NT_DECLARATOR_ARRAY;
+	type->decl_array.of = key.of;
+	type->decl_array.length = num;
+	return type_insert(tab, type);
+}
+
+union astnode *type_canon(union astnode *type)
+{
+	struct astnode_typespec_scalar *sc;
+
+	switch (NT(type)) {
+	case NT_TS_SCALAR:
+		sc = &type->ts_scalar;
+		return type_scalar(sc->basetype, sc->modifiers.lls,
+			sc->modifiers.sign);
+
+	case NT_DECLSPEC:
+		// an unqualified declspec is just its typespec
+		if (!type->declspec.ts) {
+			return type;
+		} else if (!type_qual(type->declspec.tq)) {
+			return type_canon(type->declspec.ts);
+		}
+		return type_qualified(NT_DECLSPEC,
+			type_canon(type->declspec.ts),
+			type_qual(type->declspec.tq));
+
+	case NT_DECLARATOR_POINTER:
+		return type_qualified(NT_DECLARATOR_POINTER,
+			type_canon(type->decl_pointer.of),
+			type_qual(type->decl_pointer.spec));
+
+	case NT_DECLARATOR_ARRAY:
+		return type_array_of(type->decl_array.of,
+			*((uint64_t *) type->decl_array.length->num.buf));
+
+	// struct/union typespecs and functions are unique already
+	default:
+		return type;
+	}
+}
+
+void types_fn_reset(void)
+{
+	// the table itself was released with the previous function's arena
+	fn_types = (struct type_tab) { .arena = cur_arena };
+}
+
+void types_init(void)
+{
+	enum scalar_basetype basetype;
+	enum scalar_lls lls;
+	enum scalar_sign sign;
+
+	for (basetype = BT_UNSPEC; basetype <= BT_BOOL; ++basetype) {
+		for (lls = LLS_UNSPEC; lls <= LLS_SHORT; ++lls) {
+			for (sign = SIGN_UNSPEC; sign <= SIGN_UNSIGNED;
+				++sign) {
+				type_scalar(basetype, lls, sign);
+			}
+		}
+	}
+}
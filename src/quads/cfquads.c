@@ -5,7 +5,7 @@
 
 // used to hold state information about the current loops; information for
 // parent loops is stored on the stack frame
-static struct loop *cur_loop;
+static _Thread_local struct loop *cur_loop;
 
 void generate_for_quads(union astnode *stmt)
 {
@@ -182,8 +182,7 @@ void generate_conditional_quads(union astnode *expr,
 	// note: the TEST opcode is more efficient than the CMP opcode, but we
 	// use CMP for sake of simplicity
 	if (cc == CC_UNSPEC) {
-		zero = addr_new(AT_CONST, create_size_t());
-		*((uint64_t*)zero->val.constval) = 0;
+		zero = const_addr(create_size_t(), 0);
 
 		quad_new(OC_CMP, NULL, cond, zero);
 		cc = CC_NE;
@@ -237,34 +236,6 @@ void gen_ret_quads(union astnode *stmt){
 	quad_new(OC_RET, NULL, addr_ret, NULL);
 }
 
-/**
- * reverse quads in cur_bb when it is complete (i.e., in link_bb)
- *
- * uses same O(N) algorithm as in decl_reverse (decl.c); see that function
- * for more details
- */
-static void reverse_quads(void)
-{
-	struct quad *a, *b, *c;
-
-	if (!(a = cur_bb->ll) || !(b = _LL_NEXT(a, next))) {
-		return;
-	}
-
-	c = _LL_NEXT(b, next);
-	_LL_NEXT(a, next) = NULL;
-
-	while (c) {
-		_LL_NEXT(b, next) = a;
-		a = b;
-		b = c;
-		c = _LL_NEXT(c, next);
-	}
-
-	_LL_NEXT(b, next) = a;
-	cur_bb->ll = b;
-}
-
 void link_bb(enum cc cc, struct basic_block *bb_def,
 	struct basic_block *bb_cond)
 {
@@ -279,10 +250,6 @@ void link_bb(enum cc cc, struct basic_block *bb_def,
 	cur_bb->next_def = bb_def;
 	cur_bb->next_cond = bb_cond;
 
-	// reverse all quads in cur_bb; see function comment for an
-	// explanation
-	reverse_quads();
-
 	// set basic block finished -- anything after this will throw
 	// an error;
 	cur_bb->finalized = 1;
@@ -1,100 +1,214 @@
 #include <quads/exprquads.h>
 #include <quads/sizeof.h>
+#include <parser/types.h>
 #include <quads/cfquads.h>
 #include <parser.tab.h>
+#include <context.h>
 #include <stdio.h>
+#include <string.h>
+
+// string_ll, its last string literal, and the number of distinct string
+// literals are part of the current context (see context.h)
+#define string_ll		(cur_ctx->string_ll)
+#define string_ll_tail		(cur_ctx->string_ll_tail)
+#define string_count		(cur_ctx->string_count)
+
+// string literal pool: hashtable (open addressing, linear probing) of the
+// literals in string_ll, so that identical literals (same width and contents)
+// share a label and are only emitted once; capacity is a power of two, and
+// the table is kept at most half full
+#define STRING_POOL_INIT_CAP	256
+#define string_pool		(cur_ctx->string_pool)
+#define string_pool_cap		(cur_ctx->string_pool_cap)
+
+// FNV-1a over the width and contents of a string literal
+static unsigned string_hash(struct string *str)
+{
+	unsigned hash = 2166136261u ^ str->width, i;
 
-union astnode *string_ll;
+	for (i = 0; i < str->length; ++i) {
+		hash = (hash ^ ((unsigned char *) str->buf)[i]) * 16777619u;
+	}
+	return hash;
+}
 
-/**
- * helper function to demote astnode array to pointer
- *
- * @param decl 		astnode representation of pointer type
- * @return 		pointer type if input type is array, else original type
- */
-static union astnode *astnode_demote_array(union astnode *decl)
+static union astnode **string_pool_probe(struct string *str, unsigned hash)
 {
-	union astnode *ptr;
+	unsigned i, mask = string_pool_cap - 1;
+	struct string *other;
 
-	// if not array type, ignore
-	if (NT(decl) != NT_DECLARATOR_ARRAY) {
-		return decl;
+	for (i = hash & mask; string_pool[i]; i = (i + 1) & mask) {
+		other = &string_pool[i]->string.string;
+		if (other->width == str->width && other->length == str->length
+			&& !memcmp(other->buf, str->buf, str->length)) {
+			break;
+		}
 	}
+	return &string_pool[i];
+}
 
-	ALLOC_TYPE(ptr, NT_DECLARATOR_POINTER);
-	ptr->decl_pointer.of = decl->decl_array.of;
+union astnode *string_pool_get(struct string *str)
+{
+	union astnode **old = string_pool, **slot, *persist;
+	unsigned old_cap = string_pool_cap, i;
+	char name[16];
+
+	if (2 * (string_count + 1) > string_pool_cap) {
+		string_pool_cap = old_cap ? old_cap * 2 : STRING_POOL_INIT_CAP;
+		string_pool = arena_alloc(&cur_ctx->file_arena,
+			string_pool_cap * sizeof(union astnode *));
+		for (i = 0; i < old_cap; ++i) {
+			if (old[i]) {
+				*string_pool_probe(&old[i]->string.string,
+					string_hash(&old[i]->string.string))
+					= old[i];
+			}
+		}
+	}
+
+	if (*(slot = string_pool_probe(str, string_hash(str)))) {
+		return *slot;
+	}
 
-	return ptr;
+	// the string buffer itself is heap-allocated, and is not freed
+	persist = arena_alloc(&cur_ctx->file_arena, astnode_sizes[NT_STRING]);
+	persist->string.type = NT_STRING;
+	persist->string.string = *str;
 
-	// memory management is horrible -- this will cause really annoying
-	// dangling pointers if you actually try to free memory
+	sprintf(name, ".RO%u", string_count++);
+	persist->string.label = intern(name);
+
+	// add it to the end of the ll
+	if (string_ll_tail) {
+		string_ll_tail->string.symbol_next = persist;
+	} else {
+		string_ll = persist;
+	}
+	string_ll_tail = persist;
+
+	return *slot = persist;
 }
 
 /**
  * helper function to demote array to pointer type if not direct arg to sizeof;
  * if not an array type, no-op
  *
+ * only temporaries and abstract typenames can have an array type here (array
+ * variables are turned into a LEA to a temporary), so this never modifies a
+ * shared (interned) addr
+ *
  * @param addr		struct addr to demote (if array type)
  */
 static void demote_array(struct addr *addr)
 {
-	union astnode *ptr;
-
-	if ((ptr = astnode_demote_array(addr->decl)) != addr->decl) {
-		addr->decl = ptr;
-		addr->size = astnode_sizeof_type(ptr);
+	if (NT(addr->decl) == NT_DECLARATOR_ARRAY) {
+		addr->decl = type_pointer_to(addr->decl->decl_array.of);
+		addr->size = astnode_sizeof_type(addr->decl);
 	}
 }
 
+union astnode *create_size_t(void)
+{
+	return type_scalar(BT_INT, LLS_LONG_LONG, SIGN_UNSIGNED);
+}
+
+union astnode *create_int(void)
+{
+	return type_scalar(BT_INT, LLS_UNSPEC, SIGN_SIGNED);
+}
+
 /**
- * helper function to wrap a declaration in a pointer-to-(that type) typespec
+ * Sethi-Ullman labeling of an expression tree: returns the number of
+ * registers needed to evaluate expr without spilling, and clears *pure if expr
+ * has side effects or contains a sequence point (in which case its evaluation
+ * order relative to a sibling subtree is observable)
  *
- * for use with the addressof operator
+ * constants need no register because they can be used as immediates; labels
+ * of binop nodes are cached in the node so that each subtree is only labeled
+ * once no matter how deep the expression is
  *
- * @param decl		astnode representation of type to wrap
- * @return		pointer to input type
+ * @param expr		expression to label
+ * @param pure		set to 0 if expr is not side-effect-free
+ * @return		number of registers required to evaluate expr
  */
-static union astnode *create_pointer_to(union astnode *decl)
+static int su_label(union astnode *expr, int *pure)
 {
-	union astnode *ptr;
+	int l, r, lpure = 1;
 
-	ALLOC_TYPE(ptr, NT_DECLARATOR_POINTER);
-	ptr->decl_pointer.of = decl;
-	return ptr;
-}
+	switch (NT(expr)) {
+	case NT_NUMBER:
+	case NT_CHARLIT:
+		return 0;
 
-union astnode *create_size_t(void)
-{
-	union astnode *ts;
+	case NT_DECL:
+	case NT_STRING:
+		return 1;
 
-	ALLOC_TYPE(ts, NT_TS_SCALAR);
-	ts->ts_scalar.basetype = BT_INT;
-	ts->ts_scalar.modifiers.lls = LLS_LONG_LONG;
-	ts->ts_scalar.modifiers.sign = SIGN_UNSIGNED;
+	case NT_UNOP:
+		switch (expr->unop.op) {
+		case SIZEOF:
+		case 's':
+			return 0;
+		case PLUSPLUS:
+		case MINUSMINUS:
+			*pure = 0;
+			break;
+		}
+		return MAX(su_label(expr->unop.arg, pure), 1);
 
-	return ts;
+	case NT_BINOP:
+		if (!expr->binop.regs) {
+			l = su_label(expr->binop.left, &lpure);
+			r = su_label(expr->binop.right, &lpure);
+			expr->binop.regs = l == r ? l + 1 : MAX(l, r);
+
+			switch (expr->binop.op) {
+			case '=':
+			case LOGAND:
+			case LOGOR:
+			case ',':
+				lpure = 0;
+			}
+			expr->binop.impure = !lpure;
+		}
+		if (expr->binop.impure) {
+			*pure = 0;
+		}
+		return expr->binop.regs;
+
+	// function calls (side effects) and ternary operators (sequence point
+	// after the first operand) are never reordered
+	default:
+		*pure = 0;
+		return 1;
+	}
 }
 
-union astnode *create_int(void)
+/**
+ * determines whether the right operand of a binop should be evaluated before
+ * its left operand: true if the right subtree needs more registers and the
+ * order of evaluation is not observable
+ *
+ * @param expr		binop expression
+ * @return		whether to evaluate the right operand first
+ */
+static int su_right_first(union astnode *expr)
 {
-	union astnode *ts;
-
-	ALLOC_TYPE(ts, NT_TS_SCALAR);
-	ts->ts_scalar.basetype = BT_INT;
-	ts->ts_scalar.modifiers.lls = LLS_UNSPEC;
-	ts->ts_scalar.modifiers.sign = SIGN_SIGNED;
+	int l, r, pure = 1;
 
-	return ts;
+	l = su_label(expr->binop.left, &pure);
+	r = su_label(expr->binop.right, &pure);
+	return pure && r > l;
 }
 
 struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 {
-	struct addr *src1, *src2, *tmp, *tmp2, *tmp3;
-	struct quad *quad;
+	struct addr *src1, *src2, *tmp, *tmp2, *tmp3, **args;
 	struct basic_block *tmp_bb;
+	unsigned argc, i;
 	enum opcode op;
 	enum cc tmp_cc;
-	union astnode *ts, *ts_tmp, *iter;
+	union astnode *ts;
 
 	// null expression
 	// this shouldn't happen but this is here as a safety measure
@@ -128,47 +242,19 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 
 	// constant string literal
 	case NT_STRING:
-		// set up character pointer declaration
-		ALLOC_TYPE(ts, NT_TS_SCALAR);
-		ts->ts_scalar.basetype = BT_CHAR;
-		ts->ts_scalar.modifiers.sign = SIGN_SIGNED;
-
-		ALLOC_TYPE(ts_tmp, NT_DECLSPEC);
-		ts_tmp->declspec.ts = ts;
-
-		ALLOC_TYPE(ts, NT_DECLARATOR_ARRAY);
-		ts->decl_array.of = ts_tmp;
-
-		// this is kludgey: make the pointer act like an array,
-		// but give it length 8 so it has size 8
-		ALLOC_TYPE(ts_tmp, NT_NUMBER);
-		*((uint64_t*)ts_tmp->num.buf) = 8;
-		ts->decl_array.length = ts_tmp;
-
+		// set up character pointer declaration; this is kludgey:
+		// make the pointer act like an array, but give it length 8
+		// so it has size 8
 		union astnode *decl;
 		ALLOC_TYPE(decl, NT_DECL);
-		decl->decl.components = ts;
+		decl->decl.components = type_array_of(
+			type_scalar(BT_CHAR, LLS_UNSPEC, SIGN_SIGNED), 8);
 		decl->decl.is_string = 1;
 
-		// add it to the end of the ll (messy to build forwards)
-		int count = 0;
-		union astnode *iter;
-		_LL_FOR(string_ll, iter, decl.symbol_next) {
-			++count;
-			if (!iter->decl.symbol_next) {
-				iter->decl.symbol_next = expr;
-				break;
-			}
-		}
-		if (!count) {
-			string_ll = expr;
-		}
-
-		char name[10];
-		sprintf(name, ".RO%d", count);
-
-		decl->decl.ident = strdup(name);
-		expr->string.label = decl->decl.ident;
+		// strings are emitted at the end of the file, after this
+		// function's arena has been reset; identical literals share
+		// a label (see string_pool_get())
+		decl->decl.ident = expr->string.label;
 
 		// string is an lvalue! like an array
 		return gen_lvalue(decl, NULL, dest, 0);
@@ -176,13 +262,9 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 	// constant character
 	case NT_CHARLIT:
 		// assume 1-byte character (i.e., not wide)
-		ALLOC_TYPE(ts, NT_TS_SCALAR);
-		ts->ts_scalar.basetype = BT_CHAR;
-		ts->ts_scalar.modifiers.sign = SIGN_SIGNED;
-
-		src1 = addr_new(AT_CONST, ts);
-		*((uint64_t*)src1->val.constval) =
-			(uint64_t)expr->charlit.charlit.value.none;
+		src1 = const_addr(type_scalar(BT_CHAR, LLS_UNSPEC,
+				SIGN_SIGNED),
+			(uint64_t)expr->charlit.charlit.value.none);
 
 		goto constliteral;
 
@@ -196,9 +278,7 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 		}
 
 		// convert into const
-		src1 = addr_new(AT_CONST, expr->num.ts);
-		*((uint64_t *)src1->val.constval) =
-			*((uint64_t *)expr->num.buf);
+		src1 = const_addr(expr->num.ts, *((uint64_t *)expr->num.buf));
 
 		goto constliteral;
 
@@ -221,39 +301,45 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 		}
 
 		// generate a struct addr for each argument in fncall arglist
-		src2 = tmp = addr_new(AT_CONST, create_size_t());
-		LL_FOR(expr->fncall.arglist, iter) {
-			tmp->next = gen_rvalue(iter, NULL, NULL);
-			tmp = tmp->next;
+		argc = expr->fncall.arglist.argc;
+		args = arena_alloc(cur_arena, argc * sizeof(struct addr *));
+		for (i = 0; i < argc; ++i) {
+			args[i] = gen_rvalue(expr->fncall.arglist.args[i], NULL,
+				NULL);
 		}
 
-		if (!dest) {
-			// take function return type, or int for implicit fn
-			dest = tmp_addr_new(create_int());
-			dest->decl->ts_scalar.modifiers.lls = LLS_LONG;
-			dest->size = astnode_sizeof_type(dest->decl);
-
-			// if implicit make return type 4
-			if (!src1->decl->decl_function.of) {
-				dest = tmp_addr_new(create_int());
+		// take function return type, or int for implicit fn
+		// (if implicit make return type 4)
+		if (!src1->decl->decl_function.of) {
+			tmp = tmp_addr_new(create_int());
+		} else {
+			ts = src1->decl->decl_function.of;
+
+			// if void we don't need a dest, but we make it
+			// implicitly an int so we don't upset things
+			// if this is used as an intermediate value
+			if (NT(ts) == NT_DECLSPEC
+				&& NT(ts->declspec.ts) == NT_TS_SCALAR
+				&& ts->declspec.ts->ts_scalar.basetype
+					== BT_VOID) {
+				tmp = tmp_addr_new(create_int());
 			} else {
-				ts = src1->decl->decl_function.of;
-
-				// if void we don't need a dest, but we make it
-				// implicitly an int so we don't upset things
-				// if this is used as an intermediate value
-				if (NT(ts) == NT_DECLSPEC
-					&& NT(ts->declspec.ts) == NT_TS_SCALAR
-					&& ts->declspec.ts->ts_scalar.basetype
-						== BT_VOID) {
-					dest = tmp_addr_new(create_int());
-				} else {
-					dest = tmp_addr_new(ts);
-				}
+				tmp = tmp_addr_new(ts);
 			}
 		}
 
-		quad_new(OC_CALL, dest, src1, src2->next);
+		if (!dest) {
+			dest = tmp;
+		}
+
+		// return value is only as wide as the return type; convert it
+		// if being assigned to a destination of a different size
+		if (dest->size != tmp->size) {
+			quad_call_new(tmp, src1, args, argc);
+			quad_new(OC_CAST, dest, tmp, NULL);
+		} else {
+			quad_call_new(dest, src1, args, argc);
+		}
 		return dest;
 
 	// unary operator
@@ -279,11 +365,10 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 
 			// src2 is the resultant struct addr (static number
 			// after compilation)
-			src2 = addr_new(AT_CONST, create_size_t());
-			*((uint64_t *) src2->val.constval)
-				= src1->type == AT_CONST
-				  ? src1->size
-				  : astnode_sizeof_type(src1->decl);
+			src2 = const_addr(create_size_t(),
+				src1->type == AT_CONST
+				? src1->size
+				: astnode_sizeof_type(src1->decl));
 
 			if (dest) {
 				quad_new(OC_MOV, dest, src2, NULL);
@@ -294,10 +379,9 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 
 		// sizeof with a typename
 		case 's':
-			src1 = addr_new(AT_CONST, create_size_t());
-			*((uint64_t *) src1->val.constval)
-				= astnode_sizeof_type(expr->unop.arg
-					->decl.components);
+			src1 = const_addr(create_size_t(),
+				astnode_sizeof_type(expr->unop.arg
+					->decl.components));
 
 			if (dest) {
 				quad_new(OC_MOV, dest, src1, NULL);
@@ -393,8 +477,7 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 				tmp = gen_rvalue(expr->binop.right, NULL,
 					&tmp_cc);
 				if (tmp_cc == CC_UNSPEC) {
-					tmp2 = addr_new(AT_CONST, create_int());
-					*((uint64_t*)tmp2->val.constval) = 0;
+					tmp2 = const_addr(create_int(), 0);
 
 					quad_new(OC_CMP, NULL, tmp, tmp2);
 					tmp_cc = CC_NE;
@@ -424,14 +507,11 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 					break;
 				}
 
-				tmp = addr_new(AT_CONST, create_int());
-				*((uint64_t*)tmp->val.constval) = 0;
-				tmp2 = addr_new(AT_CONST, create_int());
-				*((uint64_t*)tmp2->val.constval) = cmp_val;
+				tmp = const_addr(create_int(), 0);
+				tmp2 = const_addr(create_int(), cmp_val);
 				quad_new(OC_CMP, NULL, tmp, tmp2);
 			} else {
-				tmp = addr_new(AT_CONST, create_int());
-				*((uint64_t*)tmp->val.constval) = 0;
+				tmp = const_addr(create_int(), 0);
 				quad_new(OC_MOV, dest, tmp, NULL);
 			}
 			link_bb(CC_ALWAYS, bb_next, NULL);
@@ -451,8 +531,15 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 			break;
 		}
 
-		src1 = gen_rvalue(expr->binop.left, NULL, NULL);
-		src2 = gen_rvalue(expr->binop.right, NULL, NULL);
+		// evaluate the operand that needs more registers first, so
+		// that fewer temporaries are live at once (Sethi-Ullman order)
+		if (su_right_first(expr)) {
+			src2 = gen_rvalue(expr->binop.right, NULL, NULL);
+			src1 = gen_rvalue(expr->binop.left, NULL, NULL);
+		} else {
+			src1 = gen_rvalue(expr->binop.left, NULL, NULL);
+			src2 = gen_rvalue(expr->binop.right, NULL, NULL);
+		}
 
 		// after here, no chance of an array that doesn't get demoted
 		// to a pointer (that only happens for sizeof)
@@ -486,10 +573,9 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 			if (AOP(src1)) {
 				// p+i => p + sizeof(*p)*i
 				// replace src2
-				tmp = addr_new(AT_CONST, create_size_t());
-				*((uint64_t *)tmp->val.constval) =
+				tmp = const_addr(create_size_t(),
 					astnode_sizeof_type(src1->decl->
-						decl_pointer.of);
+						decl_pointer.of));
 
 				// implicitly upcast src2
 				if (src2->size != 8) {
@@ -518,10 +604,9 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 			else if (AOP(src1) && !AOP(src2)) {
 				// p-i = p - sizeof(*p) * i
 				// need to modify src2
-				tmp = addr_new(AT_CONST, create_size_t());
-				*((uint64_t *)tmp->val.constval) =
+				tmp = const_addr(create_size_t(),
 					astnode_sizeof_type(src1->decl->
-						decl_pointer.of);
+						decl_pointer.of));
 
 				// implicitly upcast src2
 				if (src2->size != 8) {
@@ -543,15 +628,11 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 			if (AOP(src1) && AOP(src2)) {
 				// p1-p2 = p1-p2 / sizeof(*p1)
 				// inject a division operation afterward
-				tmp = tmp_addr_new(create_size_t());
-				*((uint64_t *)tmp->val.constval) =
+				tmp = const_addr(create_size_t(),
 					astnode_sizeof_type(src1->decl->
-						decl_pointer.of);
-
-				tmp2 = tmp_addr_new(create_size_t());
-				quad->dest = tmp2;
+						decl_pointer.of));
 
-				quad_new(OC_DIV, dest, tmp2, tmp);
+				quad_new(OC_DIV, dest, dest, tmp);
 			}
 
 			return dest;
@@ -593,6 +674,19 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 		case '/':	op = OC_DIV; goto basicop;
 		case '%':	op = OC_MOD; goto basicop;
 		basicop:
+			// integer promotions: char and short operands are
+			// converted to int before the operation
+			if (src1->size < 4) {
+				tmp = tmp_addr_new(create_int());
+				quad_new(OC_CAST, tmp, src1, NULL);
+				src1 = tmp;
+			}
+			if (src2->size < 4) {
+				tmp = tmp_addr_new(create_int());
+				quad_new(OC_CAST, tmp, src2, NULL);
+				src2 = tmp;
+			}
+
 			if (!dest) {
 				dest = tmp_addr_new(src1->decl);
 			}
@@ -600,11 +694,11 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 			// implicit cast to larger type
 			if (src1->size < src2->size) {
 				tmp = tmp_addr_new(src2->decl);
-				quad_new(OC_CAST, src1, tmp, NULL);
+				quad_new(OC_CAST, tmp, src1, NULL);
 				src1 = tmp;
 			} else if (src1->size > src2->size) {
 				tmp = tmp_addr_new(src1->decl);
-				quad_new(OC_CAST, src2, tmp, NULL);
+				quad_new(OC_CAST, tmp, src2, NULL);
 				src2 = tmp;
 			}
 
@@ -642,8 +736,7 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 			quad_new(OC_CMP, dest, src1, src2);
 
 			if (!cc) {
-				tmp = addr_new(AT_CONST, create_int());
-				*((uint64_t*)tmp->val.constval) = tmp_cc;
+				tmp = const_addr(create_int(), tmp_cc);
 
 				quad_new(OC_SETCC, dest, tmp, NULL);
 			} else {
@@ -670,7 +763,7 @@ struct addr *gen_rvalue(union astnode *expr, struct addr *dest, enum cc *cc)
 struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 	struct addr *dest, int addrof)
 {
-	struct addr *tmp;
+	struct addr *tmp, *val;
 	union astnode *ts;
 
 	switch (NT(expr)) {
@@ -687,9 +780,7 @@ struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 
 		// TODO: check that this is only used in fncalls
 		case NT_DECLARATOR_FUNCTION:
-			dest = addr_new(AT_AST, expr->decl.components);
-			dest->val.astnode = expr;
-			return dest;
+			return var_addr(expr);
 
 		case NT_DECLSPEC:
 			if (NT(expr->decl.components->declspec.ts) !=
@@ -709,8 +800,7 @@ struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 				*mode = AM_DIRECT;
 			}
 
-			tmp = addr_new(AT_AST, expr->decl.components);
-			tmp->val.astnode = expr;
+			tmp = var_addr(expr);
 
 			// regular
 			if (!addrof) {
@@ -723,7 +813,7 @@ struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 			// addressof
 			else {
 				if (!dest) {
-					dest = tmp_addr_new(create_pointer_to(
+					dest = tmp_addr_new(type_pointer_to(
 						tmp->decl));
 				}
 				quad_new(OC_LEA, dest, tmp, NULL);
@@ -737,8 +827,7 @@ struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 				*mode = AM_DIRECT;
 			}
 
-			tmp = addr_new(AT_AST, expr->decl.components);
-			tmp->val.astnode = expr;
+			tmp = var_addr(expr);
 
 			// regular
 			if (!addrof) {
@@ -750,7 +839,7 @@ struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 			// addressof
 			else {
 				if (!dest) {
-					dest = tmp_addr_new(create_pointer_to(
+					dest = tmp_addr_new(type_pointer_to(
 						tmp->decl));
 				}
 				// noop/reinterpret cast
@@ -807,9 +896,17 @@ struct addr *gen_lvalue(union astnode *expr, enum addr_mode *mode,
 					dest = tmp_addr_new(ts);
 				}
 
-				// not pointing to an array
+				// not pointing to an array; if the destination is
+				// of a different size, load into a temporary and
+				// convert it
 				if (NT(ts) != NT_DECLARATOR_ARRAY) {
-					quad_new(OC_LOAD, dest, tmp, NULL);
+					if (dest->size != astnode_sizeof_type(ts)) {
+						val = tmp_addr_new(ts);
+						quad_new(OC_LOAD, val, tmp, NULL);
+						quad_new(OC_CAST, dest, val, NULL);
+					} else {
+						quad_new(OC_LOAD, dest, tmp, NULL);
+					}
 				}
 				// pointing to an array (no-op/reinterpret cast)
 				else {
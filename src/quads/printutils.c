@@ -15,6 +15,7 @@ char *opcode2str(enum opcode oc)
 	case OC_SUB:	return "SUB";
 	case OC_MUL:	return "MUL";
 	case OC_DIV:	return "DIV";
+	case OC_MOD:	return "MOD";
 	case OC_MOV:	return "MOV";
 	case OC_CMP:	return "CMP";
 	case OC_CALL:	return "CALL";
@@ -118,7 +119,7 @@ void print_addr(struct addr *addr)
 
 void print_quad(struct quad *quad)
 {
-	struct addr *iter;
+	unsigned i;
 
 	if (!quad) {
 		yyerror_fatal("quadgen: quad should not be NULL"
@@ -130,7 +131,7 @@ void print_quad(struct quad *quad)
 
 	// print dest addr (if applicable)
 	if (quad->dest) {
-		print_addr(quad->dest);
+		print_addr(QDEST(quad));
 		fprintf(dfp, "=");
 	}
 
@@ -140,25 +141,24 @@ void print_quad(struct quad *quad)
 	// print source addr (if applicable)
 	// (0- and 1-operand opcodes exist)
 	if (quad->src1) {
-		print_addr(quad->src1);
-		
-		if (quad->src2) {
-			fprintf(dfp, ", ");
+		print_addr(QSRC1(quad));
 
-			// regular opcodes
-			if (quad->opcode != OC_CALL) {
-				print_addr(quad->src2);
-			}
-			// fncall opcode: ll of fncall arglist
-			else {
-				fprintf(dfp, "(arglist");
-				_LL_FOR(quad->src2, iter, next) {
+		// fncall opcode: fncall arglist
+		if (quad->opcode == OC_CALL) {
+			if (CALL_ARGC(quad)) {
+				fprintf(dfp, ", (arglist");
+				for (i = 0; i < CALL_ARGC(quad); ++i) {
 					fprintf(dfp, " ");
-					print_addr(iter);
+					print_addr(CALL_ARG(quad, i));
 				}
 				fprintf(dfp, ")");
 			}
 		}
+		// regular opcodes
+		else if (quad->src2) {
+			fprintf(dfp, ", ");
+			print_addr(QSRC2(quad));
+		}
 	}
 	
 	fprintf(dfp, "\n");
@@ -166,7 +166,7 @@ void print_quad(struct quad *quad)
 
 void print_basic_block(struct basic_block *bb)
 {
-	struct quad *iter;
+	unsigned i;
 	struct bb_history *hist_iter, *cur;
 
 	// shouldn't happen
@@ -176,24 +176,23 @@ void print_basic_block(struct basic_block *bb)
 	}
 
 	// print bb identifier
-	fprintf(dfp, ".BB.%s.%d {\n", bb->fn_name, bb->bb_no);
+	fprintf(dfp, "%s {\n", bb->label);
 
 	// print all quads in bb
-	_LL_FOR(bb->ll, iter, next) {
-		print_quad(iter);
+	for (i = 0; i < bb->nquads; ++i) {
+		print_quad(&bb->quads[i]);
 	}
 
 	// print what it branches to
 	// conditional branch (if exists)
 	if (bb->next_cond && bb->branch_cc != CC_ALWAYS) {
-		fprintf(dfp, "\tJMP%s .BB.%s.%d\n", cc2str(bb->branch_cc),
-			bb->next_cond->fn_name, bb->next_cond->bb_no);
+		fprintf(dfp, "\tJMP%s %s\n", cc2str(bb->branch_cc),
+			bb->next_cond->label);
 	}
 	// unconditional branch (if exists; doesn't exist for final
 	// bb in function, i.e., CFG terminal node)
 	if (bb->next_def) {
-		fprintf(dfp, "\tJMP .BB.%s.%d\n",
-			bb->next_def->fn_name, bb->next_def->bb_no);
+		fprintf(dfp, "\tJMP %s\n", bb->next_def->label);
 	} else {
 		fprintf(dfp, "\t(CFG terminal node)\n");
 	}
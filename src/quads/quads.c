@@ -3,22 +3,104 @@
 #include <quads/sizeof.h>
 #include <quads/exprquads.h>
 #include <quads/cfquads.h>
+#include <parser/types.h>
 #include <string.h>
 #include <stdio.h>
 
-struct basic_block *cur_bb, *bb_ll;
+// the state of quad generation is per-thread, since functions may be generated
+// on several threads at once (see backend.h)
+_Thread_local struct basic_block *cur_bb, *bb_ll;
+
+_Thread_local struct addr **addrs;
+_Thread_local unsigned addr_count;
+_Thread_local unsigned *call_args;
+
+// label prefix of the current function's basic blocks (".BB.[fn name].") and
+// the next basic block and temporary numbers
+static _Thread_local char *bb_label_prefix;
+static _Thread_local unsigned bb_label_prefix_len;
+static _Thread_local int bb_no, tmp_no;
+
+// capacities of the operand table and of call_args, and length of call_args
+static _Thread_local unsigned addr_cap, call_args_count, call_args_cap;
+
+// hash table of the function's constants (operand indices; 0 is empty);
+// capacity is a power of two
+static _Thread_local unsigned *const_tab, const_cap, const_count;
+
+// hash table of the operands of the global (extern/static) variables and
+// functions that the function refers to, by declaration; these declarations
+// are shared with functions that may be generated at the same time on other
+// threads, so decl.addr_id is only used for local variables
+static _Thread_local unsigned *var_tab, var_cap, var_count;
+
+// Fibonacci hashing of a constant value (or declaration) into its table
+#define FIB_HASH(val, cap)	((unsigned) (((val) * 0x9e3779b97f4a7c15ull)\
+					>> 32) & ((cap) - 1))
+#define CONST_HASH(val)		FIB_HASH(val, const_cap)
+#define VAR_HASH(decl)		FIB_HASH((uintptr_t) (decl), var_cap)
+
+#define QUADS_INIT_CAP	8
+#define ADDRS_INIT_CAP	64
+#define CONST_INIT_CAP	64
+#define VAR_INIT_CAP	16
+
+// arrays outgrown by grow(), indexed by log2 of their size in bytes (linked
+// through their first word); arena memory is only released with the function,
+// so they are reused for the function's other arrays instead
+static _Thread_local void *spare[32];
+
+static unsigned log2u(size_t n)
+{
+	unsigned i = 0;
 
-// current function name and basic block number
-static char *fn_name;
-static int bb_no, tmp_no = 1;
+	while (n >>= 1) {
+		++i;
+	}
+	return i;
+}
+
+// grow an arena-allocated array to hold at least n elements; capacities and
+// element sizes are powers of two
+static void *grow(void *arr, unsigned *cap, unsigned n, size_t elsize,
+	unsigned init_cap)
+{
+	unsigned old_cap = *cap, i;
+	void *new;
+
+	if (n <= old_cap) {
+		return arr;
+	}
+
+	for (*cap = old_cap ? old_cap : init_cap; *cap < n; *cap *= 2);
+
+	i = log2u(*cap * elsize);
+	if ((new = spare[i])) {
+		spare[i] = *(void **) new;
+	} else {
+		new = arena_alloc(cur_arena, *cap * elsize);
+	}
+
+	if (arr) {
+		memcpy(new, arr, old_cap * elsize);
+
+		i = log2u(old_cap * elsize);
+		*(void **) arr = spare[i];
+		spare[i] = arr;
+	}
+	return new;
+}
 
 struct basic_block *basic_block_new(int add_to_ll)
 {
-	struct basic_block *bb = calloc(1, sizeof(struct basic_block));
+	struct basic_block *bb = ARENA_NEW(struct basic_block);
 
-	// set basic block identifier
-	bb->fn_name = strdup(fn_name);
+	// set basic block identifier; the label is formatted once here and
+	// every reference to the block uses the same string
 	bb->bb_no = bb_no++;
+	bb->label = arena_alloc(cur_arena, bb_label_prefix_len + 11);
+	memcpy(bb->label, bb_label_prefix, bb_label_prefix_len);
+	sprintf(bb->label + bb_label_prefix_len, "%d", bb->bb_no);
 
 	if (add_to_ll) {
 		bb_ll_push(bb);
@@ -27,15 +109,6 @@ struct basic_block *basic_block_new(int add_to_ll)
 	return bb;
 }
 
-char *bb_name(struct basic_block *bb)
-{
-	char *name = malloc(10);
-	name[0] = 0;
-
-	sprintf(name, ".BB.%s.%d", bb->fn_name, bb->bb_no);
-	return name;
-}
-
 void bb_ll_push(struct basic_block *bb)
 {
 	bb->next = bb_ll;
@@ -44,7 +117,7 @@ void bb_ll_push(struct basic_block *bb)
 
 struct basic_block *dummy_basic_block_new(void)
 {
-	struct basic_block *bb = calloc(1, sizeof(struct basic_block));
+	struct basic_block *bb = ARENA_NEW(struct basic_block);
 
 	// don't add to bb_ll, give it obviously invalid ID
 	bb->bb_no = -1;
@@ -56,45 +129,70 @@ struct quad *quad_new(enum opcode opcode, struct addr *dest, struct addr *src1,
 {
 	struct quad *quad;
 
-	// cannot generate quads (even to be pedantic) because we reverse the
-	// quad ll when it is finalized, so this will generate quads out of
-	// order; so this is a (necessary) optimization; if we really wanted to
-	// be consistent can generate quads to a dummy bb that would not be
-	// linked anywhere in the CFG
+	// the block's successors are already set, so anything emitted here
+	// would never run; if we really wanted to be consistent can generate
+	// quads to a dummy bb that would not be linked anywhere in the CFG
 	if (cur_bb->finalized) {
 		// error is non-fatal, but we will not generate quads
 		yyerror("unreachable point; not generating quad");
 		return NULL;
 	}
 
-	quad = calloc(1, sizeof(struct quad));
-	*quad = (struct quad) {
-		.bb = cur_bb,
-		.next = cur_bb->ll,
+	cur_bb->quads = grow(cur_bb->quads, &cur_bb->quads_cap,
+		cur_bb->nquads + 1, sizeof(struct quad), QUADS_INIT_CAP);
 
+	quad = &cur_bb->quads[cur_bb->nquads++];
+	*quad = (struct quad) {
 		.opcode = opcode,
-		.dest = dest,
-		.src1 = src1,
-		.src2 = src2,
+		.dest = dest ? dest->id : 0,
+		.src1 = src1 ? src1->id : 0,
+		.src2 = src2 ? src2->id : 0,
 	};
 
-	// note: this generates the basic block in reverse; will eventually
-	// be re-reversed in link_bb()
-	cur_bb->ll = quad;
+	return quad;
+}
+
+struct quad *quad_call_new(struct addr *dest, struct addr *fn,
+	struct addr **args, unsigned argc)
+{
+	struct quad *quad;
+	unsigned i;
+
+	if (!(quad = quad_new(OC_CALL, dest, fn, NULL))) {
+		return NULL;
+	}
+
+	call_args = grow(call_args, &call_args_cap,
+		call_args_count + argc + 1, sizeof(unsigned), ADDRS_INIT_CAP);
+
+	quad->src2 = call_args_count;
+	call_args[call_args_count++] = argc;
+	for (i = 0; i < argc; ++i) {
+		call_args[call_args_count++] = args[i]->id;
+	}
 
 	return quad;
 }
 
 struct addr *addr_new(enum addr_type type, union astnode *decl)
 {
-	struct addr *addr = calloc(1, sizeof(struct addr));
+	struct addr *addr = ARENA_NEW(struct addr);
 
+	// operands carry canonical types, so that types can be compared by
+	// pointer (and their size is only computed once)
+	decl = type_canon(decl);
 	*addr = (struct addr) {
 		.type = type,
 		.size = astnode_sizeof_type(decl),
 		.decl = decl,
 	};
 
+	// register in the operand table
+	addrs = grow(addrs, &addr_cap, addr_count + 1, sizeof(struct addr *),
+		ADDRS_INIT_CAP);
+	addr->id = addr_count;
+	addrs[addr_count++] = addr;
+
 	return addr;
 }
 
@@ -108,6 +206,124 @@ struct addr *tmp_addr_new(union astnode *decl)
 	return addr;
 }
 
+// whether a declaration may be referred to by other functions
+static int decl_is_shared(union astnode *decl)
+{
+	union astnode *sc;
+
+	if (decl->decl.is_string) {
+		return 0;
+	}
+
+	sc = decl->decl.declspec ? decl->decl.declspec->declspec.sc : NULL;
+	return !sc || sc->sc.scspec == SC_EXTERN || sc->sc.scspec == SC_STATIC;
+}
+
+// operand of a global variable or function
+static struct addr *shared_var_addr(union astnode *decl)
+{
+	struct addr *addr;
+	unsigned *tab, cap, i, j;
+
+	// keep the table at most half full
+	if (2 * (var_count + 1) > var_cap) {
+		tab = var_tab;
+		cap = var_cap;
+
+		var_cap = cap ? cap * 2 : VAR_INIT_CAP;
+		var_tab = arena_alloc(cur_arena, var_cap * sizeof(unsigned));
+		for (i = 0; i < cap; ++i) {
+			if (!tab[i]) {
+				continue;
+			}
+			j = VAR_HASH(addrs[tab[i]]->val.astnode);
+			while (var_tab[j]) {
+				j = (j + 1) & (var_cap - 1);
+			}
+			var_tab[j] = tab[i];
+		}
+	}
+
+	for (i = VAR_HASH(decl); var_tab[i]; i = (i + 1) & (var_cap - 1)) {
+		if ((addr = addrs[var_tab[i]])->val.astnode == decl) {
+			return addr;
+		}
+	}
+
+	addr = addr_new(AT_AST, decl->decl.components);
+	addr->val.astnode = decl;
+	var_tab[i] = addr->id;
+	++var_count;
+	return addr;
+}
+
+struct addr *var_addr(union astnode *decl)
+{
+	struct addr *addr;
+
+	if (decl_is_shared(decl)) {
+		return shared_var_addr(decl);
+	}
+
+	// the index remembered in the decl may be left over from another
+	// function, so check that it is really this variable's addr
+	if (decl->decl.addr_id < addr_count
+		&& (addr = addrs[decl->decl.addr_id])
+		&& addr->type == AT_AST && addr->val.astnode == decl) {
+		return addr;
+	}
+
+	addr = addr_new(AT_AST, decl->decl.components);
+	addr->val.astnode = decl;
+	decl->decl.addr_id = addr->id;
+	return addr;
+}
+
+struct addr *const_addr(union astnode *decl, uint64_t value)
+{
+	struct addr *addr;
+	unsigned *tab, cap, i, j;
+
+	// constants of different types get different addrs, since the type of
+	// a constant determines the type of the expressions it is used in
+	decl = type_canon(decl);
+
+	// keep the table at most half full
+	if (2 * (const_count + 1) > const_cap) {
+		tab = const_tab;
+		cap = const_cap;
+
+		const_cap = cap ? cap * 2 : CONST_INIT_CAP;
+		const_tab = arena_alloc(cur_arena,
+			const_cap * sizeof(unsigned));
+		for (i = 0; i < cap; ++i) {
+			if (!tab[i]) {
+				continue;
+			}
+			addr = addrs[tab[i]];
+			j = CONST_HASH(*((uint64_t *)addr->val.constval));
+			while (const_tab[j]) {
+				j = (j + 1) & (const_cap - 1);
+			}
+			const_tab[j] = tab[i];
+		}
+	}
+
+	for (i = CONST_HASH(value); const_tab[i]; i = (i + 1) & (const_cap - 1)) {
+		addr = addrs[const_tab[i]];
+		if (*((uint64_t *)addr->val.constval) == value
+			&& addr->decl == decl) {
+			return addr;
+		}
+	}
+
+	addr = addr_new(AT_CONST, decl);
+	*((uint64_t *)addr->val.constval) = value;
+	const_tab[i] = addr->id;
+	++const_count;
+	return addr;
+}
+
 void gen_stmt_quads(union astnode *stmt)
 {
 	// end of recursion
@@ -211,12 +427,31 @@ struct basic_block *generate_quads(union astnode *fn_decl)
 	struct addr *tmp;
 
 	// new function was just declared, update identifiers
-	fn_name = strdup(fn_decl->decl.ident);
-	bb_no = 1;
+	bb_label_prefix_len = strlen(fn_decl->decl.ident) + 5;
+	bb_label_prefix = arena_alloc(cur_arena, bb_label_prefix_len + 1);
+	sprintf(bb_label_prefix, ".BB.%s.", fn_decl->decl.ident);
+	bb_no = tmp_no = 1;
 
 	// clear basic block linked list
 	bb_ll = NULL;
 
+	// clear operand table (the old one was released with the previous
+	// function's arena); index 0 is reserved for "no operand"
+	addrs = NULL;
+	addr_count = addr_cap = 0;
+	call_args = NULL;
+	call_args_count = call_args_cap = 0;
+	const_tab = NULL;
+	const_count = const_cap = 0;
+	var_tab = NULL;
+	var_count = var_cap = 0;
+	memset(spare, 0, sizeof(spare));
+	types_fn_reset();
+
+	addrs = grow(addrs, &addr_cap, 1, sizeof(struct addr *),
+		ADDRS_INIT_CAP);
+	addrs[addr_count++] = NULL;
+
 	// create starting basic block of function
 	cur_bb = fn_bb = basic_block_new(1);
 
@@ -225,23 +460,23 @@ struct basic_block *generate_quads(union astnode *fn_decl)
 
 	// add implicit return here
 	// assume returns an integer type, implicit return 0;
-	if (!cur_bb->ll || cur_bb->ll->opcode != OC_RET) {
-		tmp = addr_new(AT_CONST, create_int());
-		*((uint64_t*)tmp->val.constval) = 0;
+	if (!cur_bb->nquads
+		|| cur_bb->quads[cur_bb->nquads - 1].opcode != OC_RET) {
+		tmp = const_addr(create_int(), 0);
 
 		quad_new(OC_RET, NULL, tmp, NULL);
 	}
 
-	// need to call this to finalize the last BB (i.e., reverse its quads)
+	// need to call this to finalize the last BB
 	link_bb(CC_ALWAYS, NULL, NULL);
 
 	// finalize bb list by reversing the order
 	finalize_bb_list();
 
-#if DEBUG
 	// dump basic blocks (recursively print out CFG)
-	print_basic_blocks();
-#endif
+	if (DEBUGGING(DEBUG_QUADS)) {
+		print_basic_blocks();
+	}
 
 	return bb_ll;
 }
\ No newline at end of file
@@ -11,71 +11,123 @@ unsigned astnode_sizeof_symbol(union astnode *node)
 
 unsigned astnode_sizeof_type(union astnode *type)
 {
+	return astnode_layout_type(type).size;
+}
+
+unsigned astnode_alignof_type(union astnode *type)
+{
+	return astnode_layout_type(type).align;
+}
+
+// where the layout of a type node is cached
+static struct type_layout *type_layout_cache(union astnode *type)
+{
+	switch (NT(type)) {
+	case NT_TS_SCALAR:		return &type->ts_scalar.layout;
+	case NT_TS_STRUCT_UNION:	return &type->ts_structunion.layout;
+	default:			return &type->decl_component.layout;
+	}
+}
+
+// size of a scalar type; these values come from gcc10.2.0
+static unsigned scalar_size(struct astnode_typespec_scalar *sc)
+{
+	// this makes the assumption that the types were appropriate
+	// vetted in merge_declspec(); short int: 2; long int: 8;
+	// long long int: 8; long double: 16
+	switch (sc->modifiers.lls) {
+	case LLS_LONG:		return sc->basetype == BT_INT ? 8 : 16;
+	case LLS_LONG_LONG:	return 8;
+	case LLS_SHORT:		return 2;
+	}
+
+	// non-modified scalar types
+	switch (sc->basetype) {
+	case BT_UNSPEC:
+		yyerror_fatal("quadgen: sizeof(type): unspecified basetype");
+	case BT_VOID:
+		yyerror_fatal("quadgen: sizeof(void)");
+	case BT_BOOL:
+	case BT_CHAR:	return 1;
+	case BT_INT:
+	case BT_FLOAT: 	return 4;
+	case BT_DOUBLE:	return 8;
+	}
+	return 0;
+}
+
+struct type_layout astnode_layout_type(union astnode *type)
+{
+	struct type_layout *cache, layout, member;
+	struct astnode_typespec_structunion *su;
 	union astnode *iter;
-	unsigned size;
 
 	if (!type) {
 		yyerror_fatal("quadgen: sizeof(type): NULL type component");
 	}
 
+	// types shared between functions may be laid out by several threads
+	// at once (which all compute the same layout), so the cache is read
+	// and written as a whole
+	cache = type_layout_cache(type);
+	__atomic_load(cache, &layout, __ATOMIC_RELAXED);
+	if (layout.size) {
+		return layout;
+	}
+
 	switch (NT(type)) {
 
 	// sizeof array is count*sizeof(contained type)
 	case NT_DECLARATOR_ARRAY:
 		// TODO: for now, assume array expression is an int
-		return (*((unsigned*)type->decl_array.length->num.buf))
-			* astnode_sizeof_type(LL_NEXT_OF(type));
+		layout = astnode_layout_type(LL_NEXT_OF(type));
+		layout.size *= *((unsigned*)type->decl_array.length->num.buf);
+		break;
 
 	// sizeof (pointer) = width of memory bus (assumption: 8 bytes)
 	// function also gets treated like a pointer
 	case NT_DECLARATOR_POINTER:
 	case NT_DECLARATOR_FUNCTION:
-		return 8;
+		layout = (struct type_layout) { 8, 8 };
+		break;
 
 	// sizeof(declspec): get size of typespec
 	case NT_DECLSPEC:
-		return astnode_sizeof_type(type->declspec.ts);
+		layout = astnode_layout_type(type->declspec.ts);
+		break;
 
-	// return scalar size
+	// scalars are aligned to their size
 	case NT_TS_SCALAR:
-		// this makes the assumption that the types were appropriate
-		// vetted in merge_declspec(); these values come from gcc10.2.0:
-		// short int: 2; long int: 8; long long int: 8; long double: 16
-		switch (type->ts_scalar.modifiers.lls) {
-		case LLS_LONG:		return type->ts_scalar.basetype==BT_INT
-						     ? 8 : 16;
-		case LLS_LONG_LONG:	return 8;
-		case LLS_SHORT:		return 2;
-		}
+		layout.size = layout.align = scalar_size(&type->ts_scalar);
+		break;
 
-		// non-modified scalar types; these values come from gcc10.2.0
-		switch (type->ts_scalar.basetype) {
-		case BT_UNSPEC:
-			yyerror_fatal("quadgen: sizeof(type): unspecified"
-				" basetype");
-		case BT_VOID:
-			yyerror_fatal("quadgen: sizeof(void)");
-		case BT_BOOL:
-		case BT_CHAR:	return 1;
-		case BT_INT:
-		case BT_FLOAT: 	return 4;
-		case BT_DOUBLE:	return 8;
+	// struct members are laid out in order, each at the next offset that
+	// is a multiple of its alignment; union members all start at offset 0;
+	// both are padded to a multiple of their strictest member alignment
+	case NT_TS_STRUCT_UNION:
+		su = &type->ts_structunion;
+		layout = (struct type_layout) { 0, 1 };
+		LL_FOR(su->members.head, iter) {
+			member = astnode_layout_type(iter->decl.components);
+			layout.align = MAX(layout.align, member.align);
+			layout.size = su->su_type == SU_STRUCT
+				? ALIGN_UP(layout.size, member.align)
+					+ member.size
+				: MAX(layout.size, member.size);
 		}
+		layout.size = ALIGN_UP(layout.size, layout.align);
 
-	// return struct/union size
-	case NT_TS_STRUCT_UNION:
-		// TODO: would be better to compute offsets when creating
-		// 	the struct/union, and also compute padding there;
-		// 	this bad implementation doesn't compute padding (but
-		// 	really should)
-		size = 0;
-		LL_FOR(type->ts_structunion.members, iter) {
-			size += astnode_sizeof_type(iter->decl.components);
+		// an incomplete struct may still get members
+		if (!su->is_complete) {
+			return layout;
 		}
-		return size;
+		break;
 
 	default:
 		yyerror_fatal("quadgen: sizeof(type): invalid type component");
-		return -1;
+		return (struct type_layout) { 0, 1 };
 	}
+
+	__atomic_store(cache, &layout, __ATOMIC_RELAXED);
+	return layout;
 }